@@ -0,0 +1,499 @@
+#include "archive.h"
+#include "checksum.h"
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <thread>
+
+namespace fc
+{
+    namespace
+    {
+        // Archive layout, all integers little-endian:
+        //   header:    magic "FCAR", version u16
+        //   members:   one FC container per file, back to back
+        //   directory: per entry pathLen u16, path, offset u64, compressedSize u64,
+        //              originalSize u64, crc u32
+        //   trailer:   directoryOffset u64, entry count u32, magic "FCAD"
+        constexpr uint32_t ARCHIVE_MAGIC = 0x52414346u;   // "FCAR" in little-endian
+        constexpr uint32_t DIRECTORY_MAGIC = 0x44414346u; // "FCAD" in little-endian
+        constexpr uint16_t ARCHIVE_VERSION = 1;
+        constexpr size_t ARCHIVE_HEADER_SIZE = 6;
+        constexpr size_t ENTRY_FIXED_SIZE = 30; // entry without its path
+        constexpr size_t TRAILER_SIZE = 16;
+
+        void putLE(std::vector<uint8_t> &out, uint64_t v, int bytes)
+        {
+            for (int i = 0; i < bytes; ++i)
+                out.push_back(static_cast<uint8_t>(v >> (8 * i)));
+        }
+
+        uint64_t loadLE(const uint8_t *p, int bytes)
+        {
+            uint64_t v = 0;
+            for (int i = bytes - 1; i >= 0; --i)
+                v = (v << 8) | p[i];
+            return v;
+        }
+
+        bool readFile(const std::string &path, std::vector<uint8_t> &data)
+        {
+            std::ifstream in(path, std::ios::binary | std::ios::ate);
+            if (!in)
+                return false;
+            std::streamoff size = in.tellg();
+            if (size < 0)
+                return false;
+            data.resize(static_cast<size_t>(size));
+            in.seekg(0);
+            in.read(reinterpret_cast<char *>(data.data()), size);
+            return static_cast<bool>(in) || size == 0;
+        }
+
+        struct MemberJob
+        {
+            std::string source; // file to read
+            // Filled in by a worker
+            std::vector<uint8_t> encoded;
+            uint64_t originalSize = 0;
+            uint32_t crc = 0;
+            bool ok = false;
+            std::string err;
+            bool done = false;
+        };
+
+        // Worker threads that each read and compress whole files. Each worker keeps one
+        // DeflateContext (match finder, tokens, block scratch) and an input buffer for all
+        // its files, and a job's output buffer keeps its capacity, so after warm-up small
+        // files cost no allocations.
+        class MemberCompressorPool
+        {
+        public:
+            MemberCompressorPool(const DeflateOptions &opt, unsigned threads) : opt_(opt)
+            {
+                for (unsigned i = 0; i < threads; ++i)
+                    workers_.emplace_back([this]
+                                          { run(); });
+            }
+
+            ~MemberCompressorPool()
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mu_);
+                    stop_ = true;
+                }
+                work_.notify_all();
+                for (auto &t : workers_)
+                    t.join();
+            }
+
+            void submit(MemberJob *job)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mu_);
+                    job->done = false;
+                    queue_.push_back(job);
+                }
+                work_.notify_one();
+            }
+
+            void wait(const MemberJob *job)
+            {
+                std::unique_lock<std::mutex> lock(mu_);
+                done_.wait(lock, [job]
+                           { return job->done; });
+            }
+
+        private:
+            void run()
+            {
+                DeflateContext ctx(opt_);
+                std::vector<uint8_t> input;
+                for (;;)
+                {
+                    MemberJob *job = nullptr;
+                    {
+                        std::unique_lock<std::mutex> lock(mu_);
+                        work_.wait(lock, [this]
+                                   { return stop_ || !queue_.empty(); });
+                        if (stop_)
+                            return;
+                        job = queue_.front();
+                        queue_.pop_front();
+                    }
+
+                    job->encoded.clear();
+                    job->ok = readFile(job->source, input);
+                    if (!job->ok)
+                    {
+                        job->err = "archiveDirectory: cannot read " + job->source;
+                    }
+                    else
+                    {
+                        job->originalSize = input.size();
+                        job->crc = crc32(0, input.data(), input.size());
+                        job->ok = ctx.compress(input.data(), input.size(), job->encoded, &job->err);
+                    }
+
+                    {
+                        std::lock_guard<std::mutex> lock(mu_);
+                        job->done = true;
+                    }
+                    done_.notify_all();
+                }
+            }
+
+            const DeflateOptions &opt_;
+            std::mutex mu_;
+            std::condition_variable work_;
+            std::condition_variable done_;
+            std::deque<MemberJob *> queue_;
+            bool stop_ = false;
+            std::vector<std::thread> workers_;
+        };
+
+        unsigned resolveThreads(uint32_t threads)
+        {
+            if (threads == 0)
+                threads = std::max(1u, std::thread::hardware_concurrency());
+            return threads;
+        }
+
+        // Regular files under dir as sorted '/'-separated relative paths
+        bool listFiles(const std::string &dir, std::vector<std::string> &paths, std::string *err)
+        {
+            namespace fs = std::filesystem;
+            std::error_code ec;
+            if (!fs::is_directory(dir, ec))
+            {
+                if (err)
+                    *err = "archiveDirectory: not a directory: " + dir;
+                return false;
+            }
+            for (fs::recursive_directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec))
+            {
+                if (!it->is_regular_file(ec))
+                    continue;
+                std::string rel = it->path().lexically_relative(dir).generic_string();
+                if (rel.size() > 0xFFFF)
+                {
+                    if (err)
+                        *err = "archiveDirectory: path too long: " + rel;
+                    return false;
+                }
+                paths.push_back(std::move(rel));
+            }
+            if (ec)
+            {
+                if (err)
+                    *err = "archiveDirectory: cannot list " + dir + ": " + ec.message();
+                return false;
+            }
+            std::sort(paths.begin(), paths.end());
+            return true;
+        }
+    }
+
+    bool archiveDirectory(const std::string &dir, std::ostream &out, const DeflateOptions &opt, std::string *err)
+    {
+        if (opt.format != ContainerFormat::FC)
+        {
+            if (err)
+                *err = "archiveDirectory: members are always plain FC containers";
+            return false;
+        }
+        std::vector<std::string> paths;
+        if (!listFiles(dir, paths, err))
+            return false;
+
+        // Parallelism is across files; each member is compressed by one worker
+        DeflateOptions memberOpt = opt;
+        memberOpt.threads = 1;
+        const unsigned threads = static_cast<unsigned>(std::min<size_t>(resolveThreads(opt.threads), std::max<size_t>(paths.size(), 1)));
+        const size_t maxInFlight = 2 * static_cast<size_t>(threads);
+
+        std::vector<uint8_t> bytes;
+        putLE(bytes, ARCHIVE_MAGIC, 4);
+        putLE(bytes, ARCHIVE_VERSION, 2);
+        out.write(reinterpret_cast<const char *>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+
+        std::vector<ArchiveEntry> entries(paths.size());
+        uint64_t offset = ARCHIVE_HEADER_SIZE;
+
+        // Declared before the pool so the workers are joined before jobs are freed
+        std::deque<std::unique_ptr<MemberJob>> inFlight;
+        std::vector<std::unique_ptr<MemberJob>> spare;
+        MemberCompressorPool pool(memberOpt, threads);
+        size_t written = 0;
+
+        auto retire = [&]() -> bool
+        {
+            std::unique_ptr<MemberJob> job = std::move(inFlight.front());
+            inFlight.pop_front();
+            pool.wait(job.get());
+            if (!job->ok)
+            {
+                if (err)
+                    *err = job->err;
+                return false;
+            }
+            out.write(reinterpret_cast<const char *>(job->encoded.data()), static_cast<std::streamsize>(job->encoded.size()));
+            if (!out)
+            {
+                if (err)
+                    *err = "archiveDirectory: failed to write output";
+                return false;
+            }
+            ArchiveEntry &e = entries[written++];
+            e.offset = offset;
+            e.compressedSize = job->encoded.size();
+            e.originalSize = job->originalSize;
+            e.crc = job->crc;
+            offset += e.compressedSize;
+            spare.push_back(std::move(job));
+            return true;
+        };
+
+        const std::filesystem::path root(dir);
+        for (size_t i = 0; i < paths.size(); ++i)
+        {
+            std::unique_ptr<MemberJob> job;
+            if (!spare.empty())
+            {
+                job = std::move(spare.back());
+                spare.pop_back();
+            }
+            else
+            {
+                job = std::make_unique<MemberJob>();
+            }
+            entries[i].path = paths[i];
+            job->source = (root / paths[i]).string();
+            pool.submit(job.get());
+            inFlight.push_back(std::move(job));
+            if (inFlight.size() >= maxInFlight && !retire())
+                return false;
+        }
+        while (!inFlight.empty())
+        {
+            if (!retire())
+                return false;
+        }
+
+        // Central directory and trailer
+        bytes.clear();
+        for (const ArchiveEntry &e : entries)
+        {
+            putLE(bytes, e.path.size(), 2);
+            bytes.insert(bytes.end(), e.path.begin(), e.path.end());
+            putLE(bytes, e.offset, 8);
+            putLE(bytes, e.compressedSize, 8);
+            putLE(bytes, e.originalSize, 8);
+            putLE(bytes, e.crc, 4);
+        }
+        putLE(bytes, offset, 8);
+        putLE(bytes, entries.size(), 4);
+        putLE(bytes, DIRECTORY_MAGIC, 4);
+        out.write(reinterpret_cast<const char *>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+        out.flush();
+        if (!out)
+        {
+            if (err)
+                *err = "archiveDirectory: failed to write output";
+            return false;
+        }
+        return true;
+    }
+
+    bool ArchiveReader::open(std::string *err)
+    {
+        auto fail = [this, err](const char *msg)
+        {
+            entries_.clear();
+            if (err)
+                *err = msg;
+            return false;
+        };
+        entries_.clear();
+        base_ = in_.tellg();
+        if (base_ == std::streampos(-1))
+            return fail("ArchiveReader: input is not seekable");
+
+        uint8_t header[ARCHIVE_HEADER_SIZE];
+        in_.read(reinterpret_cast<char *>(header), ARCHIVE_HEADER_SIZE);
+        if (!in_ || loadLE(header, 4) != ARCHIVE_MAGIC)
+            return fail("ArchiveReader: not an archive");
+        if (loadLE(header + 4, 2) != ARCHIVE_VERSION)
+            return fail("ArchiveReader: unsupported archive version");
+
+        in_.seekg(0, std::ios::end);
+        std::streampos end = in_.tellg();
+        if (end == std::streampos(-1) || end - base_ < static_cast<std::streamoff>(ARCHIVE_HEADER_SIZE + TRAILER_SIZE))
+            return fail("ArchiveReader: truncated archive");
+        const uint64_t archiveSize = static_cast<uint64_t>(end - base_);
+
+        uint8_t trailer[TRAILER_SIZE];
+        in_.seekg(end - static_cast<std::streamoff>(TRAILER_SIZE));
+        in_.read(reinterpret_cast<char *>(trailer), TRAILER_SIZE);
+        const uint64_t dirOffset = loadLE(trailer, 8);
+        const uint64_t count = loadLE(trailer + 8, 4);
+        if (!in_ || loadLE(trailer + 12, 4) != DIRECTORY_MAGIC || dirOffset < ARCHIVE_HEADER_SIZE ||
+            dirOffset > archiveSize - TRAILER_SIZE || count > (archiveSize - TRAILER_SIZE - dirOffset) / ENTRY_FIXED_SIZE)
+            return fail("ArchiveReader: corrupt central directory");
+
+        std::vector<uint8_t> dir(static_cast<size_t>(archiveSize - TRAILER_SIZE - dirOffset));
+        in_.seekg(base_ + static_cast<std::streamoff>(dirOffset));
+        in_.read(reinterpret_cast<char *>(dir.data()), static_cast<std::streamsize>(dir.size()));
+        if (!in_)
+            return fail("ArchiveReader: truncated central directory");
+
+        // Entries must tile the member area in order, sorted by path for find()
+        entries_.resize(static_cast<size_t>(count));
+        const uint8_t *p = dir.data();
+        const uint8_t *dirEnd = dir.data() + dir.size();
+        uint64_t next = ARCHIVE_HEADER_SIZE;
+        for (ArchiveEntry &e : entries_)
+        {
+            if (dirEnd - p < 2 || static_cast<size_t>(dirEnd - p) < ENTRY_FIXED_SIZE + loadLE(p, 2))
+                return fail("ArchiveReader: corrupt central directory");
+            const size_t pathLen = static_cast<size_t>(loadLE(p, 2));
+            e.path.assign(reinterpret_cast<const char *>(p + 2), pathLen);
+            p += 2 + pathLen;
+            e.offset = loadLE(p, 8);
+            e.compressedSize = loadLE(p + 8, 8);
+            e.originalSize = loadLE(p + 16, 8);
+            e.crc = static_cast<uint32_t>(loadLE(p + 24, 4));
+            p += ENTRY_FIXED_SIZE - 2;
+            if (e.path.empty() || e.offset != next || e.compressedSize > dirOffset - e.offset ||
+                (&e != &entries_.front() && !((&e)[-1].path < e.path)))
+                return fail("ArchiveReader: corrupt central directory");
+            next = e.offset + e.compressedSize;
+        }
+        if (p != dirEnd || next != dirOffset)
+            return fail("ArchiveReader: corrupt central directory");
+        in_.clear();
+        return true;
+    }
+
+    const ArchiveEntry *ArchiveReader::find(const std::string &path) const
+    {
+        auto it = std::lower_bound(entries_.begin(), entries_.end(), path, [](const ArchiveEntry &e, const std::string &p)
+                                   { return e.path < p; });
+        return (it != entries_.end() && it->path == path) ? &*it : nullptr;
+    }
+
+    bool ArchiveReader::decode(const ArchiveEntry &entry, const InflateOptions &opt, std::string *err)
+    {
+        packed_.resize(static_cast<size_t>(entry.compressedSize));
+        in_.clear();
+        in_.seekg(base_ + static_cast<std::streamoff>(entry.offset));
+        in_.read(reinterpret_cast<char *>(packed_.data()), static_cast<std::streamsize>(packed_.size()));
+        if (!in_)
+        {
+            if (err)
+                *err = "ArchiveReader: truncated member " + entry.path;
+            return false;
+        }
+
+        // The member header sizes the output buffer, so it must agree with the directory
+        uint64_t recorded = 0;
+        std::string e;
+        if (!inflatedSize(packed_.data(), packed_.size(), recorded, &e) || recorded != entry.originalSize)
+        {
+            if (err)
+                *err = "ArchiveReader: corrupt member " + entry.path;
+            return false;
+        }
+        if (!inflateBuffer(packed_.data(), packed_.size(), raw_, opt, &e))
+        {
+            if (err)
+                *err = entry.path + ": " + e;
+            return false;
+        }
+        if (raw_.size() != entry.originalSize || crc32(0, raw_.data(), raw_.size()) != entry.crc)
+        {
+            if (err)
+                *err = "ArchiveReader: checksum mismatch in " + entry.path;
+            return false;
+        }
+        return true;
+    }
+
+    bool ArchiveReader::verify(const ArchiveEntry &entry, const InflateOptions &opt, std::string *err)
+    {
+        return decode(entry, opt, err);
+    }
+
+    bool ArchiveReader::extract(const ArchiveEntry &entry, std::ostream &out, const InflateOptions &opt, std::string *err)
+    {
+        if (!decode(entry, opt, err))
+            return false;
+        out.write(reinterpret_cast<const char *>(raw_.data()), static_cast<std::streamsize>(raw_.size()));
+        if (!out)
+        {
+            if (err)
+                *err = "ArchiveReader: failed to write " + entry.path;
+            return false;
+        }
+        return true;
+    }
+
+    bool extractArchive(std::istream &in, const std::string &destDir, const std::vector<std::string> &paths,
+                        const InflateOptions &opt, std::string *err)
+    {
+        namespace fs = std::filesystem;
+        ArchiveReader reader(in);
+        if (!reader.open(err))
+            return false;
+
+        std::vector<const ArchiveEntry *> selected;
+        if (paths.empty())
+        {
+            for (const ArchiveEntry &e : reader.entries())
+                selected.push_back(&e);
+        }
+        for (const std::string &path : paths)
+        {
+            const ArchiveEntry *e = reader.find(path);
+            if (!e)
+            {
+                if (err)
+                    *err = "extractArchive: no member " + path;
+                return false;
+            }
+            selected.push_back(e);
+        }
+
+        for (const ArchiveEntry *e : selected)
+        {
+            // Refuse absolute paths and ".." components, which would escape destDir
+            fs::path rel = fs::path(e->path).lexically_normal();
+            if (rel.is_absolute() || rel.has_root_name() || rel.empty() || *rel.begin() == "..")
+            {
+                if (err)
+                    *err = "extractArchive: unsafe member path " + e->path;
+                return false;
+            }
+            fs::path target = fs::path(destDir) / rel;
+            std::error_code ec;
+            fs::create_directories(target.parent_path(), ec);
+            std::ofstream out(target, std::ios::binary | std::ios::trunc);
+            if (!out)
+            {
+                if (err)
+                    *err = "extractArchive: cannot create " + target.string();
+                return false;
+            }
+            if (!reader.extract(*e, out, opt, err))
+                return false;
+        }
+        return true;
+    }
+
+} // namespace fc
@@ -0,0 +1,60 @@
+#pragma once
+#include <iosfwd>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "deflate.h"
+#include "inflate.h"
+
+namespace fc
+{
+
+    // One file in an archive. path is relative to the archived directory, '/'-separated.
+    struct ArchiveEntry
+    {
+        std::string path;
+        uint64_t offset = 0;         // of the member's FC container, from the archive start
+        uint64_t compressedSize = 0;
+        uint64_t originalSize = 0;
+        uint32_t crc = 0;            // CRC-32 of the original bytes
+    };
+
+    // Compress every regular file under dir into one archive: a short header, each file
+    // as its own FC container, then a central directory listing them. opt.threads
+    // workers compress files concurrently, each reusing its buffers from file to file;
+    // members are written in path order, so the output does not depend on scheduling.
+    bool archiveDirectory(const std::string &dir, std::ostream &out, const DeflateOptions &opt, std::string *err);
+
+    // Reads an archive's central directory, then decodes single members by seeking
+    // straight to them. in must be seekable and outlive the reader.
+    class ArchiveReader
+    {
+    public:
+        explicit ArchiveReader(std::istream &in) : in_(in) {}
+
+        // Read the header and central directory; member data is not touched
+        bool open(std::string *err);
+        const std::vector<ArchiveEntry> &entries() const { return entries_; }
+        // Entry with exactly this path, or nullptr
+        const ArchiveEntry *find(const std::string &path) const;
+        // Decode one member into out, checking its size and CRC
+        bool extract(const ArchiveEntry &entry, std::ostream &out, const InflateOptions &opt, std::string *err);
+        // The same checks as extract, with the output discarded
+        bool verify(const ArchiveEntry &entry, const InflateOptions &opt, std::string *err);
+
+    private:
+        // Read and decode one member into raw_, checking its size and CRC
+        bool decode(const ArchiveEntry &entry, const InflateOptions &opt, std::string *err);
+
+        std::istream &in_;
+        std::streampos base_{};
+        std::vector<ArchiveEntry> entries_;
+        std::vector<uint8_t> packed_, raw_; // member buffers, reused across extracts
+    };
+
+    // Extract members into destDir, creating subdirectories as needed; every member
+    // when paths is empty. Paths that would leave destDir are rejected.
+    bool extractArchive(std::istream &in, const std::string &destDir, const std::vector<std::string> &paths,
+                        const InflateOptions &opt, std::string *err);
+
+} // namespace fc
@@ -0,0 +1,797 @@
+#include "async_io.h"
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#if defined(__unix__) || defined(__APPLE__)
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define FC_ASYNC_POSIX 1
+#endif
+#if defined(FC_ASYNC_POSIX) && defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter) && defined(__NR_io_uring_register)
+#define FC_ASYNC_URING 1
+#endif
+#endif
+#endif
+
+namespace fc
+{
+    namespace
+    {
+#ifdef FC_ASYNC_POSIX
+        // One whole-buffer transfer; backends continue short transfers themselves
+        struct IoRequest
+        {
+            uint8_t *data = nullptr;
+            size_t length = 0;
+            uint64_t offset = 0;
+            bool write = false;
+            // Set by the backend
+            size_t transferred = 0; // below length only at end of file
+            int error = 0;          // errno of a failed transfer
+            bool done = false;
+        };
+
+        // Runs requests against one file descriptor, any number at a time
+        class IoQueue
+        {
+        public:
+            virtual ~IoQueue() = default;
+            virtual void submit(IoRequest &r) = 0;
+            // Block until r, submitted earlier, is done
+            virtual void wait(IoRequest &r) = 0;
+        };
+
+        // Carry out r with blocking calls, continuing after short transfers
+        void transfer(int fd, IoRequest &r)
+        {
+            while (r.transferred < r.length)
+            {
+                uint8_t *p = r.data + r.transferred;
+                const size_t len = r.length - r.transferred;
+                const off_t at = static_cast<off_t>(r.offset + r.transferred);
+                const ssize_t n = r.write ? ::pwrite(fd, p, len, at) : ::pread(fd, p, len, at);
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n < 0 || (n == 0 && r.write))
+                {
+                    r.error = (n < 0) ? errno : EIO;
+                    return;
+                }
+                if (n == 0)
+                    return; // end of file
+                r.transferred += static_cast<size_t>(n);
+            }
+        }
+
+        // IoBackend::Threads: each worker blocks in one pread/pwrite at a time
+        class ThreadQueue : public IoQueue
+        {
+        public:
+            ThreadQueue(int fd, unsigned threads) : fd_(fd)
+            {
+                for (unsigned i = 0; i < threads; ++i)
+                    workers_.emplace_back([this]
+                                          { run(); });
+            }
+
+            // Requests already queued still run, so no buffer is left mid-transfer
+            ~ThreadQueue() override
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mu_);
+                    stop_ = true;
+                }
+                work_.notify_all();
+                for (auto &t : workers_)
+                    t.join();
+            }
+
+            void submit(IoRequest &r) override
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mu_);
+                    r.done = false;
+                    queue_.push_back(&r);
+                }
+                work_.notify_one();
+            }
+
+            void wait(IoRequest &r) override
+            {
+                std::unique_lock<std::mutex> lock(mu_);
+                done_.wait(lock, [&r]
+                           { return r.done; });
+            }
+
+        private:
+            void run()
+            {
+                for (;;)
+                {
+                    IoRequest *r = nullptr;
+                    {
+                        std::unique_lock<std::mutex> lock(mu_);
+                        work_.wait(lock, [this]
+                                   { return stop_ || !queue_.empty(); });
+                        if (queue_.empty())
+                            return;
+                        r = queue_.front();
+                        queue_.pop_front();
+                    }
+                    transfer(fd_, *r);
+                    {
+                        std::lock_guard<std::mutex> lock(mu_);
+                        r->done = true;
+                    }
+                    done_.notify_all();
+                }
+            }
+
+            int fd_;
+            std::mutex mu_;
+            std::condition_variable work_, done_;
+            std::deque<IoRequest *> queue_;
+            bool stop_ = false;
+            std::vector<std::thread> workers_;
+        };
+
+#ifdef FC_ASYNC_URING
+        int uringEnter(int ring, unsigned toSubmit, unsigned minComplete, unsigned flags)
+        {
+            return static_cast<int>(::syscall(__NR_io_uring_enter, ring, toSubmit, minComplete, flags, nullptr, 0));
+        }
+
+        // Whether the kernel has plain IORING_OP_READ / WRITE (5.6+)
+        bool uringHasReadWrite(int ring)
+        {
+            constexpr unsigned OPS = 256;
+            std::vector<uint64_t> mem((sizeof(io_uring_probe) + OPS * sizeof(io_uring_probe_op)) / sizeof(uint64_t) + 1);
+            auto *probe = reinterpret_cast<io_uring_probe *>(mem.data());
+            if (::syscall(__NR_io_uring_register, ring, IORING_REGISTER_PROBE, probe, OPS) < 0)
+                return false;
+            auto supported = [probe](unsigned op)
+            {
+                return op <= probe->last_op && (probe->ops[op].flags & IO_URING_OP_SUPPORTED);
+            };
+            return supported(IORING_OP_READ) && supported(IORING_OP_WRITE);
+        }
+
+        // IoBackend::Uring: one ring per file, driven from the owning thread with no
+        // kernel polling thread. A short transfer is resubmitted for the rest.
+        class UringQueue : public IoQueue
+        {
+        public:
+            // nullptr when the kernel refuses a ring; probe also checks the opcodes
+            static std::unique_ptr<UringQueue> create(int fd, unsigned depth, bool probe = false)
+            {
+                std::unique_ptr<UringQueue> q(new UringQueue(fd));
+                if (!q->init(depth) || (probe && !uringHasReadWrite(q->ring_)))
+                    return nullptr;
+                return q;
+            }
+
+            // Reap what is still in flight before the caller frees the buffers
+            ~UringQueue() override
+            {
+                while (inFlight_ > 0 && broken_ == 0)
+                {
+                    reap();
+                    if (inFlight_ > 0)
+                        enter(0, 1, IORING_ENTER_GETEVENTS);
+                }
+                if (sqes_)
+                    ::munmap(sqes_, sqesSize_);
+                if (cqRing_ && cqRing_ != sqRing_)
+                    ::munmap(cqRing_, cqRingSize_);
+                if (sqRing_)
+                    ::munmap(sqRing_, sqRingSize_);
+                if (ring_ >= 0)
+                    ::close(ring_);
+            }
+
+            void submit(IoRequest &r) override
+            {
+                r.done = false;
+                ++inFlight_;
+                push(r);
+                flush();
+            }
+
+            void wait(IoRequest &r) override
+            {
+                while (!r.done)
+                {
+                    reap();
+                    if (!r.done && broken_ == 0)
+                        enter(0, 1, IORING_ENTER_GETEVENTS);
+                    if (!r.done && broken_ != 0)
+                    {
+                        // The ring itself failed; nothing more will complete
+                        r.error = broken_;
+                        r.done = true;
+                    }
+                }
+            }
+
+        private:
+            explicit UringQueue(int fd) : fd_(fd) {}
+
+            bool init(unsigned depth)
+            {
+                io_uring_params p;
+                std::memset(&p, 0, sizeof(p));
+                ring_ = static_cast<int>(::syscall(__NR_io_uring_setup, std::max(depth, 1u), &p));
+                if (ring_ < 0)
+                    return false;
+
+                sqRingSize_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+                cqRingSize_ = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+                const bool single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+                if (single)
+                    sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+                sqRing_ = map(sqRingSize_, IORING_OFF_SQ_RING);
+                cqRing_ = single ? sqRing_ : map(cqRingSize_, IORING_OFF_CQ_RING);
+                sqesSize_ = p.sq_entries * sizeof(io_uring_sqe);
+                sqes_ = static_cast<io_uring_sqe *>(map(sqesSize_, IORING_OFF_SQES));
+                if (!sqRing_ || !cqRing_ || !sqes_)
+                    return false;
+
+                auto field = [](void *ring, uint32_t offset)
+                {
+                    return reinterpret_cast<unsigned *>(static_cast<uint8_t *>(ring) + offset);
+                };
+                sqTail_ = field(sqRing_, p.sq_off.tail);
+                sqMask_ = *field(sqRing_, p.sq_off.ring_mask);
+                sqArray_ = field(sqRing_, p.sq_off.array);
+                cqHead_ = field(cqRing_, p.cq_off.head);
+                cqTail_ = field(cqRing_, p.cq_off.tail);
+                cqMask_ = *field(cqRing_, p.cq_off.ring_mask);
+                cqes_ = reinterpret_cast<io_uring_cqe *>(static_cast<uint8_t *>(cqRing_) + p.cq_off.cqes);
+                return true;
+            }
+
+            void *map(size_t size, off_t what)
+            {
+                void *p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_, what);
+                return (p == MAP_FAILED) ? nullptr : p;
+            }
+
+            // Queue the rest of r; flush() hands it to the kernel. Callers keep no more
+            // than the ring's entries in flight, so a free slot always exists.
+            void push(IoRequest &r)
+            {
+                const unsigned tail = *sqTail_; // only this thread moves the tail
+                const unsigned index = tail & sqMask_;
+                io_uring_sqe &e = sqes_[index];
+                std::memset(&e, 0, sizeof(e));
+                e.opcode = r.write ? IORING_OP_WRITE : IORING_OP_READ;
+                e.fd = fd_;
+                e.addr = reinterpret_cast<uint64_t>(r.data + r.transferred);
+                e.len = static_cast<uint32_t>(r.length - r.transferred);
+                e.off = r.offset + r.transferred;
+                e.user_data = reinterpret_cast<uint64_t>(&r);
+                sqArray_[index] = index;
+                __atomic_store_n(sqTail_, tail + 1, __ATOMIC_RELEASE);
+                ++unsubmitted_;
+            }
+
+            void flush()
+            {
+                while (unsubmitted_ > 0 && broken_ == 0)
+                {
+                    const int n = enter(unsubmitted_, 0, 0);
+                    if (n > 0)
+                        unsubmitted_ -= static_cast<unsigned>(n);
+                }
+            }
+
+            // io_uring_enter, retried on EINTR; any other failure marks the ring broken
+            int enter(unsigned toSubmit, unsigned minComplete, unsigned flags)
+            {
+                for (;;)
+                {
+                    const int n = uringEnter(ring_, toSubmit, minComplete, flags);
+                    if (n >= 0 && (n > 0 || toSubmit == 0))
+                        return n;
+                    if (n < 0 && errno == EINTR)
+                        continue;
+                    broken_ = (n < 0) ? errno : EIO;
+                    return -1;
+                }
+            }
+
+            void reap()
+            {
+                unsigned head = *cqHead_; // only this thread moves the head
+                const unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+                for (; head != tail; ++head)
+                {
+                    const io_uring_cqe &c = cqes_[head & cqMask_];
+                    complete(*reinterpret_cast<IoRequest *>(c.user_data), c.res);
+                }
+                __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+                flush(); // resubmitted remainders
+            }
+
+            void complete(IoRequest &r, int res)
+            {
+                if (res == -EINTR || res == -EAGAIN)
+                {
+                    push(r);
+                    return;
+                }
+                if (res < 0 || (res == 0 && r.write))
+                    r.error = (res < 0) ? -res : EIO;
+                else if (res > 0)
+                {
+                    r.transferred += static_cast<size_t>(res);
+                    if (r.transferred < r.length)
+                    {
+                        push(r);
+                        return;
+                    }
+                }
+                r.done = true; // res == 0 on a read: end of file
+                --inFlight_;
+            }
+
+            int fd_;
+            int ring_ = -1;
+            void *sqRing_ = nullptr;
+            void *cqRing_ = nullptr;
+            size_t sqRingSize_ = 0, cqRingSize_ = 0, sqesSize_ = 0;
+            io_uring_sqe *sqes_ = nullptr;
+            unsigned *sqTail_ = nullptr, *sqArray_ = nullptr;
+            unsigned *cqHead_ = nullptr, *cqTail_ = nullptr;
+            unsigned sqMask_ = 0, cqMask_ = 0;
+            io_uring_cqe *cqes_ = nullptr;
+            unsigned unsubmitted_ = 0;
+            unsigned inFlight_ = 0;
+            int broken_ = 0; // errno that ended the ring
+        };
+#endif
+
+        std::unique_ptr<IoQueue> makeQueue(int fd, const AsyncIoOptions &opt, unsigned depth, IoBackend &used, std::string *err)
+        {
+#ifdef FC_ASYNC_URING
+            if (opt.backend != IoBackend::Threads && uringAvailable())
+            {
+                if (auto q = UringQueue::create(fd, depth))
+                {
+                    used = IoBackend::Uring;
+                    return q;
+                }
+            }
+#endif
+            if (opt.backend == IoBackend::Uring)
+            {
+                if (err)
+                    *err = "async I/O: io_uring is not available here";
+                return nullptr;
+            }
+            used = IoBackend::Threads;
+            return std::make_unique<ThreadQueue>(fd, depth);
+        }
+
+        // A chunk buffer and the request that fills or drains it. The buffer is left
+        // uninitialized: every byte is read into or written before it is used.
+        struct IoSlot
+        {
+            std::unique_ptr<uint8_t[]> buf;
+            size_t capacity = 0;
+            IoRequest req;
+            bool busy = false; // req submitted and not yet waited for
+
+            void allocate(size_t n)
+            {
+                buf.reset(new uint8_t[n]);
+                capacity = n;
+            }
+        };
+#endif
+    }
+
+    bool uringAvailable()
+    {
+#ifdef FC_ASYNC_URING
+        static const bool yes = UringQueue::create(-1, 2, true) != nullptr;
+        return yes;
+#else
+        return false;
+#endif
+    }
+
+    const char *ioBackendName(IoBackend backend)
+    {
+        switch (backend)
+        {
+        case IoBackend::Threads:
+            return "threads";
+        case IoBackend::Uring:
+            return "io_uring";
+        default:
+            return "auto";
+        }
+    }
+
+#ifdef FC_ASYNC_POSIX
+    struct AsyncFileReader::Impl
+    {
+        ~Impl()
+        {
+            queue.reset(); // finishes reads still in flight
+            if (fd >= 0)
+                ::close(fd);
+        }
+
+        void schedule(IoSlot &s)
+        {
+            s.busy = false;
+            if (next >= size)
+                return;
+            s.req = IoRequest{};
+            s.req.data = s.buf.get();
+            s.req.length = static_cast<size_t>(std::min<uint64_t>(s.capacity, size - next));
+            s.req.offset = next;
+            next += s.req.length;
+            s.busy = true;
+            queue->submit(s.req);
+        }
+
+        // Drop the read-ahead and start it again at pos
+        void restart(uint64_t pos)
+        {
+            for (IoSlot &s : slots)
+            {
+                if (s.busy)
+                    queue->wait(s.req);
+            }
+            next = pos;
+            bufOffset = pos;
+            cur = 0;
+            exposed = false;
+            error.clear();
+            for (IoSlot &s : slots)
+                schedule(s);
+        }
+
+        int fd = -1;
+        uint64_t size = 0;      // file size at open
+        uint64_t next = 0;      // offset of the next read to schedule
+        uint64_t bufOffset = 0; // offset of the get area's first byte
+        std::vector<IoSlot> slots; // consumed round-robin from cur
+        size_t cur = 0;
+        bool exposed = false;   // the get area lies in slots[cur]
+        IoBackend backend = IoBackend::Threads;
+        std::string error;
+        std::unique_ptr<IoQueue> queue;
+    };
+
+    struct AsyncFileWriter::Impl
+    {
+        ~Impl()
+        {
+            queue.reset(); // finishes writes still in flight
+            if (fd >= 0)
+                ::close(fd);
+        }
+
+        // Wait for the write in s, if any; false once any write has failed
+        bool settle(IoSlot &s)
+        {
+            if (s.busy)
+            {
+                queue->wait(s.req);
+                s.busy = false;
+                if (s.req.error && error.empty())
+                    error = std::string("AsyncFileWriter: write failed: ") + std::strerror(s.req.error);
+            }
+            return error.empty();
+        }
+
+        int fd = -1;
+        uint64_t offset = 0; // file offset of the put area's first byte
+        std::vector<IoSlot> slots; // filled round-robin from cur
+        size_t cur = 0;
+        IoBackend backend = IoBackend::Threads;
+        std::string error;
+        std::unique_ptr<IoQueue> queue;
+    };
+#else
+    struct AsyncFileReader::Impl
+    {
+        IoBackend backend = IoBackend::Threads;
+        std::string error;
+    };
+
+    struct AsyncFileWriter::Impl
+    {
+        IoBackend backend = IoBackend::Threads;
+    };
+#endif
+
+    AsyncFileReader::AsyncFileReader() = default;
+    AsyncFileReader::~AsyncFileReader() = default;
+
+    bool AsyncFileReader::open(const std::string &path, const AsyncIoOptions &opt, std::string *err)
+    {
+        close();
+#ifdef FC_ASYNC_POSIX
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            if (err)
+                *err = "AsyncFileReader: cannot open " + path + ": " + std::strerror(errno);
+            return false;
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+        {
+            ::close(fd);
+            if (err)
+                *err = "AsyncFileReader: " + path + " is not a regular file";
+            return false;
+        }
+
+        auto m = std::make_unique<Impl>();
+        m->fd = fd;
+        m->size = static_cast<uint64_t>(st.st_size);
+        // Small files get small buffers
+        const size_t chunk = static_cast<size_t>(std::min<uint64_t>(std::max<size_t>(opt.chunkSize, 1), std::max<uint64_t>(m->size, 1)));
+        const unsigned depth = std::max(opt.depth, 1u);
+        m->slots.resize(depth);
+        for (IoSlot &s : m->slots)
+            s.allocate(chunk);
+        m->queue = makeQueue(fd, opt, depth, m->backend, err);
+        if (!m->queue)
+            return false; // m closes fd
+        impl_ = std::move(m);
+        impl_->restart(0);
+        return true;
+#else
+        (void)path;
+        (void)opt;
+        if (err)
+            *err = "AsyncFileReader: needs pread (POSIX)";
+        return false;
+#endif
+    }
+
+    void AsyncFileReader::close()
+    {
+        setg(nullptr, nullptr, nullptr);
+        impl_.reset();
+    }
+
+    IoBackend AsyncFileReader::backend() const
+    {
+        return impl_ ? impl_->backend : IoBackend::Auto;
+    }
+
+    const std::string &AsyncFileReader::error() const
+    {
+        static const std::string none;
+        return impl_ ? impl_->error : none;
+    }
+
+    AsyncFileReader::int_type AsyncFileReader::underflow()
+    {
+#ifdef FC_ASYNC_POSIX
+        if (gptr() < egptr())
+            return traits_type::to_int_type(*gptr());
+        if (!impl_)
+            return traits_type::eof();
+        Impl &m = *impl_;
+        if (m.exposed)
+        {
+            // Reuse the spent chunk for the next read-ahead
+            m.bufOffset += static_cast<uint64_t>(egptr() - eback());
+            m.schedule(m.slots[m.cur]);
+            m.cur = (m.cur + 1) % m.slots.size();
+            m.exposed = false;
+            setg(nullptr, nullptr, nullptr);
+        }
+
+        IoSlot &s = m.slots[m.cur];
+        if (!s.busy)
+            return traits_type::eof(); // past the end, or after a failed read
+        m.queue->wait(s.req);
+        s.busy = false;
+        if (s.req.error)
+        {
+            m.error = std::string("AsyncFileReader: read failed: ") + std::strerror(s.req.error);
+            return traits_type::eof();
+        }
+        if (s.req.transferred == 0)
+            return traits_type::eof();
+        char *p = reinterpret_cast<char *>(s.buf.get());
+        setg(p, p, p + s.req.transferred);
+        m.bufOffset = s.req.offset;
+        m.exposed = true;
+        return traits_type::to_int_type(*gptr());
+#else
+        return traits_type::eof();
+#endif
+    }
+
+    AsyncFileReader::pos_type AsyncFileReader::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which)
+    {
+#ifdef FC_ASYNC_POSIX
+        if (!impl_ || !(which & std::ios_base::in))
+            return pos_type(off_type(-1));
+        const Impl &m = *impl_;
+        const off_type here = static_cast<off_type>(m.bufOffset + (m.exposed ? static_cast<uint64_t>(gptr() - eback()) : 0));
+        if (dir == std::ios_base::cur && off == 0)
+            return pos_type(here); // tellg: keep the read-ahead
+        off_type target = off;
+        if (dir == std::ios_base::cur)
+            target += here;
+        else if (dir == std::ios_base::end)
+            target += static_cast<off_type>(m.size);
+        return seekpos(pos_type(target), which);
+#else
+        (void)off;
+        (void)dir;
+        (void)which;
+        return pos_type(off_type(-1));
+#endif
+    }
+
+    AsyncFileReader::pos_type AsyncFileReader::seekpos(pos_type pos, std::ios_base::openmode which)
+    {
+#ifdef FC_ASYNC_POSIX
+        const off_type target = static_cast<off_type>(pos);
+        if (!impl_ || !(which & std::ios_base::in) || target < 0 || static_cast<uint64_t>(target) > impl_->size)
+            return pos_type(off_type(-1));
+        Impl &m = *impl_;
+        const uint64_t to = static_cast<uint64_t>(target);
+        if (m.exposed && to >= m.bufOffset && to <= m.bufOffset + static_cast<uint64_t>(egptr() - eback()))
+        {
+            setg(eback(), eback() + (to - m.bufOffset), egptr());
+            return pos;
+        }
+        setg(nullptr, nullptr, nullptr);
+        m.restart(to);
+        return pos;
+#else
+        (void)which;
+        (void)pos;
+        return pos_type(off_type(-1));
+#endif
+    }
+
+    AsyncFileWriter::AsyncFileWriter() = default;
+
+    AsyncFileWriter::~AsyncFileWriter()
+    {
+        close(nullptr);
+    }
+
+    bool AsyncFileWriter::open(const std::string &path, const AsyncIoOptions &opt, std::string *err)
+    {
+        close(nullptr);
+#ifdef FC_ASYNC_POSIX
+        const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+        if (fd < 0)
+        {
+            if (err)
+                *err = "AsyncFileWriter: cannot create " + path + ": " + std::strerror(errno);
+            return false;
+        }
+        auto m = std::make_unique<Impl>();
+        m->fd = fd;
+        const unsigned depth = std::max(opt.depth, 1u);
+        m->slots.resize(depth);
+        for (IoSlot &s : m->slots)
+            s.allocate(std::max<size_t>(opt.chunkSize, 1));
+        m->queue = makeQueue(fd, opt, depth, m->backend, err);
+        if (!m->queue)
+            return false;
+        impl_ = std::move(m);
+        char *p = reinterpret_cast<char *>(impl_->slots[0].buf.get());
+        setp(p, p + impl_->slots[0].capacity);
+        return true;
+#else
+        (void)path;
+        (void)opt;
+        if (err)
+            *err = "AsyncFileWriter: needs pwrite (POSIX)";
+        return false;
+#endif
+    }
+
+    bool AsyncFileWriter::close(std::string *err)
+    {
+        if (!impl_)
+            return true;
+        bool ok = sync() == 0;
+#ifdef FC_ASYNC_POSIX
+        Impl &m = *impl_;
+        m.queue.reset();
+        if (::close(m.fd) != 0 && ok)
+        {
+            m.error = std::string("AsyncFileWriter: close failed: ") + std::strerror(errno);
+            ok = false;
+        }
+        m.fd = -1;
+        if (!ok && err)
+            *err = m.error;
+#else
+        (void)err;
+#endif
+        setp(nullptr, nullptr);
+        impl_.reset();
+        return ok;
+    }
+
+    IoBackend AsyncFileWriter::backend() const
+    {
+        return impl_ ? impl_->backend : IoBackend::Auto;
+    }
+
+    bool AsyncFileWriter::submitPut()
+    {
+#ifdef FC_ASYNC_POSIX
+        Impl &m = *impl_;
+        const size_t n = static_cast<size_t>(pptr() - pbase());
+        if (n > 0 && m.error.empty())
+        {
+            IoSlot &s = m.slots[m.cur];
+            s.req = IoRequest{};
+            s.req.data = s.buf.get();
+            s.req.length = n;
+            s.req.offset = m.offset;
+            s.req.write = true;
+            m.offset += n;
+            s.busy = true;
+            m.queue->submit(s.req);
+            m.cur = (m.cur + 1) % m.slots.size();
+        }
+        IoSlot &next = m.slots[m.cur];
+        const bool ok = m.settle(next);
+        char *p = reinterpret_cast<char *>(next.buf.get());
+        setp(p, p + next.capacity);
+        return ok;
+#else
+        return false;
+#endif
+    }
+
+    AsyncFileWriter::int_type AsyncFileWriter::overflow(int_type c)
+    {
+        if (!impl_ || !submitPut())
+            return traits_type::eof();
+        if (!traits_type::eq_int_type(c, traits_type::eof()))
+        {
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    int AsyncFileWriter::sync()
+    {
+        if (!impl_ || !submitPut())
+            return -1;
+#ifdef FC_ASYNC_POSIX
+        bool ok = true;
+        for (IoSlot &s : impl_->slots)
+            ok = impl_->settle(s) && ok;
+        return ok ? 0 : -1;
+#else
+        return -1;
+#endif
+    }
+
+} // namespace fc
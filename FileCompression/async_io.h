@@ -0,0 +1,88 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <streambuf>
+#include <string>
+
+namespace fc
+{
+
+    // How AsyncFileReader / AsyncFileWriter move bytes to and from the file
+    enum class IoBackend : uint8_t
+    {
+        Auto = 0,    // io_uring where this build and the kernel allow it, else Threads
+        Threads = 1, // pread/pwrite on a small pool of threads
+        Uring = 2    // Linux io_uring (5.6+), driven through the raw syscalls
+    };
+
+    struct AsyncIoOptions
+    {
+        IoBackend backend = IoBackend::Auto;
+        size_t chunkSize = 256 * 1024; // bytes per read or write request
+        unsigned depth = 4;            // requests kept in flight per file
+    };
+
+    // Whether IoBackend::Uring works here: compiled in, and the kernel accepts a ring
+    // and its read/write opcodes (containers and seccomp profiles often refuse them)
+    bool uringAvailable();
+    const char *ioBackendName(IoBackend backend);
+
+    // Sequential file input for an std::istream, keeping opt.depth chunk reads in flight
+    // ahead of the consumer, so decoding and device reads overlap. Seeking drops the
+    // read-ahead and restarts it at the new position. Regular files only.
+    class AsyncFileReader : public std::streambuf
+    {
+    public:
+        AsyncFileReader();
+        ~AsyncFileReader() override;
+        AsyncFileReader(const AsyncFileReader &) = delete;
+        AsyncFileReader &operator=(const AsyncFileReader &) = delete;
+
+        bool open(const std::string &path, const AsyncIoOptions &opt, std::string *err);
+        void close();
+        // The backend open() settled on
+        IoBackend backend() const;
+        // Why input ended early, if a read failed; empty otherwise
+        const std::string &error() const;
+
+    protected:
+        int_type underflow() override;
+        pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override;
+        pos_type seekpos(pos_type pos, std::ios_base::openmode which) override;
+
+    private:
+        struct Impl;
+        std::unique_ptr<Impl> impl_;
+    };
+
+    // Sequential file output for an std::ostream. Each full chunk is handed to the
+    // backend as a write at its own offset while the next one fills, up to opt.depth
+    // in flight; flush() waits for all of them. Call close() to learn whether every
+    // write landed; the destructor closes without reporting.
+    class AsyncFileWriter : public std::streambuf
+    {
+    public:
+        AsyncFileWriter();
+        ~AsyncFileWriter() override;
+        AsyncFileWriter(const AsyncFileWriter &) = delete;
+        AsyncFileWriter &operator=(const AsyncFileWriter &) = delete;
+
+        // Creates or truncates path
+        bool open(const std::string &path, const AsyncIoOptions &opt, std::string *err);
+        bool close(std::string *err);
+        IoBackend backend() const;
+
+    protected:
+        int_type overflow(int_type c) override;
+        int sync() override;
+
+    private:
+        // Send the filled put area and make the next slot's buffer the put area
+        bool submitPut();
+
+        struct Impl;
+        std::unique_ptr<Impl> impl_;
+    };
+
+} // namespace fc
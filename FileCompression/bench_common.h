@@ -0,0 +1,130 @@
+#pragma once
+// Fixtures shared by the fc_*_bench tools and fc_huffman_check: a seeded generator,
+// generated inputs and match-level names. Header-only, so each tool's build line is
+// unchanged.
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include "lz77.h"
+
+namespace fc
+{
+    namespace bench
+    {
+
+        // xorshift64*: fixed seeds keep generated inputs identical across builds and hosts
+        class Rng
+        {
+        public:
+            explicit Rng(uint64_t seed) : s_(seed ? seed : 1) {}
+            uint64_t next()
+            {
+                s_ ^= s_ >> 12;
+                s_ ^= s_ << 25;
+                s_ ^= s_ >> 27;
+                return s_ * 0x2545F4914F6CDD1Dull;
+            }
+            uint32_t below(uint32_t n) { return static_cast<uint32_t>((next() >> 32) % n); }
+            // Skewed towards small values, roughly like word frequencies
+            uint32_t skewed(uint32_t n)
+            {
+                double u = static_cast<double>(next() >> 11) / 9007199254740992.0;
+                return static_cast<uint32_t>(u * u * u * n);
+            }
+
+        private:
+            uint64_t s_;
+        };
+
+        inline const char *const WORDS[] = {
+            "the", "of", "and", "to", "in", "a", "is", "that", "for", "it", "as", "was", "with", "be", "by",
+            "on", "not", "he", "this", "are", "or", "his", "from", "at", "which", "but", "have", "an", "had",
+            "they", "you", "were", "their", "one", "all", "we", "can", "her", "has", "there", "been", "if",
+            "more", "when", "will", "would", "who", "so", "no", "time", "data", "block", "stream", "window",
+            "system", "between", "because", "compression", "history", "without", "through", "another",
+            "number", "people", "within", "different", "following", "important", "government", "however",
+            "information", "development", "experience", "particular", "understand", "relationship"};
+        constexpr uint32_t WORD_COUNT = sizeof(WORDS) / sizeof(WORDS[0]);
+
+        // English-like sentences over WORDS with skewed word frequencies
+        inline std::string makeText(size_t size, uint64_t seed)
+        {
+            Rng rng(seed);
+            std::string s;
+            s.reserve(size + 64);
+            while (s.size() < size)
+            {
+                uint32_t words = 6 + rng.below(18);
+                for (uint32_t i = 0; i < words; ++i)
+                {
+                    std::string w = WORDS[rng.skewed(WORD_COUNT)];
+                    if (i == 0)
+                        w[0] = static_cast<char>(w[0] - 'a' + 'A');
+                    s += w;
+                    s += (i + 1 == words) ? (rng.below(8) == 0 ? "?" : ".") : (rng.below(12) == 0 ? ", " : " ");
+                }
+                s += rng.below(5) == 0 ? "\n\n" : " ";
+            }
+            s.resize(size);
+            return s;
+        }
+
+        // Incompressible: nothing but literals
+        inline std::string makeRandom(size_t size, uint64_t seed)
+        {
+            Rng rng(seed);
+            std::string s(size, '\0');
+            for (auto &c : s)
+                c = static_cast<char>(rng.next() >> 56);
+            return s;
+        }
+
+        // Long matches: a short pattern repeated, with a rare one-byte mutation
+        inline std::string makeRepetitive(size_t size, uint64_t seed)
+        {
+            Rng rng(seed);
+            const std::string pattern = "GET /api/v1/items?page=1 HTTP/1.1 200 OK 0.003s\n";
+            std::string s;
+            s.reserve(size + pattern.size());
+            while (s.size() < size)
+            {
+                s += pattern;
+                if (rng.below(64) == 0)
+                    s[s.size() - 1 - rng.below(static_cast<uint32_t>(pattern.size()))] = static_cast<char>('0' + rng.below(10));
+            }
+            s.resize(size);
+            return s;
+        }
+
+        inline bool parseLevel(const std::string &name, CompressionLevel &level)
+        {
+            if (name == "fastest")
+                level = CompressionLevel::Fastest;
+            else if (name == "greedy")
+                level = CompressionLevel::Greedy;
+            else if (name == "lazy")
+                level = CompressionLevel::Lazy;
+            else if (name == "optimal")
+                level = CompressionLevel::Optimal;
+            else
+                return false;
+            return true;
+        }
+
+        inline const char *levelName(CompressionLevel level)
+        {
+            switch (level)
+            {
+            case CompressionLevel::Fastest:
+                return "fastest";
+            case CompressionLevel::Lazy:
+                return "lazy";
+            case CompressionLevel::Optimal:
+                return "optimal";
+            default:
+                return "greedy";
+            }
+        }
+
+    } // namespace bench
+} // namespace fc
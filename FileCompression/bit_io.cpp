@@ -1,29 +1,151 @@
 #include "bit_io.h"
 #include <ostream>
 #include <istream>
+#include <algorithm>
 
 namespace fc
 {
+    namespace
+    {
+        inline void storeLE64(uint8_t *p, uint64_t v)
+        {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            for (int i = 0; i < 8; ++i)
+                p[i] = static_cast<uint8_t>(v >> (i * 8));
+#else
+            std::memcpy(p, &v, 8);
+#endif
+        }
+
+        inline uint64_t loadLE64(const uint8_t *p)
+        {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            uint64_t v = 0;
+            for (int i = 0; i < 8; ++i)
+                v |= static_cast<uint64_t>(p[i]) << (i * 8);
+            return v;
+#else
+            uint64_t v;
+            std::memcpy(&v, p, 8);
+            return v;
+#endif
+        }
+    }
+
+    BitWriter::BitWriter(std::ostream &out, size_t bufferSize)
+        : out_(&out), own_(std::max<size_t>(bufferSize, 64))
+    {
+        begin_ = cur_ = own_.data();
+        end_ = begin_ + own_.size();
+    }
 
-    BitWriter::BitWriter(std::ostream &out)
-        : out_(&out), buf_(0), bitCount_(0), totalBits_(0) {}
+    BitWriter::BitWriter(std::ostream &out, std::vector<uint8_t> &staging)
+        : out_(&out), lent_(&staging)
+    {
+        own_.swap(staging);
+        if (own_.size() < DEFAULT_BUFFER)
+            own_.resize(DEFAULT_BUFFER);
+        begin_ = cur_ = own_.data();
+        end_ = begin_ + own_.size();
+    }
+
+    BitWriter::BitWriter(std::vector<uint8_t> &out)
+        : vec_(&out)
+    {
+        // Pointers are set up lazily by drain() once the vector has room
+        size_t used = out.size();
+        begin_ = cur_ = end_ = out.data() + used;
+    }
 
-    void BitWriter::writeBits(uint32_t value, int nbits)
+    BitWriter::BitWriter(uint8_t *dst, size_t capacity)
+        : begin_(dst), cur_(dst), end_(dst + capacity) {}
+
+    BitWriter::~BitWriter()
     {
-        if (nbits <= 0)
+        flush();
+        if (lent_)
+            lent_->swap(own_);
+    }
+
+    void BitWriter::storeWord()
+    {
+        // Whole 8-byte store, of which the low 4 bytes are committed
+        if (end_ - cur_ >= 8)
+        {
+            storeLE64(cur_, buf_);
+            cur_ += 4;
+        }
+        else
+        {
+            for (int i = 0; i < 4; ++i)
+                putByte(static_cast<uint8_t>(buf_ >> (i * 8)));
+        }
+        buf_ >>= 32;
+        bitCount_ -= 32;
+    }
+
+    void BitWriter::putByte(uint8_t b)
+    {
+        if (cur_ == end_)
+        {
+            drain();
+            if (cur_ == end_)
+            {
+                ok_ = false; // fixed span is full
+                return;
+            }
+        }
+        *cur_++ = b;
+    }
+
+    void BitWriter::drain()
+    {
+        if (out_)
+        {
+            out_->write(reinterpret_cast<const char *>(begin_), cur_ - begin_);
+            if (!*out_)
+                ok_ = false;
+            cur_ = begin_;
+        }
+        else if (vec_)
+        {
+            size_t used = static_cast<size_t>(cur_ - vec_->data());
+            vec_->resize(std::max<size_t>(vec_->size() * 2, used + DEFAULT_BUFFER));
+            begin_ = vec_->data();
+            cur_ = begin_ + used;
+            end_ = begin_ + vec_->size();
+        }
+    }
+
+    void BitWriter::writeBytes(const uint8_t *data, size_t n)
+    {
+        alignToByte();
+        totalBits_ += n * 8;
+        if (out_ && n >= own_.size())
+        {
+            // Large copies bypass the staging buffer
+            drain();
+            out_->write(reinterpret_cast<const char *>(data), static_cast<std::streamsize>(n));
+            if (!*out_)
+                ok_ = false;
             return;
-        // Mask to nbits
-        if (nbits < 32)
-            value &= ((1u << nbits) - 1u);
-        buf_ |= (static_cast<uint64_t>(value) << bitCount_);
-        bitCount_ += nbits;
-        totalBits_ += static_cast<size_t>(nbits);
-        while (bitCount_ >= 8)
-        {
-            unsigned char byte = static_cast<unsigned char>(buf_ & 0xFFu);
-            out_->put(static_cast<char>(byte));
-            buf_ >>= 8;
-            bitCount_ -= 8;
+        }
+        while (n > 0)
+        {
+            if (cur_ == end_)
+            {
+                drain();
+                if (cur_ == end_)
+                {
+                    ok_ = false;
+                    return;
+                }
+            }
+            size_t chunk = std::min<size_t>(n, static_cast<size_t>(end_ - cur_));
+            std::memcpy(cur_, data, chunk);
+            cur_ += chunk;
+            data += chunk;
+            n -= chunk;
         }
     }
 
@@ -35,60 +157,123 @@ namespace fc
             int pad = 8 - rem;
             writeBits(0, pad);
         }
+        while (bitCount_ > 0)
+        {
+            putByte(static_cast<uint8_t>(buf_ & 0xFFu));
+            buf_ >>= 8;
+            bitCount_ -= 8;
+        }
     }
 
     void BitWriter::flush()
     {
-        if (bitCount_ > 0)
+        alignToByte();
+        if (out_)
         {
-            unsigned char byte = static_cast<unsigned char>(buf_ & 0xFFu);
-            out_->put(static_cast<char>(byte));
-            buf_ >>= 8;
-            bitCount_ = 0;
+            drain();
+            out_->flush();
+        }
+        else if (vec_)
+        {
+            size_t used = static_cast<size_t>(cur_ - vec_->data());
+            vec_->resize(used);
+            begin_ = cur_ = end_ = vec_->data() + used;
         }
-        out_->flush();
     }
 
-    BitReader::BitReader(std::istream &in)
-        : in_(&in), buf_(0), bitCount_(0), eof_(false) {}
+    BitReader::BitReader(std::istream &in, size_t bufferSize)
+        : in_(&in), own_(std::max<size_t>(bufferSize, 64))
+    {
+        cur_ = end_ = own_.data();
+    }
+
+    BitReader::BitReader(std::istream &in, std::vector<uint8_t> &staging)
+        : in_(&in), lent_(&staging)
+    {
+        own_.swap(staging);
+        if (own_.size() < DEFAULT_BUFFER)
+            own_.resize(DEFAULT_BUFFER);
+        cur_ = end_ = own_.data();
+    }
+
+    BitReader::BitReader(const uint8_t *data, size_t size)
+        : cur_(data), end_(data + size), eof_(true) {}
+
+    BitReader::~BitReader()
+    {
+        if (lent_)
+            lent_->swap(own_);
+    }
+
+    bool BitReader::fillBuffer()
+    {
+        if (eof_ || !in_)
+            return false;
+        // Keep the unread tail, then top up with one large read
+        size_t tail = static_cast<size_t>(end_ - cur_);
+        std::memmove(own_.data(), cur_, tail);
+        in_->read(reinterpret_cast<char *>(own_.data() + tail), static_cast<std::streamsize>(own_.size() - tail));
+        size_t n = static_cast<size_t>(in_->gcount());
+        if (tail + n < own_.size())
+            eof_ = true;
+        cur_ = own_.data();
+        end_ = cur_ + tail + n;
+        return n > 0;
+    }
 
-    bool BitReader::readBits(int nbits, uint32_t &value)
+    void BitReader::refill()
     {
-        if (nbits <= 0)
+        if (end_ - cur_ < 8)
+            fillBuffer();
+        if (end_ - cur_ >= 8)
         {
-            value = 0;
-            return true;
+            // Branch-free refill: load a word, keep as many whole bytes as fit.
+            // Bits above bitCount_ mirror the bytes at cur_, so re-OR'ing them later is harmless.
+            buf_ |= loadLE64(cur_) << bitCount_;
+            int bytes = (63 - bitCount_) >> 3;
+            cur_ += bytes;
+            bitCount_ += bytes * 8;
+            return;
         }
-        while (bitCount_ < nbits && !eof_)
+        while (bitCount_ <= 56 && cur_ < end_)
         {
-            int ch = in_->get();
-            if (ch == EOF)
-            {
-                eof_ = true;
-                break;
-            }
-            buf_ |= (static_cast<uint64_t>(static_cast<unsigned char>(ch)) << bitCount_);
+            buf_ |= static_cast<uint64_t>(*cur_++) << bitCount_;
             bitCount_ += 8;
         }
-        if (bitCount_ < nbits)
+    }
+
+    bool BitReader::readBytes(uint8_t *dst, size_t n)
+    {
+        alignToByte();
+        while (n > 0 && bitCount_ >= 8)
         {
-            // Not enough bits
-            return false;
+            *dst++ = static_cast<uint8_t>(buf_ & 0xFFu);
+            consume(8);
+            --n;
+        }
+        if (bitCount_ == 0)
+            buf_ = 0; // drop look-ahead bits; cur_ moves independently below
+        while (n > 0)
+        {
+            if (cur_ == end_ && !fillBuffer())
+                return false;
+            size_t chunk = std::min<size_t>(n, static_cast<size_t>(end_ - cur_));
+            std::memcpy(dst, cur_, chunk);
+            cur_ += chunk;
+            dst += chunk;
+            n -= chunk;
         }
-        uint32_t mask = (nbits >= 32) ? 0xFFFFFFFFu : ((1u << nbits) - 1u);
-        value = static_cast<uint32_t>(buf_ & mask);
-        buf_ >>= nbits;
-        bitCount_ -= nbits;
         return true;
     }
 
     bool BitReader::alignToByte()
     {
+        // Buffered bits are whole bytes plus the unread tail of the current byte
         int rem = bitCount_ & 7;
         if (rem == 0)
-            return !eof_ || bitCount_ > 0;
-        uint32_t dummy;
-        return readBits(8 - rem, dummy);
+            return bitCount_ > 0 || cur_ < end_ || !eof_;
+        consume(rem);
+        return true;
     }
 
 } // namespace fc
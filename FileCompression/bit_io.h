@@ -1,44 +1,140 @@
 #pragma once
 #include <cstdint>
 #include <cstddef>
+#include <cstring>
 #include <iosfwd>
+#include <vector>
 
 namespace fc
 {
 
+    // Bits are packed LSB-first into a 64-bit accumulator and moved to/from an internal
+    // byte buffer with whole-word stores/loads (little-endian hosts). Stream targets are
+    // flushed/filled in large chunks; memory targets are read/written in place.
     class BitWriter
     {
     public:
-        explicit BitWriter(std::ostream &out);
-        // LSB-first: write lowest nbits of value into the stream
-        void writeBits(uint32_t value, int nbits);
-        // Pad to next byte with zeros and flush remaining bytes
+        static constexpr size_t DEFAULT_BUFFER = 64 * 1024;
+
+        explicit BitWriter(std::ostream &out, size_t bufferSize = DEFAULT_BUFFER);
+        // Stream target staged in the caller's buffer, handed back (grown to at least
+        // DEFAULT_BUFFER) on destruction, so repeated writers need not allocate
+        BitWriter(std::ostream &out, std::vector<uint8_t> &staging);
+        // Append to a growable vector
+        explicit BitWriter(std::vector<uint8_t> &out);
+        // Write into a caller-provided span; ok() turns false on overflow
+        BitWriter(uint8_t *dst, size_t capacity);
+        ~BitWriter();
+        BitWriter(const BitWriter &) = delete;
+        BitWriter &operator=(const BitWriter &) = delete;
+
+        // LSB-first: write lowest nbits (<= 32) of value into the stream
+        void writeBits(uint32_t value, int nbits)
+        {
+            if (nbits <= 0)
+                return;
+            if (nbits < 32)
+                value &= ((1u << nbits) - 1u);
+            buf_ |= (static_cast<uint64_t>(value) << bitCount_);
+            bitCount_ += nbits;
+            totalBits_ += static_cast<size_t>(nbits);
+            if (bitCount_ >= 32)
+                storeWord();
+        }
+        // Byte-aligned raw copy (pads to a byte boundary first)
+        void writeBytes(const uint8_t *data, size_t n);
+        // Pad to next byte with zeros
         void alignToByte();
+        // Pad, then hand all buffered bytes to the target (and flush a stream target)
         void flush();
         size_t totalBits() const { return totalBits_; }
+        // Bytes emitted so far, including those still buffered
+        size_t bytesWritten() const { return (totalBits_ + 7) / 8; }
+        bool ok() const { return ok_; }
 
     private:
-        std::ostream *out_;
-        uint64_t buf_;
-        int bitCount_;
-        size_t totalBits_;
+        void storeWord();
+        void putByte(uint8_t b);
+        void drain();
+
+        std::ostream *out_ = nullptr;
+        std::vector<uint8_t> *vec_ = nullptr;
+        std::vector<uint8_t> own_; // staging buffer for stream targets
+        std::vector<uint8_t> *lent_ = nullptr; // where own_ came from, if borrowed
+        uint8_t *begin_ = nullptr;
+        uint8_t *cur_ = nullptr;
+        uint8_t *end_ = nullptr;
+        uint64_t buf_ = 0;
+        int bitCount_ = 0;
+        size_t totalBits_ = 0;
+        bool ok_ = true;
     };
 
     class BitReader
     {
     public:
-        explicit BitReader(std::istream &in);
-        // LSB-first: read nbits into value; return false on EOF/underflow
-        bool readBits(int nbits, uint32_t &value);
+        static constexpr size_t DEFAULT_BUFFER = 64 * 1024;
+
+        explicit BitReader(std::istream &in, size_t bufferSize = DEFAULT_BUFFER);
+        // Stream source staged in the caller's buffer, as for BitWriter
+        BitReader(std::istream &in, std::vector<uint8_t> &staging);
+        // Read from a caller-provided span
+        BitReader(const uint8_t *data, size_t size);
+        ~BitReader();
+        BitReader(const BitReader &) = delete;
+        BitReader &operator=(const BitReader &) = delete;
+
+        // LSB-first: read nbits (<= 32) into value; return false on EOF/underflow
+        bool readBits(int nbits, uint32_t &value)
+        {
+            if (nbits <= 0)
+            {
+                value = 0;
+                return true;
+            }
+            if (bitCount_ < nbits)
+            {
+                refill();
+                if (bitCount_ < nbits)
+                    return false; // Not enough bits
+            }
+            value = static_cast<uint32_t>(buf_ & ((1ull << nbits) - 1ull));
+            consume(nbits);
+            return true;
+        }
+        // Look at the next nbits (<= 32) without consuming them; bits past EOF read as zero
+        uint32_t peekBits(int nbits)
+        {
+            if (bitCount_ < nbits)
+                refill();
+            return static_cast<uint32_t>(buf_ & ((1ull << nbits) - 1ull));
+        }
+        // Drop nbits after a peek; caller must not consume more than bitsAvailable()
+        void consume(int nbits)
+        {
+            buf_ >>= nbits;
+            bitCount_ -= nbits;
+        }
+        // Bits buffered after the last peek/read
+        int bitsAvailable() const { return bitCount_; }
+        // Byte-aligned raw copy (discards bits up to the byte boundary first)
+        bool readBytes(uint8_t *dst, size_t n);
         // Discard to next byte boundary; return false if already at EOF and no buffered bits
         bool alignToByte();
-        bool eof() const { return eof_ && bitCount_ == 0; }
+        bool eof() const { return eof_ && bitCount_ == 0 && cur_ == end_; }
 
     private:
-        std::istream *in_;
-        uint64_t buf_;
-        int bitCount_;
-        bool eof_;
+        void refill();
+        bool fillBuffer();
+
+        std::istream *in_ = nullptr;
+        std::vector<uint8_t> own_; // staging buffer for stream sources
+        std::vector<uint8_t> *lent_ = nullptr;
+        const uint8_t *cur_ = nullptr;
+        const uint8_t *end_ = nullptr;
+        uint64_t buf_ = 0;
+        int bitCount_ = 0;
+        bool eof_ = false;
     };
 
 } // namespace fc
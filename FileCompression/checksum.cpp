@@ -0,0 +1,195 @@
+#include "checksum.h"
+#include <cstring>
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define FC_CRC32_PCLMUL 1
+#endif
+
+namespace fc
+{
+    namespace
+    {
+        constexpr uint32_t CRC32_POLY = 0xEDB88320u;
+
+        // Slicing-by-8: t[k][b] is the CRC of byte b followed by k zero bytes, so eight
+        // input bytes fold into the CRC with eight independent lookups
+        struct Crc32Table
+        {
+            uint32_t t[8][256];
+            Crc32Table()
+            {
+                for (uint32_t i = 0; i < 256; ++i)
+                {
+                    uint32_t c = i;
+                    for (int k = 0; k < 8; ++k)
+                        c = (c & 1u) ? (CRC32_POLY ^ (c >> 1)) : (c >> 1);
+                    t[0][i] = c;
+                }
+                for (uint32_t i = 0; i < 256; ++i)
+                    for (int k = 1; k < 8; ++k)
+                        t[k][i] = t[0][t[k - 1][i] & 0xFFu] ^ (t[k - 1][i] >> 8);
+            }
+        };
+
+        const Crc32Table &crcTable()
+        {
+            static const Crc32Table table;
+            return table;
+        }
+
+        // Takes and returns the pre-inverted register (~crc)
+        uint32_t crc32Slice8(uint32_t c, const uint8_t *data, size_t size)
+        {
+            const auto &t = crcTable().t;
+            for (; size >= 8; data += 8, size -= 8)
+            {
+                uint32_t lo, hi;
+                std::memcpy(&lo, data, 4); // little-endian hosts, as BitWriter assumes
+                std::memcpy(&hi, data + 4, 4);
+                lo ^= c;
+                c = t[7][lo & 0xFFu] ^ t[6][(lo >> 8) & 0xFFu] ^ t[5][(lo >> 16) & 0xFFu] ^ t[4][lo >> 24] ^
+                    t[3][hi & 0xFFu] ^ t[2][(hi >> 8) & 0xFFu] ^ t[1][(hi >> 16) & 0xFFu] ^ t[0][hi >> 24];
+            }
+            for (; size > 0; ++data, --size)
+                c = t[0][(c ^ *data) & 0xFFu] ^ (c >> 8);
+            return c;
+        }
+
+#ifdef FC_CRC32_PCLMUL
+#define FC_TARGET_CLMUL __attribute__((target("pclmul,sse4.1")))
+
+        FC_TARGET_CLMUL inline __m128i load128(const uint8_t *p)
+        {
+            return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        }
+
+        // x carried 128 bits further by the constants in k, then xored onto next
+        FC_TARGET_CLMUL inline __m128i fold128(__m128i x, __m128i k, __m128i next)
+        {
+            return _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x, k, 0x00), _mm_clmulepi64_si128(x, k, 0x11)), next);
+        }
+
+        // Carry-less multiply folding (Intel, "Fast CRC Computation for Generic Polynomials
+        // Using PCLMULQDQ"), with the reflected gzip-polynomial constants zlib and the
+        // Linux kernel use. size must be a multiple of 16 and at least 64; takes and
+        // returns the pre-inverted register.
+        FC_TARGET_CLMUL uint32_t crc32Clmul(uint32_t c, const uint8_t *data, size_t size)
+        {
+            const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596, 0x0154442bd4);
+            const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009e, 0x01751997d0);
+            const __m128i k5k0 = _mm_set_epi64x(0, 0x0163cd6124);
+            const __m128i poly = _mm_set_epi64x(0x01f7011641, 0x01db710641);
+
+            // Four independent 128-bit lanes, 64 bytes per step
+            __m128i x1 = _mm_xor_si128(load128(data), _mm_cvtsi32_si128(static_cast<int>(c)));
+            __m128i x2 = load128(data + 16), x3 = load128(data + 32), x4 = load128(data + 48);
+            data += 64;
+            size -= 64;
+            for (; size >= 64; data += 64, size -= 64)
+            {
+                x1 = fold128(x1, k1k2, load128(data));
+                x2 = fold128(x2, k1k2, load128(data + 16));
+                x3 = fold128(x3, k1k2, load128(data + 32));
+                x4 = fold128(x4, k1k2, load128(data + 48));
+            }
+            x1 = fold128(x1, k3k4, x2);
+            x1 = fold128(x1, k3k4, x3);
+            x1 = fold128(x1, k3k4, x4);
+            for (; size >= 16; data += 16, size -= 16)
+                x1 = fold128(x1, k3k4, load128(data));
+
+            // 128 -> 64 bits, then Barrett reduction to 32
+            const __m128i mask = _mm_setr_epi32(~0, 0, ~0, 0);
+            x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), _mm_clmulepi64_si128(x1, k3k4, 0x10));
+            x1 = _mm_xor_si128(_mm_srli_si128(x1, 4), _mm_clmulepi64_si128(_mm_and_si128(x1, mask), k5k0, 0x00));
+            __m128i t = _mm_clmulepi64_si128(_mm_and_si128(x1, mask), poly, 0x10);
+            t = _mm_clmulepi64_si128(_mm_and_si128(t, mask), poly, 0x00);
+            return static_cast<uint32_t>(_mm_extract_epi32(_mm_xor_si128(x1, t), 1));
+        }
+
+        bool haveClmul()
+        {
+            static const bool yes = __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+            return yes;
+        }
+#endif
+
+        // a * b modulo the CRC polynomial, both in reflected bit order (bit 31 = x^0)
+        uint32_t multModP(uint32_t a, uint32_t b)
+        {
+            uint32_t m = 1u << 31;
+            uint32_t p = 0;
+            for (;;)
+            {
+                if (a & m)
+                {
+                    p ^= b;
+                    if ((a & (m - 1)) == 0)
+                        break;
+                }
+                m >>= 1;
+                b = (b & 1u) ? ((b >> 1) ^ CRC32_POLY) : (b >> 1);
+            }
+            return p;
+        }
+
+        // x^(2^k) modulo the polynomial for k = 0..31
+        struct X2nTable
+        {
+            uint32_t t[32];
+            X2nTable()
+            {
+                uint32_t p = 1u << 30; // x^1
+                t[0] = p;
+                for (int k = 1; k < 32; ++k)
+                    t[k] = p = multModP(p, p);
+            }
+        };
+
+        // x^(n * 2^k) modulo the polynomial
+        uint32_t x2nModP(uint64_t n, unsigned k)
+        {
+            static const X2nTable table;
+            uint32_t p = 1u << 31; // x^0
+            while (n)
+            {
+                if (n & 1)
+                    p = multModP(table.t[k & 31], p);
+                n >>= 1;
+                ++k;
+            }
+            return p;
+        }
+    }
+
+    uint32_t crc32(uint32_t crc, const uint8_t *data, size_t size)
+    {
+        crc = ~crc;
+#ifdef FC_CRC32_PCLMUL
+        if (size >= 64 && haveClmul())
+        {
+            const size_t bulk = size & ~size_t(15);
+            crc = crc32Clmul(crc, data, bulk);
+            data += bulk;
+            size -= bulk;
+        }
+#endif
+        return ~crc32Slice8(crc, data, size);
+    }
+
+    const char *crc32Backend()
+    {
+#ifdef FC_CRC32_PCLMUL
+        if (haveClmul())
+            return "pclmul";
+#endif
+        return "slice-by-8";
+    }
+
+    uint32_t crc32Combine(uint32_t crc1, uint32_t crc2, uint64_t len2)
+    {
+        // Appending len2 bytes multiplies crc1 by x^(8 * len2)
+        return multModP(x2nModP(len2, 3), crc1) ^ crc2;
+    }
+
+} // namespace fc
@@ -0,0 +1,18 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+namespace fc
+{
+
+    // CRC-32 (IEEE 802.3 / gzip polynomial, reflected). Pass the previous result to
+    // continue a running checksum; start with 0. Uses carry-less multiply (PCLMULQDQ)
+    // when the CPU has it, otherwise slicing-by-8 tables.
+    uint32_t crc32(uint32_t crc, const uint8_t *data, size_t size);
+    // Which of the two crc32 uses on this CPU: "pclmul" or "slice-by-8"
+    const char *crc32Backend();
+
+    // CRC-32 of A followed by B, given crc1 = crc32(A), crc2 = crc32(B) and len2 = |B|
+    uint32_t crc32Combine(uint32_t crc1, uint32_t crc2, uint64_t len2);
+
+} // namespace fc
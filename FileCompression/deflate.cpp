@@ -2,247 +2,1528 @@
 #include "bit_io.h"
 #include "huffman.h"
 #include "lz77.h"
+#include "checksum.h"
+#include "dictionary.h"
 #include <vector>
 #include <string>
 #include <ostream>
 #include <istream>
-#include <sstream>
 #include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <cmath>
+#include <array>
+#include <functional>
+#include <memory>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <fstream>
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 namespace fc
 {
     namespace
     {
         constexpr uint32_t MAGIC = 0x31304346u; // "FC01" in little-endian
+        constexpr uint64_t UNKNOWN_SIZE = ~0ull; // originalSize when input is not seekable
+        constexpr uint8_t BLOCK_FINAL = 0x01;
+        constexpr uint8_t HEADER_INDEXED = 0x01; // blocks are self-contained; index trailer follows
+        constexpr uint8_t HEADER_DICTIONARY = 0x02; // primed with a preset dictionary; its ID follows originalSize
+        constexpr uint32_t INDEX_MAGIC = 0x58494346u; // "FCIX" in little-endian
+
+        // gzip (RFC 1952) member header: magic, CM=8 (deflate), no flags, no mtime, XFL=0, OS=unknown
+        constexpr uint8_t GZIP_HEADER[10] = {0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 255};
+
+        constexpr int MAX_CL_BITS = 7;      // code-length alphabet
+        constexpr size_t MAX_DICTIONARY = 32768; // history a parallel block is primed with
+        constexpr size_t CL_ALPHABET_SIZE = 19;
+        // RFC 1951 3.2.7: order in which code-length code lengths are sent
+        constexpr uint8_t CL_ORDER[CL_ALPHABET_SIZE] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
 
         struct FileHeader
         {
-            uint16_t version = 1;
+            uint16_t version = FORMAT_VERSION;
+            uint8_t flags = 0;
             uint32_t windowSize = 32768;
             uint64_t originalSize = 0;
-            std::vector<std::pair<uint16_t, uint32_t>> llFreqs;   // (symbol, freq)
-            std::vector<std::pair<uint16_t, uint32_t>> distFreqs; // (symbol, freq)
+            uint32_t dictionaryId = 0; // with HEADER_DICTIONARY
+        };
+
+        // FCIndexed trailer, after the file checksum: one entry per block, then
+        // indexOffset (u64), block count (u32) and INDEX_MAGIC
+        struct IndexEntry
+        {
+            uint64_t compressedOffset = 0;   // from the start of the container
+            uint64_t uncompressedOffset = 0;
+            uint32_t rawSize = 0;
+        };
+
+        // Each block is byte-aligned: header, then RFC 1951 blocks (stored, fixed or dynamic,
+        // BFINAL on the last) covering rawSize bytes, then zero padding. The final block is
+        // followed by the CRC-32 of the whole original data (u32).
+        struct BlockHeader
+        {
+            uint8_t flags = 0;
+            uint32_t rawSize = 0;
+            uint32_t crc = 0; // CRC-32 of this block's rawSize original bytes
         };
 
-        // Little-endian write helpers
-        inline void writeU16LE(std::ostream &out, uint16_t v)
+        // Little-endian field helpers (BitWriter is LSB-first, so whole bytes land in LE order)
+        inline void writeU16LE(BitWriter &bw, uint16_t v)
         {
-            unsigned char buf[2];
-            buf[0] = static_cast<unsigned char>(v & 0xFFu);
-            buf[1] = static_cast<unsigned char>((v >> 8) & 0xFFu);
-            out.write(reinterpret_cast<const char *>(buf), 2);
+            bw.writeBits(v, 16);
         }
 
-        inline void writeU32LE(std::ostream &out, uint32_t v)
+        inline void writeU32LE(BitWriter &bw, uint32_t v)
         {
-            unsigned char buf[4];
-            buf[0] = static_cast<unsigned char>(v & 0xFFu);
-            buf[1] = static_cast<unsigned char>((v >> 8) & 0xFFu);
-            buf[2] = static_cast<unsigned char>((v >> 16) & 0xFFu);
-            buf[3] = static_cast<unsigned char>((v >> 24) & 0xFFu);
-            out.write(reinterpret_cast<const char *>(buf), 4);
+            bw.writeBits(v, 32);
         }
 
-        inline void writeU64LE(std::ostream &out, uint64_t v)
+        inline void writeU64LE(BitWriter &bw, uint64_t v)
         {
-            unsigned char buf[8];
-            for (int i = 0; i < 8; ++i)
+            bw.writeBits(static_cast<uint32_t>(v), 32);
+            bw.writeBits(static_cast<uint32_t>(v >> 32), 32);
+        }
+
+        bool writeHeader(BitWriter &bw, const FileHeader &hdr, std::string *err)
+        {
+            writeU32LE(bw, MAGIC);
+            writeU16LE(bw, hdr.version);
+            bw.writeBits(hdr.flags, 8);
+            writeU32LE(bw, hdr.windowSize);
+            writeU64LE(bw, hdr.originalSize);
+            if (hdr.flags & HEADER_DICTIONARY)
+                writeU32LE(bw, hdr.dictionaryId);
+
+            if (!bw.ok())
             {
-                buf[i] = static_cast<unsigned char>((v >> (i * 8)) & 0xFFu);
+                if (err)
+                    *err = "writeHeader: I/O error during write";
+                return false;
             }
-            out.write(reinterpret_cast<const char *>(buf), 8);
+            return true;
         }
 
-        bool writeHeader(std::ostream &out, const FileHeader &hdr, std::string *err)
+        void writeBlockHeader(BitWriter &bw, const BlockHeader &bh)
         {
-            writeU32LE(out, MAGIC);
-            writeU16LE(out, hdr.version);
-            writeU32LE(out, hdr.windowSize);
-            writeU64LE(out, hdr.originalSize);
+            bw.writeBits(bh.flags, 8);
+            writeU32LE(bw, bh.rawSize);
+            writeU32LE(bw, bh.crc);
+        }
+
+        // Bytes of history to drop so that at least one window remains, in whole slide units
+        inline size_t slideDelta(size_t buffered, size_t unit)
+        {
+            return (buffered > unit) ? ((buffered - unit) / unit) * unit : 0;
+        }
 
-            uint16_t llCount = static_cast<uint16_t>(hdr.llFreqs.size());
-            writeU16LE(out, llCount);
-            for (const auto &p : hdr.llFreqs)
+        // Remaining input size, or UNKNOWN_SIZE for pipes and other non-seekable streams
+        uint64_t probeStreamSize(std::istream &in)
+        {
+            std::streampos cur = in.tellg();
+            if (cur == std::streampos(-1))
             {
-                writeU16LE(out, p.first);
-                writeU32LE(out, p.second);
+                in.clear();
+                return UNKNOWN_SIZE;
             }
-
-            uint16_t distCount = static_cast<uint16_t>(hdr.distFreqs.size());
-            writeU16LE(out, distCount);
-            for (const auto &p : hdr.distFreqs)
+            in.seekg(0, std::ios::end);
+            std::streampos end = in.tellg();
+            in.seekg(cur);
+            if (!in || end == std::streampos(-1))
             {
-                writeU16LE(out, p.first);
-                writeU32LE(out, p.second);
+                in.clear();
+                in.seekg(cur);
+                return UNKNOWN_SIZE;
             }
+            return static_cast<uint64_t>(end - cur);
+        }
 
-            if (!out)
+        // Read up to max bytes; final is set when the stream has nothing after them
+        bool readBlock(std::istream &in, uint8_t *dst, size_t max, size_t &n, bool &final, std::string *err)
+        {
+            in.read(reinterpret_cast<char *>(dst), static_cast<std::streamsize>(max));
+            n = static_cast<size_t>(in.gcount());
+            if (in.bad())
             {
                 if (err)
-                    *err = "writeHeader: I/O error during write";
+                    *err = "deflateStream: input stream error";
                 return false;
             }
+            final = (n < max) || in.peek() == std::char_traits<char>::eof();
             return true;
         }
-    }
 
-    bool deflateStream(std::istream &in, std::ostream &out, const DeflateOptions &opt, std::string *err)
-    {
-        // Pass 1: Run LZ77 to collect tokens and compute frequencies
-        LZ77Encoder lz77(opt.lz);
-        std::vector<Token> tokens;
-        size_t inputSize = 0;
+        // Symbol statistics for a run of tokens, with the extra bits its matches need.
+        // LL alphabet: 0-255 literals, 256 EOB (added per block by planBlock), 257-285 lengths.
+        struct BlockStats
+        {
+            std::array<uint32_t, LL_ALPHABET_SIZE> ll{};
+            std::array<uint32_t, DIST_ALPHABET_SIZE> dist{};
+            uint64_t extraBits = 0;
+            size_t rawSize = 0; // input bytes the tokens cover
 
-        if (!lz77.encode(in, tokens, &inputSize))
+            void add(const Token &t)
+            {
+                if (t.kind == TokenKind::Literal)
+                {
+                    ll[t.literal]++;
+                    rawSize += 1;
+                }
+                else
+                {
+                    uint16_t lc = lengthCode(t.length);
+                    uint16_t dc = distCode(t.distance);
+                    ll[FIRST_LENGTH_SYMBOL + lc]++;
+                    dist[dc]++;
+                    extraBits += LENGTH_EXTRA[lc] + DIST_EXTRA[dc];
+                    rawSize += t.length;
+                }
+            }
+
+            void add(const BlockStats &o)
+            {
+                for (size_t s = 0; s < ll.size(); ++s)
+                    ll[s] += o.ll[s];
+                for (size_t s = 0; s < dist.size(); ++s)
+                    dist[s] += o.dist[s];
+                extraBits += o.extraBits;
+                rawSize += o.rawSize;
+            }
+        };
+
+        // Huffman-code every token followed by EOB
+        bool writeTokens(BitWriter &bw, TokenBuffer::const_iterator first, TokenBuffer::const_iterator last,
+                         const HuffmanCodec &llCodec, const HuffmanCodec &distCodec, std::string *err)
         {
-            if (err)
-                *err = "deflateStream: LZ77 encoding failed";
-            return false;
-        }
+            for (auto it = first; it != last; ++it)
+            {
+                const Token t = *it;
+                if (t.kind == TokenKind::Literal)
+                {
+                    if (!llCodec.encode(t.literal, bw))
+                    {
+                        if (err)
+                            *err = "deflateStream: failed to encode literal";
+                        return false;
+                    }
+                }
+                else if (t.kind == TokenKind::Match)
+                {
+                    // Length symbol + extra bits, then distance symbol + extra bits
+                    uint16_t lc = lengthCode(t.length);
+                    if (!llCodec.encode(static_cast<uint16_t>(FIRST_LENGTH_SYMBOL + lc), bw))
+                    {
+                        if (err)
+                            *err = "deflateStream: failed to encode length symbol";
+                        return false;
+                    }
+                    bw.writeBits(t.length - LENGTH_BASE[lc], LENGTH_EXTRA[lc]);
+
+                    uint16_t dc = distCode(t.distance);
+                    if (!distCodec.encode(dc, bw))
+                    {
+                        if (err)
+                            *err = "deflateStream: failed to encode distance symbol";
+                        return false;
+                    }
+                    bw.writeBits(t.distance - DIST_BASE[dc], DIST_EXTRA[dc]);
+                }
+            }
 
-        // Build frequency tables for Literal/Length and Distance
-        // LL alphabet: 0-255 (literals) + 256 (EOB) + 257-285 (lengths 3-258)
-        // Distance alphabet: 0-29 (distances 1-32768, using base+extra bits scheme)
-        std::vector<uint32_t> llFreqs(286, 0);
-        std::vector<uint32_t> distFreqs(30, 0);
+            if (!llCodec.encode(END_OF_BLOCK, bw))
+            {
+                if (err)
+                    *err = "deflateStream: failed to encode EOB";
+                return false;
+            }
+            return true;
+        }
 
-        for (const auto &t : tokens)
+        // zlib does the same: a tree with fewer than two codes is degenerate for some
+        // decoders, so give unused symbols a nominal count until there are two
+        template <typename Freqs>
+        void ensureTwoCodes(Freqs &freqs)
         {
-            if (t.kind == TokenKind::Literal)
+            int nonZero = static_cast<int>(std::count_if(freqs.begin(), freqs.end(), [](uint32_t f)
+                                                         { return f > 0; }));
+            for (size_t s = 0; nonZero < 2 && s < freqs.size(); ++s)
             {
-                llFreqs[t.literal]++;
+                if (freqs[s] == 0)
+                {
+                    freqs[s] = 1;
+                    ++nonZero;
+                }
             }
-            else if (t.kind == TokenKind::Match)
+        }
+
+        struct CodeLengthItem
+        {
+            uint8_t symbol; // 0-15 literal length, 16 repeat previous, 17/18 zero runs
+            uint8_t extra;  // repeat count minus the symbol's base
+        };
+
+        // RFC 1951 3.2.7 run-length coding of the concatenated LL + distance code lengths
+        void encodeCodeLengths(const uint8_t *lens, size_t count, std::vector<CodeLengthItem> &items)
+        {
+            items.clear();
+            size_t i = 0;
+            while (i < count)
             {
-                // Simplified: use fixed symbol for all matches
-                // Symbol 257 represents "match follows"
-                llFreqs[257]++;
-                // Distance symbol: always use symbol 0 (we'll encode actual distance as extra bits)
-                distFreqs[0]++;
+                uint8_t len = lens[i];
+                size_t run = 1;
+                while (i + run < count && lens[i + run] == len)
+                    ++run;
+                i += run;
+
+                if (len == 0)
+                {
+                    while (run >= 11)
+                    {
+                        size_t k = std::min<size_t>(run, 138);
+                        items.push_back({18, static_cast<uint8_t>(k - 11)});
+                        run -= k;
+                    }
+                    if (run >= 3)
+                    {
+                        items.push_back({17, static_cast<uint8_t>(run - 3)});
+                        run = 0;
+                    }
+                }
+                else
+                {
+                    items.push_back({len, 0});
+                    --run;
+                    while (run >= 3)
+                    {
+                        size_t k = std::min<size_t>(run, 6);
+                        items.push_back({16, static_cast<uint8_t>(k - 3)});
+                        run -= k;
+                    }
+                }
+                for (; run > 0; --run)
+                    items.push_back({len, 0});
             }
         }
 
-        // EOB marker
-        llFreqs[256]++;
+        // RFC 1951 3.2.7 table header: HLIT/HDIST/HCLEN, the code-length code, then the
+        // run-length coded LL + distance code lengths. Planned before it is written so its
+        // size can be weighed against fixed and stored coding.
+        struct DynamicTables
+        {
+            size_t hlit = 0;
+            size_t hdist = 0;
+            size_t hclen = 0;
+            std::vector<CodeLengthItem> items;
+            std::vector<uint8_t> clLens; // code-length code
 
-        // Build Huffman codecs
-        HuffmanCodec llCodec, distCodec;
-        if (!llCodec.build(llFreqs))
+            uint64_t bits() const
+            {
+                uint64_t total = 5 + 5 + 4 + 3 * hclen;
+                for (const auto &it : items)
+                    total += clLens[it.symbol] + (it.symbol == 16 ? 2 : it.symbol == 17 ? 3 : it.symbol == 18 ? 7 : 0);
+                return total;
+            }
+
+            bool write(BitWriter &bw, HuffmanCodec &clCodec, std::string *err) const
+            {
+                if (!clCodec.buildFromLengths(clLens))
+                {
+                    if (err)
+                        *err = "deflateStream: failed to build code-length tree";
+                    return false;
+                }
+                bw.writeBits(static_cast<uint32_t>(hlit - 257), 5);
+                bw.writeBits(static_cast<uint32_t>(hdist - 1), 5);
+                bw.writeBits(static_cast<uint32_t>(hclen - 4), 4);
+                for (size_t i = 0; i < hclen; ++i)
+                    bw.writeBits(clLens[CL_ORDER[i]], 3);
+                for (const auto &it : items)
+                {
+                    if (!clCodec.encode(it.symbol, bw))
+                    {
+                        if (err)
+                            *err = "deflateStream: failed to encode code-length symbol";
+                        return false;
+                    }
+                    if (it.symbol == 16)
+                        bw.writeBits(it.extra, 2);
+                    else if (it.symbol == 17)
+                        bw.writeBits(it.extra, 3);
+                    else if (it.symbol == 18)
+                        bw.writeBits(it.extra, 7);
+                }
+                return true;
+            }
+        };
+
+        // Code lengths must be at most 15 bits
+        bool planDynamicTables(const std::vector<uint8_t> &llLens, const std::vector<uint8_t> &distLens, DynamicTables &tables, std::string *err)
         {
-            if (err)
-                *err = "deflateStream: failed to build LL Huffman tree";
-            return false;
+            // HLIT/HDIST drop trailing unused symbols (at least 257 / 1 remain)
+            tables.hlit = llLens.size();
+            while (tables.hlit > 257 && llLens[tables.hlit - 1] == 0)
+                --tables.hlit;
+            tables.hdist = distLens.size();
+            while (tables.hdist > 1 && distLens[tables.hdist - 1] == 0)
+                --tables.hdist;
+
+            std::array<uint8_t, LL_ALPHABET_SIZE + DIST_ALPHABET_SIZE> lens;
+            std::copy(llLens.begin(), llLens.begin() + static_cast<std::ptrdiff_t>(tables.hlit), lens.begin());
+            std::copy(distLens.begin(), distLens.begin() + static_cast<std::ptrdiff_t>(tables.hdist), lens.begin() + tables.hlit);
+
+            encodeCodeLengths(lens.data(), tables.hlit + tables.hdist, tables.items);
+            std::array<uint32_t, CL_ALPHABET_SIZE> clFreqs{};
+            for (const auto &it : tables.items)
+                clFreqs[it.symbol]++;
+            ensureTwoCodes(clFreqs);
+
+            if (!HuffmanCodec::codeLengths(clFreqs.data(), clFreqs.size(), MAX_CL_BITS, tables.clLens))
+            {
+                if (err)
+                    *err = "deflateStream: failed to build code-length tree";
+                return false;
+            }
+            tables.hclen = CL_ALPHABET_SIZE;
+            while (tables.hclen > 4 && tables.clLens[CL_ORDER[tables.hclen - 1]] == 0)
+                --tables.hclen;
+            return true;
         }
 
-        // Handle case where there are no matches (no distance codes needed)
-        bool hasMatches = false;
-        for (auto f : distFreqs)
+        // RFC 1951 3.2.6 fixed literal/length and distance codes
+        struct FixedCodes
         {
-            if (f > 0)
+            std::vector<uint8_t> llLens, distLens;
+            HuffmanCodec ll, dist;
+            FixedCodes() : llLens(288, 8), distLens(32, 5)
             {
-                hasMatches = true;
-                break;
+                std::fill(llLens.begin() + 144, llLens.begin() + 256, 9);
+                std::fill(llLens.begin() + 256, llLens.begin() + 280, 7);
+                ll.buildFromLengths(llLens);
+                dist.buildFromLengths(distLens);
             }
+        };
+
+        const FixedCodes &fixedCodes()
+        {
+            static const FixedCodes codes;
+            return codes;
         }
-        if (hasMatches)
+
+        // RFC 1951 BTYPE values
+        enum class BlockType : uint8_t
         {
-            if (!distCodec.build(distFreqs))
+            Stored = 0,
+            Fixed = 1,
+            Dynamic = 2
+        };
+
+        // Cheapest coding for one RFC 1951 block
+        struct BlockPlan
+        {
+            BlockType type = BlockType::Stored;
+            uint64_t bits = 0; // whole block, header included (stored padding assumed worst case)
+            std::vector<uint8_t> llLens, distLens; // dynamic blocks only
+            DynamicTables tables;
+        };
+
+        constexpr size_t MAX_STORED = 65535; // LEN is 16 bits
+
+        inline uint64_t storedBits(size_t rawSize)
+        {
+            // BTYPE header, up to 7 bits of padding, LEN/NLEN per block of at most MAX_STORED bytes
+            uint64_t blocks = std::max<size_t>(1, (rawSize + MAX_STORED - 1) / MAX_STORED);
+            return blocks * (3 + 7 + 32) + 8ull * rawSize;
+        }
+
+        template <typename Freqs>
+        inline uint64_t symbolBits(const Freqs &freqs, const std::vector<uint8_t> &lens)
+        {
+            uint64_t total = 0;
+            for (size_t s = 0; s < freqs.size(); ++s)
+                total += static_cast<uint64_t>(freqs[s]) * lens[s];
+            return total;
+        }
+
+        // Size the block as stored, fixed and dynamic and keep the smallest
+        bool planBlock(const BlockStats &stats, BlockPlan &plan, std::string *err)
+        {
+            std::array<uint32_t, LL_ALPHABET_SIZE> llFreqs = stats.ll;
+            std::array<uint32_t, DIST_ALPHABET_SIZE> distFreqs = stats.dist;
+            llFreqs[END_OF_BLOCK] = 1;
+
+            const FixedCodes &fixed = fixedCodes();
+            const uint64_t stored = storedBits(stats.rawSize);
+            const uint64_t fixedBits = 3 + stats.extraBits + symbolBits(llFreqs, fixed.llLens) + symbolBits(distFreqs, fixed.distLens);
+
+            ensureTwoCodes(llFreqs);
+            ensureTwoCodes(distFreqs);
+            if (!HuffmanCodec::codeLengths(llFreqs.data(), llFreqs.size(), MAX_CODE_BITS, plan.llLens) ||
+                !HuffmanCodec::codeLengths(distFreqs.data(), distFreqs.size(), MAX_CODE_BITS, plan.distLens))
             {
                 if (err)
-                    *err = "deflateStream: failed to build Distance Huffman tree";
+                    *err = "deflateStream: failed to build block Huffman trees";
                 return false;
             }
+            if (!planDynamicTables(plan.llLens, plan.distLens, plan.tables, err))
+                return false;
+            const uint64_t dynamicBits = 3 + plan.tables.bits() + stats.extraBits +
+                                         symbolBits(llFreqs, plan.llLens) + symbolBits(distFreqs, plan.distLens);
+
+            plan.type = BlockType::Dynamic;
+            plan.bits = dynamicBits;
+            if (fixedBits <= plan.bits)
+            {
+                plan.type = BlockType::Fixed;
+                plan.bits = fixedBits;
+            }
+            if (stored <= plan.bits)
+            {
+                plan.type = BlockType::Stored;
+                plan.bits = stored;
+            }
+            return true;
         }
 
-        // Prepare header
-        FileHeader hdr;
-        hdr.version = opt.version;
-        hdr.windowSize = opt.lz.windowSize;
-        hdr.originalSize = inputSize;
+        constexpr size_t SPLIT_CHUNK = 4096; // tokens per candidate block boundary
+
+        // Tokens [first, last) covering input [rawBegin, rawBegin + stats.rawSize)
+        struct PlannedBlock
+        {
+            TokenBuffer::const_iterator first;
+            TokenBuffer::const_iterator last;
+            size_t rawBegin = 0;
+            BlockStats stats;
+            BlockPlan plan;
+        };
 
-        // Only store non-zero frequencies
-        for (uint16_t sym = 0; sym < llFreqs.size(); ++sym)
+        // Block planning and coding memory, kept across blocks (and across calls, in a
+        // DeflateContext): plans are swapped in and out rather than rebuilt, so their
+        // vectors keep their capacity
+        struct BlockScratch
         {
-            if (llFreqs[sym] > 0)
+            std::vector<PlannedBlock> blocks; // the first used entries are the plan
+            size_t used = 0;
+            PlannedBlock chunk, whole;
+            BlockStats merged;
+            BlockPlan joint;
+            HuffmanCodec ll, dist, cl;
+        };
+
+        // Cut the tokens into RFC 1951 blocks. Chunks of SPLIT_CHUNK tokens join the block
+        // before them while coding them together is no dearer than coding them apart, so a
+        // new block (and new tables) starts where the statistics shift.
+        bool planBlocks(const TokenBuffer &tokens, BlockScratch &s, std::string *err)
+        {
+            s.used = 0;
+            size_t raw = 0;
+            auto it = tokens.begin();
+            const auto end = tokens.end();
+            do
             {
-                hdr.llFreqs.push_back({sym, llFreqs[sym]});
+                PlannedBlock &chunk = s.chunk;
+                chunk.first = it;
+                chunk.rawBegin = raw;
+                chunk.stats = BlockStats{};
+                for (size_t i = 0; i < SPLIT_CHUNK && it != end; ++i, ++it)
+                    chunk.stats.add(*it);
+                chunk.last = it;
+                raw += chunk.stats.rawSize;
+                if (!planBlock(chunk.stats, chunk.plan, err))
+                    return false;
+
+                if (s.used > 0)
+                {
+                    PlannedBlock &cur = s.blocks[s.used - 1];
+                    s.merged = cur.stats;
+                    s.merged.add(chunk.stats);
+                    if (!planBlock(s.merged, s.joint, err))
+                        return false;
+                    if (s.joint.bits <= cur.plan.bits + chunk.plan.bits)
+                    {
+                        cur.last = chunk.last;
+                        cur.stats = s.merged;
+                        std::swap(cur.plan, s.joint);
+                        continue;
+                    }
+                }
+                if (s.used == s.blocks.size())
+                    s.blocks.emplace_back();
+                std::swap(s.blocks[s.used++], chunk);
+            } while (it != end);
+
+            // Greedy cuts can lose to a single table over the whole run; keep whichever is smaller
+            if (s.used > 1)
+            {
+                PlannedBlock &whole = s.whole;
+                whole.first = tokens.begin();
+                whole.last = end;
+                whole.rawBegin = 0;
+                whole.stats = BlockStats{};
+                uint64_t splitBits = 0;
+                for (size_t i = 0; i < s.used; ++i)
+                {
+                    whole.stats.add(s.blocks[i].stats);
+                    splitBits += s.blocks[i].plan.bits;
+                }
+                if (!planBlock(whole.stats, whole.plan, err))
+                    return false;
+                if (whole.plan.bits <= splitBits)
+                {
+                    std::swap(s.blocks[0], whole);
+                    s.used = 1;
+                }
             }
+            return true;
+        }
+
+        bool writeStored(BitWriter &bw, const uint8_t *raw, size_t n, bool final)
+        {
+            do
+            {
+                const size_t len = std::min(n, MAX_STORED);
+                n -= len;
+                bw.writeBits((final && n == 0) ? 1u : 0u, 3); // BTYPE=00
+                bw.alignToByte();
+                writeU16LE(bw, static_cast<uint16_t>(len));
+                writeU16LE(bw, static_cast<uint16_t>(~len));
+                bw.writeBytes(raw, len);
+                raw += len;
+            } while (n > 0);
+            return bw.ok();
         }
-        for (uint16_t sym = 0; sym < distFreqs.size(); ++sym)
+
+        // Emit tokens as one or more RFC 1951 blocks, each stored, fixed or dynamic as
+        // planBlocks finds cheapest; raw is the n input bytes they cover (for stored blocks).
+        // Null tokens (the block was judged incompressible) stores raw as is.
+        // BFINAL goes on the last block when final is set. Blocks are not byte-aligned.
+        bool writeDeflateBlocks(BitWriter &bw, const TokenBuffer *tokens, const uint8_t *raw, size_t n, bool final,
+                                BlockScratch &scratch, std::string *err)
         {
-            if (distFreqs[sym] > 0)
+            if (!tokens)
             {
-                hdr.distFreqs.push_back({sym, distFreqs[sym]});
+                if (writeStored(bw, raw, n, final))
+                    return true;
+                if (err)
+                    *err = "deflateStream: output stream error";
+                return false;
             }
+            if (!planBlocks(*tokens, scratch, err))
+                return false;
+
+            for (size_t i = 0; i < scratch.used; ++i)
+            {
+                const PlannedBlock &b = scratch.blocks[i];
+                const bool last = final && i + 1 == scratch.used;
+                if (b.plan.type == BlockType::Stored)
+                {
+                    if (!writeStored(bw, raw + b.rawBegin, b.stats.rawSize, last))
+                    {
+                        if (err)
+                            *err = "deflateStream: output stream error";
+                        return false;
+                    }
+                    continue;
+                }
+
+                bw.writeBits((last ? 1u : 0u) | (static_cast<uint32_t>(b.plan.type) << 1), 3);
+                const HuffmanCodec *ll = &fixedCodes().ll;
+                const HuffmanCodec *dist = &fixedCodes().dist;
+                if (b.plan.type == BlockType::Dynamic)
+                {
+                    if (!scratch.ll.buildFromLengths(b.plan.llLens) || !scratch.dist.buildFromLengths(b.plan.distLens))
+                    {
+                        if (err)
+                            *err = "deflateStream: failed to build block Huffman trees";
+                        return false;
+                    }
+                    if (!b.plan.tables.write(bw, scratch.cl, err))
+                        return false;
+                    ll = &scratch.ll;
+                    dist = &scratch.dist;
+                }
+                if (!writeTokens(bw, b.first, b.last, *ll, *dist, err))
+                    return false;
+            }
+            return true;
         }
 
-        // Write header (byte-aligned)
-        if (!writeHeader(out, hdr, err))
+        // One complete FC block: header, then the block's own RFC 1951 blocks ending with
+        // BFINAL, padded to a byte boundary
+        bool writeBlock(BitWriter &bw, const TokenBuffer *tokens, const uint8_t *raw, uint32_t rawSize, uint32_t rawCrc,
+                        bool final, BlockScratch &scratch, std::string *err)
         {
-            return false;
+            BlockHeader bh;
+            bh.flags = final ? BLOCK_FINAL : 0;
+            bh.rawSize = rawSize;
+            bh.crc = rawCrc;
+            writeBlockHeader(bw, bh);
+
+            if (!writeDeflateBlocks(bw, tokens, raw, rawSize, true, scratch, err))
+                return false;
+            bw.alignToByte();
+            return true;
         }
 
-        // Pass 2: Encode tokens with Huffman codes
-        BitWriter bw(out);
-        for (const auto &t : tokens)
+        // Container framing around the token blocks: FC header/blocks, or a gzip member
+        class ContainerWriter
         {
-            if (t.kind == TokenKind::Literal)
+        public:
+            // index collects the FCIndexed trailer; it is the caller's so its memory can be reused
+            ContainerWriter(BitWriter &bw, const DeflateOptions &opt, BlockScratch &scratch, std::vector<IndexEntry> &index)
+                : bw_(bw), opt_(opt), scratch_(scratch), index_(index)
+            {
+                index_.clear();
+            }
+
+            bool begin(uint64_t originalSize, std::string *err)
+            {
+                if (!opt_.lz.dictionary.empty() && opt_.format != ContainerFormat::FC)
+                {
+                    if (err)
+                        *err = "deflateStream: a preset dictionary needs the plain FC container";
+                    return false;
+                }
+                if (opt_.blockSize > MAX_BLOCK_SIZE)
+                {
+                    if (err)
+                        *err = "deflateStream: blockSize is above MAX_BLOCK_SIZE (1 GiB - 64 KiB)";
+                    return false;
+                }
+                if (!validMatchLengths(opt_.lz))
+                {
+                    if (err)
+                        *err = "deflateStream: match lengths must satisfy 3 <= minMatch <= maxMatch <= 258";
+                    return false;
+                }
+                if (opt_.format == ContainerFormat::Gzip)
+                {
+                    bw_.writeBytes(GZIP_HEADER, sizeof(GZIP_HEADER));
+                    return true;
+                }
+                FileHeader hdr;
+                hdr.version = opt_.version;
+                hdr.flags = (opt_.format == ContainerFormat::FCIndexed) ? HEADER_INDEXED : 0;
+                if (!opt_.lz.dictionary.empty())
+                {
+                    hdr.flags |= HEADER_DICTIONARY;
+                    hdr.dictionaryId = dictionaryId(opt_.lz.dictionary);
+                }
+                hdr.windowSize = opt_.lz.windowSize;
+                hdr.originalSize = originalSize;
+                return writeHeader(bw_, hdr, err);
+            }
+
+            // tokens as for writeDeflateBlocks: null stores the block
+            bool block(const TokenBuffer *tokens, const uint8_t *raw, size_t n, bool final, std::string *err)
+            {
+                const uint32_t rawCrc = crc32(0, raw, n);
+                recordBlock(rawCrc, n);
+                if (opt_.format == ContainerFormat::Gzip)
+                    return writeDeflateBlocks(bw_, tokens, raw, n, final, scratch_, err);
+                return writeBlock(bw_, tokens, raw, static_cast<uint32_t>(n), rawCrc, final, scratch_, err);
+            }
+
+            // Splice in a block produced by encodeBlockBytes; rawCrc covers its n input bytes
+            bool encoded(const std::vector<uint8_t> &bytes, uint32_t rawCrc, size_t n, std::string *err)
+            {
+                recordBlock(rawCrc, n);
+                bw_.writeBytes(bytes.data(), bytes.size());
+                if (!bw_.ok())
+                {
+                    if (err)
+                        *err = "deflateStream: output stream error";
+                    return false;
+                }
+                return true;
+            }
+
+            bool end(std::string *err)
             {
-                if (!llCodec.encode(t.literal, bw))
+                if (opt_.format == ContainerFormat::Gzip)
+                {
+                    // Trailer: CRC-32 and input size mod 2^32, byte-aligned
+                    bw_.alignToByte();
+                    writeU32LE(bw_, crc_);
+                    writeU32LE(bw_, static_cast<uint32_t>(total_));
+                }
+                else
+                {
+                    // FC trailer: CRC-32 of all the original data
+                    writeU32LE(bw_, crc_);
+                }
+                if (opt_.format == ContainerFormat::FCIndexed)
+                {
+                    // FC blocks end byte-aligned, so bytesWritten() is exact here
+                    uint64_t indexOffset = bw_.bytesWritten();
+                    for (const IndexEntry &e : index_)
+                    {
+                        writeU64LE(bw_, e.compressedOffset);
+                        writeU64LE(bw_, e.uncompressedOffset);
+                        writeU32LE(bw_, e.rawSize);
+                    }
+                    writeU64LE(bw_, indexOffset);
+                    writeU32LE(bw_, static_cast<uint32_t>(index_.size()));
+                    writeU32LE(bw_, INDEX_MAGIC);
+                }
+                bw_.flush();
+                if (!bw_.ok())
                 {
                     if (err)
-                        *err = "deflateStream: failed to encode literal";
+                        *err = "deflateStream: output stream error";
+                    return false;
+                }
+                return true;
+            }
+
+        private:
+            // Extend the whole-data CRC by a block's, and index the block
+            void recordBlock(uint32_t rawCrc, size_t n)
+            {
+                crc_ = crc32Combine(crc_, rawCrc, n);
+                if (opt_.format == ContainerFormat::FCIndexed)
+                    index_.push_back(IndexEntry{bw_.bytesWritten(), total_, static_cast<uint32_t>(n)});
+                total_ += n;
+            }
+
+            BitWriter &bw_;
+            const DeflateOptions &opt_;
+            BlockScratch &scratch_;
+            std::vector<IndexEntry> &index_;
+            uint32_t crc_ = 0;
+            uint64_t total_ = 0;
+        };
+
+        constexpr size_t SAMPLE_SPANS = 4;          // spread evenly over the block
+        constexpr size_t SAMPLE_SPAN = 16 * 1024;   // bytes counted per span
+        constexpr size_t SAMPLE_HASH_BITS = 14;
+        constexpr size_t MIN_SAMPLED_BLOCK = 4096;  // below this the estimate is noise, and tokenizing cheap
+
+        // Sampling pre-pass for DeflateOptions::incompressibleEntropy / incompressibleMatchDensity.
+        // data[-before, 0) is history the encoder can match into. Each span is preceded by
+        // the window in front of it, hashed but not counted, so a repeat is seen at any
+        // distance the match finder would reach: below window, as for MatchFinder. Hashes up to SAMPLE_SPANS * (SAMPLE_SPAN +
+        // window) bytes, a small fraction of what the match search costs on the block.
+        bool looksIncompressible(const uint8_t *data, size_t before, size_t n, const DeflateOptions &opt)
+        {
+            if (opt.incompressibleEntropy > 8.0 || n < MIN_SAMPLED_BLOCK)
+                return false;
+
+            const size_t window = std::min<size_t>(opt.lz.windowSize, MAX_DICTIONARY);
+            const uint8_t *base = data - before; // positions below are relative to base
+            const size_t end = before + n;
+            uint32_t hist[256] = {};
+            uint32_t last[size_t(1) << SAMPLE_HASH_BITS] = {}; // position + 1 of each 4-byte hash
+            size_t sampled = 0, repeated = 0;
+            size_t hashed = 0; // positions before this are in last[]
+            const size_t spans = std::min(SAMPLE_SPANS, (n + SAMPLE_SPAN - 1) / SAMPLE_SPAN);
+            for (size_t s = 0; s < spans; ++s)
+            {
+                const size_t len = std::min(SAMPLE_SPAN, n);
+                const size_t start = before + (spans == 1 ? 0 : s * (n - len) / (spans - 1));
+                const size_t counted = std::max(start, hashed); // spans of a short block overlap
+                for (size_t i = counted; i < start + len; ++i)
+                    ++hist[base[i]];
+                sampled += start + len - counted;
+
+                for (size_t i = std::max(hashed, start > window ? start - window : 0); i < start + len && i + 4 <= end; ++i)
+                {
+                    uint32_t v;
+                    std::memcpy(&v, base + i, 4);
+                    const uint32_t h = (v * 2654435761u) >> (32 - SAMPLE_HASH_BITS);
+                    const uint32_t prev = last[h];
+                    if (i >= counted && prev != 0 && i - (prev - 1) < window && std::memcmp(base + prev - 1, &v, 4) == 0)
+                        ++repeated;
+                    last[h] = static_cast<uint32_t>(i + 1);
+                }
+                hashed = start + len;
+            }
+
+            if (static_cast<double>(repeated) > opt.incompressibleMatchDensity * static_cast<double>(sampled))
+                return false;
+            double entropy = 0;
+            for (uint32_t c : hist)
+            {
+                if (c != 0)
+                {
+                    const double q = static_cast<double>(c) / static_cast<double>(sampled);
+                    entropy -= q * std::log2(q);
+                }
+            }
+            return entropy >= opt.incompressibleEntropy;
+        }
+
+        // Tokenize buf[start, end) into tokens and return them, or return null when the
+        // block looks incompressible and is to be stored; the encoder's history covers
+        // the block either way
+        const TokenBuffer *tokenizeBlock(LZ77Encoder &lz77, const DeflateOptions &opt, const uint8_t *buf, size_t start,
+                                         size_t end, TokenBuffer &tokens)
+        {
+            if (looksIncompressible(buf + start, start, end - start, opt))
+            {
+                lz77.skipBlock(buf, end);
+                return nullptr;
+            }
+            tokens.clear();
+            lz77.encodeBlock(buf, start, end, tokens);
+            return &tokens;
+        }
+
+        // FCIndexed blocks must decode without the bytes before them
+        bool independentBlocks(const DeflateOptions &opt)
+        {
+            return opt.format == ContainerFormat::FCIndexed;
+        }
+
+        // One block as encoded by itself, for splicing into a container at a byte boundary.
+        // FC blocks are byte-aligned already; a non-final gzip block is followed by an
+        // empty stored block (a sync flush, as pigz does) to reach one.
+        bool encodeBlockBytes(const DeflateOptions &opt, const TokenBuffer *tokens, const uint8_t *raw, size_t n,
+                              uint32_t rawCrc, bool final, std::vector<uint8_t> &out, BlockScratch &scratch, std::string *err)
+        {
+            BitWriter bw(out);
+            if (opt.format == ContainerFormat::Gzip)
+            {
+                if (!writeDeflateBlocks(bw, tokens, raw, n, final, scratch, err))
                     return false;
+                if (!final)
+                {
+                    bw.writeBits(0, 3); // BFINAL=0, BTYPE=00
+                    bw.alignToByte();
+                    writeU16LE(bw, 0);
+                    writeU16LE(bw, 0xFFFF);
+                }
+            }
+            else if (!writeBlock(bw, tokens, raw, static_cast<uint32_t>(n), rawCrc, final, scratch, err))
+            {
+                return false;
+            }
+            bw.flush();
+            return true;
+        }
+
+        struct ParallelJob
+        {
+            std::vector<uint8_t> data; // [dictionary | block]
+            size_t dictLen = 0;
+            bool final = false;
+            // Filled in by a worker
+            std::vector<uint8_t> encoded;
+            uint32_t crc = 0;
+            bool ok = false;
+            std::string err;
+            bool done = false;
+        };
+
+        // Fixed set of worker threads tokenizing and entropy-coding queued blocks.
+        // Each worker keeps its own LZ77Encoder and block scratch, reset per block.
+        class BlockCompressorPool
+        {
+        public:
+            BlockCompressorPool(const DeflateOptions &opt, unsigned threads) : opt_(opt)
+            {
+                for (unsigned i = 0; i < threads; ++i)
+                    workers_.emplace_back([this]
+                                          { run(); });
+            }
+
+            // Queued jobs that no worker has started are abandoned
+            ~BlockCompressorPool()
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mu_);
+                    stop_ = true;
+                }
+                work_.notify_all();
+                for (auto &t : workers_)
+                    t.join();
+            }
+
+            void submit(ParallelJob *job)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mu_);
+                    queue_.push_back(job);
+                }
+                work_.notify_one();
+            }
+
+            void wait(const ParallelJob *job)
+            {
+                std::unique_lock<std::mutex> lock(mu_);
+                done_.wait(lock, [job]
+                           { return job->done; });
+            }
+
+        private:
+            void run()
+            {
+                LZ77Encoder lz77(opt_.lz);
+                TokenBuffer tokens;
+                BlockScratch scratch;
+                for (;;)
+                {
+                    ParallelJob *job = nullptr;
+                    {
+                        std::unique_lock<std::mutex> lock(mu_);
+                        work_.wait(lock, [this]
+                                   { return stop_ || !queue_.empty(); });
+                        if (stop_)
+                            return;
+                        job = queue_.front();
+                        queue_.pop_front();
+                    }
+
+                    const size_t n = job->data.size() - job->dictLen;
+                    const uint8_t *raw = job->data.data() + job->dictLen;
+                    const TokenBuffer *blockTokens = nullptr;
+                    if (!looksIncompressible(raw, job->dictLen, n, opt_))
+                    {
+                        // No history to carry over, so a stored block skips the encoder entirely
+                        lz77.reset();
+                        tokens.clear();
+                        lz77.encodeBlock(job->data.data(), job->dictLen, job->data.size(), tokens);
+                        blockTokens = &tokens;
+                    }
+                    job->crc = crc32(0, raw, n);
+                    job->ok = encodeBlockBytes(opt_, blockTokens, raw, n, job->crc, job->final, job->encoded, scratch,
+                                               &job->err);
+
+                    {
+                        std::lock_guard<std::mutex> lock(mu_);
+                        job->done = true;
+                    }
+                    done_.notify_all();
                 }
             }
-            else if (t.kind == TokenKind::Match)
+
+            const DeflateOptions &opt_;
+            std::mutex mu_;
+            std::condition_variable work_;
+            std::condition_variable done_;
+            std::deque<ParallelJob *> queue_;
+            bool stop_ = false;
+            std::vector<std::thread> workers_;
+        };
+
+        unsigned resolveThreads(uint32_t threads)
+        {
+            if (threads == 0)
+                threads = std::max(1u, std::thread::hardware_concurrency());
+            return threads;
+        }
+
+        using BlockSource = std::function<bool(uint8_t *dst, size_t max, size_t &n, bool &final)>;
+
+        // pigz-style block-parallel compression. The reader copies each block together with
+        // the last window of input before it, so a fresh encoder primed on that history
+        // finds the same distances the serial encoder would; at most 2 * threads blocks
+        // are in memory at once and they are written strictly in input order.
+        bool deflateParallel(ContainerWriter &cw, const DeflateOptions &opt, unsigned threads,
+                             const BlockSource &read, std::string *err)
+        {
+            const size_t blockSize = std::max<uint32_t>(opt.blockSize, 1);
+            const size_t dictSize = independentBlocks(opt) ? 0 : std::min<size_t>(std::max<uint32_t>(opt.lz.windowSize, 2), MAX_DICTIONARY);
+            const size_t maxInFlight = 2 * static_cast<size_t>(threads);
+
+            // Declared before the pool so the workers are joined before jobs are freed
+            std::deque<std::unique_ptr<ParallelJob>> inFlight;
+            BlockCompressorPool pool(opt, threads);
+
+            auto retire = [&]() -> bool
             {
-                // Encode match marker (symbol 257)
-                if (!llCodec.encode(257, bw))
+                std::unique_ptr<ParallelJob> job = std::move(inFlight.front());
+                inFlight.pop_front();
+                pool.wait(job.get());
+                if (!job->ok)
                 {
                     if (err)
-                        *err = "deflateStream: failed to encode match marker";
+                        *err = job->err;
                     return false;
                 }
+                return cw.encoded(job->encoded, job->crc, job->data.size() - job->dictLen, err);
+            };
+
+            // Last dictSize bytes of input read so far, starting from any preset dictionary
+            std::vector<uint8_t> tail(opt.lz.dictionary.end() - static_cast<std::ptrdiff_t>(usableDictionarySize(opt.lz)),
+                                      opt.lz.dictionary.end());
+            bool final = false;
+            while (!final)
+            {
+                auto job = std::make_unique<ParallelJob>();
+                job->data.resize(tail.size() + blockSize);
+                std::copy(tail.begin(), tail.end(), job->data.begin());
+                size_t n = 0;
+                if (!read(job->data.data() + tail.size(), blockSize, n, final))
+                    return false;
+                job->data.resize(tail.size() + n);
+                job->dictLen = tail.size();
+                job->final = final;
 
-                // Write length as 9 bits (3-258 fits in 9 bits: 0-511)
-                bw.writeBits(t.length, 9);
+                size_t keep = std::min(dictSize, job->data.size());
+                tail.assign(job->data.end() - static_cast<std::ptrdiff_t>(keep), job->data.end());
+
+                pool.submit(job.get());
+                inFlight.push_back(std::move(job));
+                if (inFlight.size() >= maxInFlight && !retire())
+                    return false;
+            }
+            while (!inFlight.empty())
+            {
+                if (!retire())
+                    return false;
+            }
+            return true;
+        }
+    }
+
+    namespace
+    {
+        // Bounded single-producer/single-consumer queue between two pipeline stages.
+        // Handoffs are per block, so the mutex costs nothing measurable. After close(),
+        // push fails and pop drains what is left, then fails.
+        template <typename T>
+        class SpscRing
+        {
+        public:
+            explicit SpscRing(size_t capacity) : items_(capacity) {}
+
+            bool push(T item)
+            {
+                std::unique_lock<std::mutex> lock(mu_);
+                notFull_.wait(lock, [this]
+                              { return closed_ || count_ < items_.size(); });
+                if (closed_)
+                    return false;
+                items_[(head_ + count_++) % items_.size()] = item;
+                notEmpty_.notify_one();
+                return true;
+            }
+
+            bool pop(T &item)
+            {
+                std::unique_lock<std::mutex> lock(mu_);
+                notEmpty_.wait(lock, [this]
+                               { return closed_ || count_ > 0; });
+                if (count_ == 0)
+                    return false;
+                item = items_[head_];
+                head_ = (head_ + 1) % items_.size();
+                --count_;
+                notFull_.notify_one();
+                return true;
+            }
+
+            void close()
+            {
+                std::lock_guard<std::mutex> lock(mu_);
+                closed_ = true;
+                notEmpty_.notify_all();
+                notFull_.notify_all();
+            }
+
+        private:
+            std::vector<T> items_;
+            size_t head_ = 0;
+            size_t count_ = 0;
+            bool closed_ = false;
+            std::mutex mu_;
+            std::condition_variable notEmpty_, notFull_;
+        };
+
+        // One block on its way reader -> tokenizer -> entropy coder, and back to the reader
+        struct PipelineSlot
+        {
+            std::vector<uint8_t> raw;
+            size_t n = 0;
+            bool final = false;
+            TokenBuffer tokens;
+            bool stored = false; // judged incompressible: tokens unused
+        };
+
+        // Blocks in flight: one per stage plus one to absorb jitter between them
+        constexpr size_t PIPELINE_DEPTH = 4;
+
+        // Everything one compression works in. The free functions build one per call; a
+        // DeflateContext keeps one, so repeat calls find their memory already there.
+        struct Workspace
+        {
+            explicit Workspace(const DeflateOptions &o) : opt(o) {}
+
+            // Encoder with no history, built on first use and reset on every later one
+            LZ77Encoder &freshEncoder()
+            {
+                if (lz77)
+                    lz77->reset();
+                else
+                    lz77 = std::make_unique<LZ77Encoder>(opt.lz);
+                return *lz77;
+            }
+
+            DeflateOptions opt;
+            std::unique_ptr<LZ77Encoder> lz77;
+            TokenBuffer tokens;
+            std::vector<uint8_t> window;  // stream history + block, or dictionary + span
+            std::vector<uint8_t> staging; // BitWriter buffer for stream output
+            std::vector<IndexEntry> index;
+            BlockScratch blocks;
+            std::vector<PipelineSlot> slots; // DeflateOptions::pipeline
+        };
+
+        // DeflateOptions::pipeline: a reader thread and a tokenizer thread feed the entropy
+        // coder on the calling thread. The tokenizer keeps the serial path's window and
+        // match-finder state, so the tokens, and the output, are the same.
+        bool deflatePipelined(Workspace &ws, ContainerWriter &cw, std::istream &in, std::string *err)
+        {
+            const DeflateOptions &opt = ws.opt;
+            const size_t blockSize = std::max<uint32_t>(opt.blockSize, 1);
+            SpscRing<PipelineSlot *> empty(PIPELINE_DEPTH), filled(PIPELINE_DEPTH), tokenized(PIPELINE_DEPTH);
+            ws.slots.resize(PIPELINE_DEPTH);
+            for (PipelineSlot &slot : ws.slots)
+            {
+                slot.raw.resize(blockSize);
+                empty.push(&slot);
+            }
 
-                // Encode distance symbol (always 0 in simplified version)
-                if (hasMatches)
+            std::string readErr;
+            bool readOk = true;
+            auto readStage = [&]
+            {
+                PipelineSlot *slot = nullptr;
+                bool final = false;
+                while (!final && empty.pop(slot))
                 {
-                    if (!distCodec.encode(0, bw))
+                    if (!readBlock(in, slot->raw.data(), blockSize, slot->n, final, &readErr))
                     {
-                        if (err)
-                            *err = "deflateStream: failed to encode distance symbol";
-                        return false;
+                        readOk = false;
+                        break;
+                    }
+                    slot->final = final;
+                    if (!filled.push(slot))
+                        break;
+                }
+                filled.close();
+            };
+
+            LZ77Encoder &lz77 = ws.freshEncoder();
+            auto tokenizeStage = [&]
+            {
+                // Same layout as the serial path: [history (< 2 * unit) | current block]
+                const size_t unit = lz77.slideUnit();
+                std::vector<uint8_t> &buf = ws.window;
+                buf.resize(2 * unit + blockSize);
+                size_t histLen = usableDictionarySize(opt.lz);
+                std::copy(opt.lz.dictionary.end() - static_cast<std::ptrdiff_t>(histLen), opt.lz.dictionary.end(), buf.begin());
+
+                PipelineSlot *slot = nullptr;
+                while (filled.pop(slot))
+                {
+                    std::memcpy(buf.data() + histLen, slot->raw.data(), slot->n);
+                    slot->stored = !tokenizeBlock(lz77, opt, buf.data(), histLen, histLen + slot->n, slot->tokens);
+                    const size_t total = histLen + slot->n;
+                    if (!tokenized.push(slot))
+                        break;
+
+                    if (independentBlocks(opt))
+                    {
+                        lz77.reset();
+                        histLen = 0;
+                        continue;
                     }
+                    size_t delta = slideDelta(total, unit);
+                    if (delta > 0)
+                    {
+                        std::memmove(buf.data(), buf.data() + delta, total - delta);
+                        lz77.slide(delta);
+                    }
+                    histLen = total - delta;
                 }
+                tokenized.close();
+            };
 
-                // Write distance as 15 bits (1-32768 fits in 15 bits: 0-32767)
-                bw.writeBits(t.distance, 15);
+            std::thread reader(readStage);
+            std::thread tokenizer(tokenizeStage);
+            bool ok = true;
+            PipelineSlot *slot = nullptr;
+            while (ok && tokenized.pop(slot))
+            {
+                ok = cw.block(slot->stored ? nullptr : &slot->tokens, slot->raw.data(), slot->n, slot->final, err);
+                empty.push(slot);
             }
+            // On a write error, unblock the other stages so they can be joined
+            empty.close();
+            filled.close();
+            tokenized.close();
+            reader.join();
+            tokenizer.join();
+            if (!readOk)
+            {
+                if (err)
+                    *err = readErr;
+                return false;
+            }
+            return ok;
         }
 
-        // Write EOB
-        if (!llCodec.encode(256, bw))
+        bool deflateStreamWith(Workspace &ws, std::istream &in, std::ostream &out, std::string *err)
         {
-            if (err)
-                *err = "deflateStream: failed to encode EOB";
-            return false;
+            const DeflateOptions &opt = ws.opt;
+            // Write header (byte-aligned)
+            BitWriter bw(out, ws.staging);
+            ContainerWriter cw(bw, opt, ws.blocks, ws.index);
+            if (!cw.begin(probeStreamSize(in), err))
+            {
+                return false;
+            }
+
+            const unsigned threads = resolveThreads(opt.threads);
+            if (threads > 1)
+            {
+                BlockSource read = [&in, err](uint8_t *dst, size_t max, size_t &n, bool &final)
+                { return readBlock(in, dst, max, n, final, err); };
+                if (!deflateParallel(cw, opt, threads, read, err))
+                    return false;
+                return cw.end(err);
+            }
+            if (opt.pipeline)
+                return deflatePipelined(ws, cw, in, err) && cw.end(err);
+
+            LZ77Encoder &lz77 = ws.freshEncoder();
+            const size_t blockSize = std::max<uint32_t>(opt.blockSize, 1);
+            const size_t unit = lz77.slideUnit();
+
+            // Buffer layout: [history (< 2 * unit) | current block]; a preset dictionary is the
+            // first block's history
+            std::vector<uint8_t> &buf = ws.window;
+            buf.resize(2 * unit + blockSize);
+            TokenBuffer &tokens = ws.tokens;
+            tokens.reserve(blockSize);
+            size_t histLen = usableDictionarySize(opt.lz);
+            std::copy(opt.lz.dictionary.end() - static_cast<std::ptrdiff_t>(histLen), opt.lz.dictionary.end(), buf.begin());
+
+            bool final = false;
+            while (!final)
+            {
+                size_t n = 0;
+                if (!readBlock(in, buf.data() + histLen, blockSize, n, final, err))
+                {
+                    return false;
+                }
+
+                const TokenBuffer *blockTokens = tokenizeBlock(lz77, opt, buf.data(), histLen, histLen + n, tokens);
+                if (!cw.block(blockTokens, buf.data() + histLen, n, final, err))
+                {
+                    return false;
+                }
+
+                if (independentBlocks(opt))
+                {
+                    lz77.reset();
+                    histLen = 0;
+                    continue;
+                }
+
+                size_t total = histLen + n;
+                size_t delta = slideDelta(total, unit);
+                if (delta > 0)
+                {
+                    std::memmove(buf.data(), buf.data() + delta, total - delta);
+                    lz77.slide(delta);
+                }
+                histLen = total - delta;
+            }
+
+            if (!cw.end(err))
+                return false;
+            if (!out)
+            {
+                if (err)
+                    *err = "deflateStream: output stream error";
+                return false;
+            }
+
+            return true;
         }
 
-        // Flush bit writer
-        bw.flush();
+        // Compress a span already in memory; the match finder reads it in place
+        bool deflateSpan(Workspace &ws, const uint8_t *data, size_t size, BitWriter &bw, std::string *err)
+        {
+            const DeflateOptions &opt = ws.opt;
+            ContainerWriter cw(bw, opt, ws.blocks, ws.index);
+            if (!cw.begin(size, err))
+            {
+                return false;
+            }
 
-        if (!out)
+            const unsigned threads = resolveThreads(opt.threads);
+            if (threads > 1)
+            {
+                size_t pos = 0;
+                BlockSource read = [data, size, &pos](uint8_t *dst, size_t max, size_t &n, bool &final)
+                {
+                    n = std::min(max, size - pos);
+                    if (n > 0)
+                        std::memcpy(dst, data + pos, n);
+                    pos += n;
+                    final = (pos == size);
+                    return true;
+                };
+                return deflateParallel(cw, opt, threads, read, err) && cw.end(err);
+            }
+
+            // The match finder needs a preset dictionary directly in front of the data. Such
+            // inputs are small, so they are copied behind it; pos and size then skip it.
+            size_t pos = 0;
+            if (!opt.lz.dictionary.empty())
+            {
+                std::vector<uint8_t> &joined = ws.window;
+                pos = usableDictionarySize(opt.lz);
+                joined.assign(opt.lz.dictionary.end() - static_cast<std::ptrdiff_t>(pos), opt.lz.dictionary.end());
+                joined.insert(joined.end(), data, data + size);
+                data = joined.data();
+                size = joined.size();
+            }
+
+            LZ77Encoder &lz77 = ws.freshEncoder();
+            const size_t blockSize = std::max<uint32_t>(opt.blockSize, 1);
+            const size_t unit = lz77.slideUnit();
+            TokenBuffer &tokens = ws.tokens;
+            tokens.reserve(std::min(blockSize, size));
+
+            // The encoder sees data + base as position 0; base advances so positions stay 32-bit
+            size_t base = 0;
+            bool final = false;
+            while (!final)
+            {
+                size_t n = std::min(blockSize, size - pos);
+                final = (pos + n == size);
+
+                const TokenBuffer *blockTokens = tokenizeBlock(lz77, opt, data + base, pos - base, pos + n - base, tokens);
+                if (!cw.block(blockTokens, data + pos, n, final, err))
+                {
+                    return false;
+                }
+                pos += n;
+
+                if (independentBlocks(opt))
+                {
+                    lz77.reset();
+                    base = pos;
+                    continue;
+                }
+
+                size_t delta = slideDelta(pos - base, unit);
+                if (delta > 0)
+                {
+                    base += delta;
+                    lz77.slide(delta);
+                }
+            }
+
+            return cw.end(err);
+        }
+
+        // Whether a context can keep its match finder across an options change
+        bool sameMatchFinder(const LZ77Options &a, const LZ77Options &b)
+        {
+            return a.windowSize == b.windowSize && a.minMatch == b.minMatch && a.maxMatch == b.maxMatch &&
+                   a.maxCandidates == b.maxCandidates && a.level == b.level && a.dictionary == b.dictionary;
+        }
+    }
+
+    bool deflateStream(std::istream &in, std::ostream &out, const DeflateOptions &opt, std::string *err)
+    {
+        Workspace ws(opt);
+        return deflateStreamWith(ws, in, out, err);
+    }
+
+    bool deflateBuffer(const uint8_t *data, size_t size, std::vector<uint8_t> &out, const DeflateOptions &opt, std::string *err)
+    {
+        Workspace ws(opt);
+        BitWriter bw(out);
+        return deflateSpan(ws, data, size, bw, err);
+    }
+
+    bool deflateFile(const std::string &path, std::ostream &out, const DeflateOptions &opt, std::string *err)
+    {
+#ifdef __linux__
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
         {
             if (err)
-                *err = "deflateStream: output stream error";
+                *err = "deflateFile: cannot open " + path;
             return false;
         }
+        struct stat st{};
+        const bool pipelined = opt.pipeline && resolveThreads(opt.threads) == 1;
+        if (opt.lz.dictionary.empty() && !pipelined && ::fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+        {
+            const size_t size = static_cast<size_t>(st.st_size);
+            void *map = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            ::close(fd);
+            if (map != MAP_FAILED)
+            {
+                ::madvise(map, size, MADV_SEQUENTIAL);
+                Workspace ws(opt);
+                BitWriter bw(out);
+                bool ok = deflateSpan(ws, static_cast<const uint8_t *>(map), size, bw, err);
+                ::munmap(map, size);
+                return ok;
+            }
+        }
+        else
+        {
+            ::close(fd);
+        }
+#endif
+        // Empty files, pipes, failed mappings, preset dictionaries and pipelined
+        // compression go through the stream path
+        std::ifstream in(path, std::ios::binary);
+        if (!in)
+        {
+            if (err)
+                *err = "deflateFile: cannot open " + path;
+            return false;
+        }
+        return deflateStream(in, out, opt, err);
+    }
 
-        return true;
+    struct DeflateContext::Impl : Workspace
+    {
+        using Workspace::Workspace;
+    };
+
+    DeflateContext::DeflateContext(const DeflateOptions &opt) : impl_(std::make_unique<Impl>(opt)) {}
+
+    DeflateContext::~DeflateContext() = default;
+
+    void DeflateContext::reset(const DeflateOptions &opt)
+    {
+        if (!sameMatchFinder(impl_->opt.lz, opt.lz))
+            impl_->lz77.reset();
+        impl_->opt = opt;
+    }
+
+    const DeflateOptions &DeflateContext::options() const
+    {
+        return impl_->opt;
+    }
+
+    bool DeflateContext::compress(const uint8_t *data, size_t size, std::vector<uint8_t> &out, std::string *err)
+    {
+        BitWriter bw(out);
+        return deflateSpan(*impl_, data, size, bw, err);
+    }
+
+    bool DeflateContext::compress(std::istream &in, std::ostream &out, std::string *err)
+    {
+        return deflateStreamWith(*impl_, in, out, err);
     }
 
 } // namespace fc
@@ -1,19 +1,93 @@
 #pragma once
 #include <iosfwd>
+#include <memory>
 #include <string>
+#include <vector>
+#include <cstdint>
 #include "lz77.h"
 
 namespace fc
 {
 
+    // Container format version written by deflateStream and accepted by inflateStream
+    constexpr uint16_t FORMAT_VERSION = 8;
+
+    // Largest DeflateOptions::blockSize: a block and the history in front of it (under
+    // 64 KiB) must stay well inside the match finder's 32-bit positions
+    constexpr uint32_t MAX_BLOCK_SIZE = (1u << 30) - 64 * 1024;
+
+    enum class ContainerFormat : uint8_t
+    {
+        FC = 0,        // this tool's "FC01" container
+        Gzip = 1,      // RFC 1952 gzip member with RFC 1951 stored/fixed/dynamic blocks
+        FCIndexed = 2  // FC01 with self-contained blocks and a trailing block index,
+                       // so inflate can decode blocks on several threads
+    };
+
     struct DeflateOptions
     {
         LZ77Options lz{};
-        bool storeFreqTablesInHeader = true;
-        uint16_t version = 1;
+        ContainerFormat format = ContainerFormat::FC;
+        uint16_t version = FORMAT_VERSION;
+        uint32_t blockSize = 1024 * 1024; // raw bytes per block; bounds memory use; at most MAX_BLOCK_SIZE
+        // Compression threads; 0 = one per hardware thread. Above 1, blocks are tokenized
+        // concurrently, each primed with the preceding window of input instead of the full
+        // match-finder history, and written in input order. FC output then matches the
+        // serial path except at Fastest, which skips indexing match interiors, so a block's
+        // starting state depends on how the one before it parsed; gzip output also gains
+        // an empty stored block after each parallel block.
+        uint32_t threads = 1;
+        // With threads == 1: read, tokenize and entropy-code on three threads joined by
+        // bounded queues, so input I/O overlaps compression. Output is identical to the
+        // serial path; costs a few blocks of buffering. Ignored above one thread.
+        bool pipeline = false;
+        // Incompressible-block detection. Before tokenizing, a few spans of each block are
+        // sampled for order-0 entropy (bits per byte) and match density (share of sampled
+        // positions repeating 4+ bytes from under lz.windowSize before). A block at or above
+        // the entropy and at or below the density is written as stored blocks, with no match
+        // search or Huffman tables. An entropy above 8 turns detection off.
+        double incompressibleEntropy = 7.9;
+        double incompressibleMatchDensity = 0.02;
     };
 
-    // Compress input stream into custom DEFLATE-like container
+    // Compress input stream into custom DEFLATE-like container.
+    // Input is processed block by block with a sliding history, so memory use
+    // does not depend on input size.
     bool deflateStream(std::istream &in, std::ostream &out, const DeflateOptions &opt, std::string *err);
 
+    // Compress an in-memory buffer; the container is appended to out
+    bool deflateBuffer(const uint8_t *data, size_t size, std::vector<uint8_t> &out, const DeflateOptions &opt, std::string *err);
+
+    // Compress the file at path. On Linux a regular file is mapped read-only and the
+    // match finder reads the mapping in place; elsewhere, for pipes or empty files, and
+    // with opt.pipeline, this is deflateStream over an ifstream.
+    bool deflateFile(const std::string &path, std::ostream &out, const DeflateOptions &opt, std::string *err);
+
+    // Compressor for many calls in a row, e.g. small buffers in a service. It owns the
+    // match finder, token, window and block-planning memory and keeps it between calls,
+    // so once warmed up a serial compress() allocates nothing but the growth of out.
+    // Calls are independent: no history carries over. One context per thread; with
+    // options().threads > 1 the worker pool is still set up per call.
+    class DeflateContext
+    {
+    public:
+        explicit DeflateContext(const DeflateOptions &opt = {});
+        ~DeflateContext();
+        DeflateContext(const DeflateContext &) = delete;
+        DeflateContext &operator=(const DeflateContext &) = delete;
+
+        // Switch options, keeping the working memory; the match finder is rebuilt only
+        // when the LZ77 options differ
+        void reset(const DeflateOptions &opt);
+        const DeflateOptions &options() const;
+
+        // Same output as deflateBuffer / deflateStream with options()
+        bool compress(const uint8_t *data, size_t size, std::vector<uint8_t> &out, std::string *err);
+        bool compress(std::istream &in, std::ostream &out, std::string *err);
+
+    private:
+        struct Impl;
+        std::unique_ptr<Impl> impl_;
+    };
+
 } // namespace fc
@@ -0,0 +1,159 @@
+#include "dictionary.h"
+#include "checksum.h"
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+namespace fc
+{
+    namespace
+    {
+        constexpr size_t DMER = 8;      // substring length that is scored; one uint64_t key
+        constexpr size_t SEGMENT = 256; // bytes copied into the dictionary per pick
+
+        inline uint64_t dmerAt(const uint8_t *p)
+        {
+            uint64_t v;
+            std::memcpy(&v, p, sizeof(v));
+            return v;
+        }
+
+        struct DmerStats
+        {
+            uint32_t samples = 0;  // samples containing the d-mer
+            uint32_t lastSample = 0;
+        };
+
+        struct Segment
+        {
+            uint64_t score = 0;
+            size_t start = 0;
+        };
+    }
+
+    uint32_t dictionaryId(const std::vector<uint8_t> &dictionary)
+    {
+        return crc32(0, dictionary.data(), dictionary.size());
+    }
+
+    bool trainDictionary(const std::vector<std::vector<uint8_t>> &samples, size_t maxSize,
+                         std::vector<uint8_t> &dictionary, std::string *err)
+    {
+        auto fail = [err](const char *msg)
+        {
+            if (err)
+                *err = msg;
+            return false;
+        };
+        if (maxSize < SEGMENT)
+            return fail("trainDictionary: dictionary size must be at least 256 bytes");
+
+        // All samples back to back; valid marks positions whose d-mer stays inside one sample
+        std::vector<uint8_t> all;
+        std::vector<uint8_t> valid;
+        for (const auto &s : samples)
+        {
+            all.insert(all.end(), s.begin(), s.end());
+            valid.resize(all.size(), 0);
+            if (s.size() >= DMER)
+                std::fill(valid.end() - static_cast<std::ptrdiff_t>(s.size()), valid.end() - (DMER - 1), 1);
+        }
+        if (all.size() < SEGMENT)
+            return fail("trainDictionary: not enough sample data");
+
+        // Weight of a d-mer: the number of samples it occurs in, if more than one
+        std::unordered_map<uint64_t, DmerStats> stats;
+        size_t pos = 0;
+        for (uint32_t i = 0; i < samples.size(); ++i)
+        {
+            for (size_t end = pos + samples[i].size(); pos < end; ++pos)
+            {
+                if (!valid[pos])
+                    continue;
+                DmerStats &d = stats[dmerAt(all.data() + pos)];
+                if (d.samples == 0 || d.lastSample != i)
+                {
+                    ++d.samples;
+                    d.lastSample = i;
+                }
+            }
+        }
+        std::unordered_map<uint64_t, uint32_t> weight;
+        for (const auto &kv : stats)
+            if (kv.second.samples > 1)
+                weight.emplace(kv.first, kv.second.samples);
+        stats.clear();
+        if (weight.empty())
+            return fail("trainDictionary: samples share no content");
+
+        // One pick per epoch: the SEGMENT-byte window whose distinct d-mers weigh the most.
+        // Picked d-mers drop to weight 0 so later epochs cover something new.
+        const size_t epochs = std::max<size_t>(1, std::min(maxSize / SEGMENT, all.size() / SEGMENT));
+        const size_t epochSize = all.size() / epochs;
+        std::vector<Segment> picks;
+        std::unordered_map<uint64_t, uint32_t> active; // d-mers in the window -> occurrences
+        for (size_t e = 0; e < epochs; ++e)
+        {
+            const size_t begin = e * epochSize;
+            const size_t end = (e + 1 == epochs) ? all.size() : begin + epochSize;
+            if (end - begin < SEGMENT)
+                continue;
+
+            active.clear();
+            uint64_t score = 0;
+            Segment best;
+            best.start = begin;
+            size_t added = begin; // d-mers at [begin, added) have entered the window
+            for (size_t s = begin; s + SEGMENT <= end; ++s)
+            {
+                for (; added <= s + SEGMENT - DMER; ++added)
+                {
+                    if (!valid[added])
+                        continue;
+                    uint64_t key = dmerAt(all.data() + added);
+                    if (active[key]++ == 0)
+                    {
+                        auto w = weight.find(key);
+                        score += (w != weight.end()) ? w->second : 0;
+                    }
+                }
+                if (score > best.score)
+                {
+                    best.score = score;
+                    best.start = s;
+                }
+                if (valid[s])
+                {
+                    uint64_t key = dmerAt(all.data() + s);
+                    auto it = active.find(key);
+                    if (--it->second == 0)
+                    {
+                        auto w = weight.find(key);
+                        score -= (w != weight.end()) ? w->second : 0;
+                        active.erase(it);
+                    }
+                }
+            }
+            if (best.score == 0)
+                continue;
+
+            picks.push_back(best);
+            for (size_t p = best.start; p + DMER <= best.start + SEGMENT; ++p)
+                if (valid[p])
+                    weight.erase(dmerAt(all.data() + p));
+        }
+        if (picks.empty())
+            return fail("trainDictionary: samples share no content");
+
+        // Ascending score, so the best segments end up nearest the data
+        std::stable_sort(picks.begin(), picks.end(), [](const Segment &a, const Segment &b)
+                         { return a.score < b.score; });
+        const size_t keep = std::min(picks.size(), maxSize / SEGMENT);
+        dictionary.clear();
+        for (size_t i = picks.size() - keep; i < picks.size(); ++i)
+            dictionary.insert(dictionary.end(), all.begin() + static_cast<std::ptrdiff_t>(picks[i].start),
+                              all.begin() + static_cast<std::ptrdiff_t>(picks[i].start + SEGMENT));
+        return true;
+    }
+
+} // namespace fc
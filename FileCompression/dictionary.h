@@ -0,0 +1,20 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace fc
+{
+
+    // Identifies a preset dictionary in container headers: CRC-32 of all its bytes
+    uint32_t dictionaryId(const std::vector<uint8_t> &dictionary);
+
+    // Build a preset dictionary of at most maxSize bytes from sample inputs, such as a
+    // few thousand typical records. Segments whose 8-byte substrings recur across the
+    // most samples are kept (a simplified form of zstd's COVER trainer), the most
+    // valuable last, where match distances are shortest.
+    bool trainDictionary(const std::vector<std::vector<uint8_t>> &samples, size_t maxSize,
+                         std::vector<uint8_t> &dictionary, std::string *err);
+
+} // namespace fc
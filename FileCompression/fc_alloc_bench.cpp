@@ -0,0 +1,289 @@
+// fc_alloc_bench: heap allocations and time per call for small inputs, comparing the
+// one-shot functions with DeflateContext / InflateContext reused across calls
+//
+// Build (from this directory, all on one line):
+//   g++ -std=c++17 -O2 -pthread -o fc_alloc_bench fc_alloc_bench.cpp bit_io.cpp checksum.cpp
+//       deflate.cpp dictionary.cpp huffman.cpp inflate.cpp lz77.cpp match_length.cpp
+//
+// Global operator new/delete are replaced with counting versions. Every call counts
+// what it allocates, including the growth of the output vector, which the benchmark
+// keeps between calls like a caller reusing its buffers would. Stream calls read and
+// write preallocated memory through a fixed streambuf, so the streams allocate nothing.
+// Every match level is run, since each keeps different state in the context (the
+// optimal parser's per-block arrays above all); --level picks one.
+#include <iostream>
+#include <istream>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#include "bench_common.h"
+#include "deflate.h"
+#include "inflate.h"
+
+// Once a replacement is inlined GCC sees malloc/free meet new/delete and reports
+// -Wmismatched-new-delete; kept out of line, each side is an opaque matched pair
+#if defined(__GNUC__) || defined(__clang__)
+#define FC_NOINLINE __attribute__((noinline))
+#else
+#define FC_NOINLINE
+#endif
+
+namespace
+{
+    size_t g_allocs = 0;
+    size_t g_bytes = 0;
+}
+
+FC_NOINLINE void *operator new(size_t size)
+{
+    ++g_allocs;
+    g_bytes += size;
+    if (void *p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+FC_NOINLINE void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+FC_NOINLINE void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+FC_NOINLINE void operator delete[](void *p) noexcept
+{
+    std::free(p);
+}
+
+FC_NOINLINE void operator delete(void *p, size_t) noexcept
+{
+    std::free(p);
+}
+
+FC_NOINLINE void operator delete[](void *p, size_t) noexcept
+{
+    std::free(p);
+}
+
+namespace
+{
+    using fc::bench::levelName;
+    using fc::bench::parseLevel;
+
+    // Reads from / writes into caller memory; overflowing the write area fails the stream
+    class FixedBuf : public std::streambuf
+    {
+    public:
+        void source(const uint8_t *data, size_t size)
+        {
+            char *p = const_cast<char *>(reinterpret_cast<const char *>(data));
+            setg(p, p, p + size);
+        }
+        void sink(std::vector<uint8_t> &mem)
+        {
+            char *p = reinterpret_cast<char *>(mem.data());
+            setp(p, p + mem.size());
+        }
+        size_t written() const { return static_cast<size_t>(pptr() - pbase()); }
+    };
+
+    // Word soup with some repetition, close to a small JSON or log record
+    std::vector<uint8_t> makeInput(size_t size, uint64_t seed)
+    {
+        static const char *const words[] = {"id", "name", "value", "status", "ok", "error", "timestamp",
+                                            "user", "request", "response", "count", "items", "true", "false"};
+        fc::bench::Rng rng(seed);
+        std::vector<uint8_t> out;
+        out.reserve(size);
+        while (out.size() < size)
+        {
+            const uint64_t r = rng.next();
+            const char *w = words[(r >> 33) % (sizeof(words) / sizeof(words[0]))];
+            out.insert(out.end(), w, w + std::strlen(w));
+            out.push_back((r >> 20) & 1 ? ':' : ' ');
+            out.push_back(static_cast<uint8_t>('0' + (r >> 40) % 10));
+            out.push_back(',');
+        }
+        out.resize(size);
+        return out;
+    }
+
+    struct Measure
+    {
+        double allocs = 0; // per call
+        double bytes = 0;
+        double micros = 0;
+    };
+
+    // Run fn up to calls times after a warm-up call, stopping early once a second has
+    // passed (optimal on 64 KiB takes milliseconds per call); fn returns false on failure
+    template <typename Fn>
+    bool measure(int calls, Fn fn, Measure &m)
+    {
+        if (!fn())
+            return false;
+        const size_t a0 = g_allocs, b0 = g_bytes;
+        const auto t0 = std::chrono::steady_clock::now();
+        auto t1 = t0;
+        int done = 0;
+        while (done < calls && (done < 10 || t1 - t0 < std::chrono::seconds(1)))
+        {
+            if (!fn())
+                return false;
+            ++done;
+            t1 = std::chrono::steady_clock::now();
+        }
+        m.allocs = static_cast<double>(g_allocs - a0) / done;
+        m.bytes = static_cast<double>(g_bytes - b0) / done;
+        m.micros = std::chrono::duration<double, std::micro>(t1 - t0).count() / done;
+        return true;
+    }
+
+    void printRow(const char *what, size_t size, const Measure &m)
+    {
+        char line[160];
+        std::snprintf(line, sizeof(line), "%-26s %8zu %12.1f %14.0f %12.2f\n", what, size, m.allocs, m.bytes, m.micros);
+        std::cout << line;
+    }
+
+    void printUsage(const char *exe)
+    {
+        std::cerr << "使用方法: " << exe << " [选项]\n"
+                  << "  --sizes <a,b>   输入大小, 字节 (默认 256,1024,4096,65536)\n"
+                  << "  --level <名称>  只测该匹配策略 fastest / greedy / lazy / optimal (默认全部)\n"
+                  << "  --gzip          使用 gzip 容器\n"
+                  << "  --calls <N>     每项计时调用次数上限, 每项最多约 1 秒 (默认 2000)\n";
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    std::vector<size_t> sizes = {256, 1024, 4096, 65536};
+    std::vector<fc::CompressionLevel> levels = {fc::CompressionLevel::Fastest, fc::CompressionLevel::Greedy,
+                                                fc::CompressionLevel::Lazy, fc::CompressionLevel::Optimal};
+    fc::DeflateOptions dopt{};
+    int calls = 2000;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--sizes" && hasValue)
+        {
+            sizes.clear();
+            std::string list = argv[++i];
+            for (size_t pos = 0; pos <= list.size();)
+            {
+                size_t comma = std::min(list.find(',', pos), list.size());
+                if (comma > pos)
+                    sizes.push_back(std::strtoul(list.substr(pos, comma - pos).c_str(), nullptr, 10));
+                pos = comma + 1;
+            }
+        }
+        else if (arg == "--level" && hasValue)
+        {
+            levels.assign(1, fc::CompressionLevel::Greedy);
+            if (!parseLevel(argv[++i], levels[0]))
+            {
+                std::cerr << "❌ 错误: 未知的匹配策略 \"" << argv[i] << "\"\n";
+                return 1;
+            }
+        }
+        else if (arg == "--gzip")
+            dopt.format = fc::ContainerFormat::Gzip;
+        else if (arg == "--calls" && hasValue)
+            calls = std::max(1, std::atoi(argv[++i]));
+        else
+        {
+            std::cerr << "❌ 错误: 未知的选项 \"" << arg << "\"\n";
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    std::cout << "call                           bytes  allocs/call    bytes/call      us/call\n";
+    for (fc::CompressionLevel level : levels)
+    {
+        dopt.lz.level = level;
+        std::cout << "-- " << levelName(level) << "\n";
+        fc::DeflateContext dctx(dopt);
+        fc::InflateContext ictx;
+        for (size_t size : sizes)
+        {
+            const std::vector<uint8_t> input = makeInput(size, 0x9E3779B97F4A7C15ull ^ size);
+            std::vector<uint8_t> packed, raw;
+            std::string err;
+            if (!fc::deflateBuffer(input.data(), input.size(), packed, dopt, &err))
+            {
+                std::cerr << "❌ 压缩失败: " << err << "\n";
+                return 3;
+            }
+            const std::vector<uint8_t> reference = packed;
+
+            std::vector<uint8_t> streamOut(reference.size() + input.size() + 4096);
+            FixedBuf inBuf, outBuf;
+            std::istream in(&inBuf);
+            std::ostream out(&outBuf);
+            auto streamCall = [&](const uint8_t *data, size_t n, auto &&run)
+            {
+                inBuf.source(data, n);
+                outBuf.sink(streamOut);
+                in.clear();
+                out.clear();
+                return run();
+            };
+
+            // Each variant must reproduce the reference output, so a broken reuse path
+            // cannot post good numbers
+            Measure m;
+            bool ok = measure(calls, [&]
+                              { packed.clear();
+                                return fc::deflateBuffer(input.data(), input.size(), packed, dopt, &err) && packed == reference; }, m);
+            printRow("deflateBuffer", size, m);
+            ok = ok && measure(calls, [&]
+                               { packed.clear();
+                                 return dctx.compress(input.data(), input.size(), packed, &err) && packed == reference; }, m);
+            printRow("DeflateContext (buffer)", size, m);
+            ok = ok && measure(calls, [&]
+                               { return streamCall(input.data(), input.size(), [&]
+                                                   { return fc::deflateStream(in, out, dopt, &err); }); }, m);
+            printRow("deflateStream", size, m);
+            ok = ok && measure(calls, [&]
+                               { return streamCall(input.data(), input.size(), [&]
+                                                   { return dctx.compress(in, out, &err); }); }, m);
+            printRow("DeflateContext (stream)", size, m);
+
+            ok = ok && measure(calls, [&]
+                               { return fc::inflateBuffer(reference.data(), reference.size(), raw, &err) && raw == input; }, m);
+            printRow("inflateBuffer", size, m);
+            ok = ok && measure(calls, [&]
+                               { return ictx.decompress(reference.data(), reference.size(), raw, &err) && raw == input; }, m);
+            printRow("InflateContext (buffer)", size, m);
+            ok = ok && measure(calls, [&]
+                               { return streamCall(reference.data(), reference.size(), [&]
+                                                   { return fc::inflateStream(in, out, &err) && outBuf.written() == size; }); }, m);
+            printRow("inflateStream", size, m);
+            ok = ok && measure(calls, [&]
+                               { return streamCall(reference.data(), reference.size(), [&]
+                                                   { return ictx.decompress(in, out, &err) && outBuf.written() == size; }); }, m);
+            printRow("InflateContext (stream)", size, m);
+            if (!ok)
+            {
+                std::cerr << "❌ 失败 (" << size << " 字节): " << (err.empty() ? "输出不一致" : err) << "\n";
+                return 3;
+            }
+        }
+    }
+    return 0;
+}
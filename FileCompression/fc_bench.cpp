@@ -0,0 +1,851 @@
+// fc_bench: compression benchmark over a fixed corpus with a machine-readable report
+//
+// Build (from this directory, all on one line):
+//   g++ -std=c++17 -O2 -pthread -o fc_bench fc_bench.cpp bit_io.cpp checksum.cpp
+//       deflate.cpp dictionary.cpp huffman.cpp inflate.cpp lz77.cpp match_length.cpp
+//
+// Every build generates the same corpus from fixed seeds, so reports from two builds can
+// be diffed directly. Throughput is decimal MB (10^6 bytes) of uncompressed data per
+// second, the median over the timed repetitions. Peak RSS is per setting and includes
+// the corpus the benchmark holds in memory.
+//
+// Thread scaling of parallel compression (DeflateOptions::threads) and indexed decoding:
+//   fc_bench --threads 1,2,4,8 --levels greedy --containers fc,indexed
+// No multi-core results have been recorded yet; on one core this only shows the
+// overhead of the worker pool.
+//
+// --kernels times each match-length kernel (bytewise, word, and SSE2/AVX2 where the CPU
+// has them) on the candidate pairs a greedy match finder compares in each corpus, and
+// prints calls per second, matched bytes per second and the speedup over "word".
+// --decode codes each corpus's bytes as literals and times HuffmanCodec::decode's
+// two-level table against a canonical decoder that reads one bit at a time.
+// --finder times greedy LZ77 with MatchFinder against the per-bucket vector chains it
+// replaced, with the memory each keeps for match finding.
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#ifdef __linux__
+#include <sys/resource.h>
+#endif
+
+#include "bench_common.h"
+#include "bit_io.h"
+#include "deflate.h"
+#include "huffman.h"
+#include "inflate.h"
+#include "lz77.h"
+#include "match_length.h"
+
+namespace
+{
+    using fc::bench::makeRandom;
+    using fc::bench::makeRepetitive;
+    using fc::bench::makeText;
+    using fc::bench::parseLevel;
+    using fc::bench::Rng;
+
+    struct Corpus
+    {
+        std::string name;
+        std::vector<std::string> files; // compressed one at a time
+        size_t bytes() const
+        {
+            size_t n = 0;
+            for (const auto &f : files)
+                n += f.size();
+            return n;
+        }
+    };
+
+    std::string makeSource(size_t size, uint64_t seed)
+    {
+        const char *const types[] = {"int", "size_t", "uint32_t", "bool", "auto", "const std::string &", "double"};
+        const char *const names[] = {"count", "offset", "length", "buffer", "index", "result", "value", "state",
+                                     "next", "total", "limit", "entry", "node", "cursor", "block", "window"};
+        Rng rng(seed);
+        std::string s;
+        s.reserve(size + 256);
+        int fn = 0;
+        while (s.size() < size)
+        {
+            s += "static " + std::string(types[rng.below(7)]) + " process" + std::to_string(fn++) + "(";
+            s += std::string(types[rng.below(7)]) + " " + names[rng.below(16)] + ", " + types[rng.below(7)] + " " + names[rng.below(16)] + ")\n{\n";
+            uint32_t lines = 3 + rng.below(12);
+            for (uint32_t i = 0; i < lines; ++i)
+            {
+                const char *a = names[rng.below(16)];
+                const char *b = names[rng.below(16)];
+                switch (rng.below(5))
+                {
+                case 0:
+                    s += std::string("    ") + types[rng.below(7)] + " " + a + " = " + b + " + " + std::to_string(rng.below(256)) + ";\n";
+                    break;
+                case 1:
+                    s += std::string("    if (") + a + " < " + b + ")\n    {\n        " + a + " = " + b + ";\n    }\n";
+                    break;
+                case 2:
+                    s += std::string("    for (size_t i = 0; i < ") + a + "; ++i)\n        " + b + "[i] = " + a + " >> " + std::to_string(rng.below(16)) + ";\n";
+                    break;
+                case 3:
+                    s += std::string("    // Update the ") + a + " before the " + b + " is read again\n";
+                    break;
+                default:
+                    s += std::string("    ") + a + " = process" + std::to_string(rng.below(static_cast<uint32_t>(fn))) + "(" + b + ", " + a + ");\n";
+                    break;
+                }
+            }
+            s += "    return " + std::string(names[rng.below(16)]) + ";\n}\n\n";
+        }
+        s.resize(size);
+        return s;
+    }
+
+    // Fixed-size records like a log or table dump: counters, timestamps, a random-walk
+    // float, flags and a short name
+    std::string makeBinary(size_t size, uint64_t seed)
+    {
+        const char *const tags[] = {"sensor-a", "sensor-b", "pump", "valve-01", "valve-02", "inlet", "outlet"};
+        Rng rng(seed);
+        std::string s;
+        s.reserve(size + 32);
+        uint32_t id = 0;
+        uint32_t stamp = 1700000000;
+        float value = 20.0f;
+        while (s.size() < size)
+        {
+            char rec[32] = {};
+            stamp += 1 + rng.below(3);
+            value += (static_cast<float>(rng.below(2001)) - 1000.0f) / 1000.0f;
+            uint16_t flags = static_cast<uint16_t>(1u << rng.below(4));
+            std::memcpy(rec, &id, 4);
+            std::memcpy(rec + 4, &stamp, 4);
+            std::memcpy(rec + 8, &value, 4);
+            std::memcpy(rec + 12, &flags, 2);
+            const char *tag = tags[rng.below(7)];
+            std::memcpy(rec + 16, tag, std::strlen(tag));
+            s.append(rec, sizeof(rec));
+            ++id;
+        }
+        s.resize(size);
+        return s;
+    }
+
+    // Many small text/source files, each compressed on its own
+    std::vector<std::string> makeSmallFiles(size_t size, uint64_t seed)
+    {
+        Rng rng(seed);
+        std::vector<std::string> files;
+        size_t total = 0;
+        while (total < size)
+        {
+            size_t n = std::min<size_t>(128 + rng.below(8064), size - total);
+            files.push_back(rng.below(2) ? makeText(n, rng.next()) : makeSource(n, rng.next()));
+            total += n;
+        }
+        return files;
+    }
+
+    std::vector<Corpus> builtinCorpus(size_t size)
+    {
+        return {
+            {"text", {makeText(size, 1)}},
+            {"source", {makeSource(size, 2)}},
+            {"binary", {makeBinary(size, 3)}},
+            {"random", {makeRandom(size, 4)}},
+            {"repetitive", {makeRepetitive(size, 5)}},
+            {"small-files", makeSmallFiles(size, 6)},
+        };
+    }
+
+    // Each regular file in dir becomes a corpus of its own, in name order
+    bool loadCorpus(const std::string &dir, std::vector<Corpus> &out)
+    {
+        std::error_code ec;
+        std::vector<std::filesystem::path> paths;
+        for (const auto &e : std::filesystem::directory_iterator(dir, ec))
+            if (e.is_regular_file())
+                paths.push_back(e.path());
+        if (ec)
+            return false;
+        std::sort(paths.begin(), paths.end());
+        for (const auto &p : paths)
+        {
+            std::ifstream f(p, std::ios::binary);
+            std::ostringstream ss;
+            ss << f.rdbuf();
+            out.push_back({p.filename().string(), {ss.str()}});
+        }
+        return true;
+    }
+
+    // Peak RSS since the last reset. Linux lets the high-water mark be reset through
+    // clear_refs, so each setting gets its own peak; elsewhere it is the process peak.
+    void resetPeakRss()
+    {
+#ifdef __linux__
+        std::ofstream("/proc/self/clear_refs") << "5";
+#endif
+    }
+
+    long peakRssKb()
+    {
+#ifdef __linux__
+        std::ifstream status("/proc/self/status");
+        std::string line;
+        while (std::getline(status, line))
+            if (line.compare(0, 6, "VmHWM:") == 0)
+                return std::strtol(line.c_str() + 6, nullptr, 10);
+        struct rusage ru;
+        if (getrusage(RUSAGE_SELF, &ru) == 0)
+            return ru.ru_maxrss;
+#endif
+        return -1;
+    }
+
+    struct Setting
+    {
+        std::string level;
+        std::string format;
+        uint32_t threads = 1;
+    };
+
+    struct Result
+    {
+        std::string corpus;
+        size_t files = 0;
+        size_t original = 0;
+        size_t compressed = 0;
+        Setting setting;
+        double compressMBps = 0;
+        double decompressMBps = 0;
+        long peakRssKb = -1;
+    };
+
+    bool parseFormat(const std::string &name, fc::ContainerFormat &format)
+    {
+        if (name == "fc")
+            format = fc::ContainerFormat::FC;
+        else if (name == "gzip")
+            format = fc::ContainerFormat::Gzip;
+        else if (name == "indexed")
+            format = fc::ContainerFormat::FCIndexed;
+        else
+            return false;
+        return true;
+    }
+
+    std::vector<std::string> splitList(const std::string &s)
+    {
+        std::vector<std::string> out;
+        std::stringstream ss(s);
+        std::string item;
+        while (std::getline(ss, item, ','))
+            if (!item.empty())
+                out.push_back(item);
+        return out;
+    }
+
+    double median(std::vector<double> v)
+    {
+        std::sort(v.begin(), v.end());
+        return v.empty() ? 0.0 : v[v.size() / 2];
+    }
+
+    // One warm-up or timed pass over every file: seconds spent inside deflateStream and
+    // inflateStream only; the round trip is checked each time
+    bool runPass(const Corpus &c, const fc::DeflateOptions &dopt, const fc::InflateOptions &iopt,
+                 double &compressSec, double &decompressSec, size_t &compressed, std::string *err)
+    {
+        using Clock = std::chrono::steady_clock;
+        compressSec = decompressSec = 0;
+        compressed = 0;
+        for (const auto &file : c.files)
+        {
+            std::istringstream in(file);
+            std::ostringstream packed;
+            auto t0 = Clock::now();
+            if (!fc::deflateStream(in, packed, dopt, err))
+                return false;
+            auto t1 = Clock::now();
+
+            std::istringstream packedIn(packed.str());
+            std::ostringstream restored;
+            auto t2 = Clock::now();
+            if (!fc::inflateStream(packedIn, restored, iopt, err))
+                return false;
+            auto t3 = Clock::now();
+
+            compressSec += std::chrono::duration<double>(t1 - t0).count();
+            decompressSec += std::chrono::duration<double>(t3 - t2).count();
+            compressed += static_cast<size_t>(packed.tellp());
+            if (restored.str() != file)
+            {
+                if (err)
+                    *err = "round trip mismatch";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::string jsonEscape(const std::string &s)
+    {
+        std::string out;
+        for (char c : s)
+        {
+            if (c == '"' || c == '\\')
+                out += '\\';
+            out += c;
+        }
+        return out;
+    }
+
+    void writeJson(std::ostream &out, const std::vector<Result> &results, int reps, int warmup)
+    {
+        out << "{\n  \"format_version\": " << fc::FORMAT_VERSION << ",\n"
+            << "  \"match_kernel\": \"" << fc::bestMatchLengthName() << "\",\n"
+            << "  \"repetitions\": " << reps << ",\n  \"warmup\": " << warmup << ",\n  \"results\": [\n";
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            const Result &r = results[i];
+            out << "    {\"corpus\": \"" << jsonEscape(r.corpus) << "\", \"files\": " << r.files
+                << ", \"level\": \"" << r.setting.level << "\", \"container\": \"" << r.setting.format
+                << "\", \"threads\": " << r.setting.threads << ", \"original_bytes\": " << r.original
+                << ", \"compressed_bytes\": " << r.compressed << ", \"ratio\": " << r.compressed / static_cast<double>(std::max<size_t>(1, r.original))
+                << ", \"compress_mbps\": " << r.compressMBps << ", \"decompress_mbps\": " << r.decompressMBps
+                << ", \"peak_rss_kb\": " << r.peakRssKb << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+        }
+        out << "  ]\n}\n";
+    }
+
+    void writeCsv(std::ostream &out, const std::vector<Result> &results)
+    {
+        out << "corpus,files,level,container,threads,original_bytes,compressed_bytes,ratio,compress_mbps,decompress_mbps,peak_rss_kb\n";
+        for (const Result &r : results)
+        {
+            out << r.corpus << "," << r.files << "," << r.setting.level << "," << r.setting.format << ","
+                << r.setting.threads << "," << r.original << "," << r.compressed << ","
+                << r.compressed / static_cast<double>(std::max<size_t>(1, r.original)) << ","
+                << r.compressMBps << "," << r.decompressMBps << "," << r.peakRssKb << "\n";
+        }
+    }
+
+    // Concatenated files of a corpus, for the micro-benchmarks
+    std::string joined(const Corpus &c)
+    {
+        std::string s;
+        s.reserve(c.bytes());
+        for (const auto &f : c.files)
+            s += f;
+        return s;
+    }
+
+    template <typename Fn>
+    double medianSeconds(int reps, int warmup, Fn &&fn)
+    {
+        using Clock = std::chrono::steady_clock;
+        std::vector<double> sec;
+        for (int k = 0; k < warmup + reps; ++k)
+        {
+            auto t0 = Clock::now();
+            fn();
+            auto t1 = Clock::now();
+            if (k >= warmup)
+                sec.push_back(std::chrono::duration<double>(t1 - t0).count());
+        }
+        return std::max(1e-9, median(sec));
+    }
+
+    // --finder baseline: the match finder LZ77Encoder had before MatchFinder, one growing
+    // vector of positions per 16-bit hash, walked newest first. Kept as it was apart from
+    // the distance limit, which MatchFinder keeps below the window.
+    class VectorChainFinder
+    {
+    public:
+        explicit VectorChainFinder(const fc::LZ77Options &opt) : opt_(opt), chains_(65536) {}
+
+        void encode(const uint8_t *buf, size_t size, fc::TokenBuffer &tokens)
+        {
+            size_t pos = 0;
+            while (pos < size)
+            {
+                if (pos + opt_.minMatch <= size)
+                {
+                    fc::Match m = find(buf, pos, size);
+                    if (m.length >= opt_.minMatch)
+                    {
+                        tokens.pushMatch(m.length, m.distance);
+                        for (uint16_t i = 0; i < m.length && pos + i + 2 < size; ++i)
+                            chains_[hash(buf + pos + i)].push_back(static_cast<uint32_t>(pos + i));
+                        pos += m.length;
+                        continue;
+                    }
+                }
+                tokens.pushLiteral(buf[pos]);
+                if (pos + 2 < size)
+                    chains_[hash(buf + pos)].push_back(static_cast<uint32_t>(pos));
+                ++pos;
+            }
+        }
+
+        // What the chains hold; grows with the input
+        size_t chainBytes() const
+        {
+            size_t n = chains_.capacity() * sizeof(chains_[0]);
+            for (const auto &c : chains_)
+                n += c.capacity() * sizeof(uint32_t);
+            return n;
+        }
+
+    private:
+        static uint32_t hash(const uint8_t *p)
+        {
+            uint32_t h = p[0];
+            h = ((h << 5) ^ p[1]) & 0xFFFFu;
+            return ((h << 5) ^ p[2]) & 0xFFFFu;
+        }
+
+        fc::Match find(const uint8_t *buf, size_t pos, size_t size) const
+        {
+            fc::Match best;
+            const auto &chain = chains_[hash(buf + pos)];
+            const size_t window = std::min<uint32_t>(opt_.windowSize, 32768);
+            const size_t maxLen = std::min<size_t>(opt_.maxMatch, size - pos);
+            uint32_t checked = 0;
+            for (auto it = chain.rbegin(); it != chain.rend() && checked < opt_.maxCandidates; ++it)
+            {
+                if (pos - *it >= window)
+                    break; // chains are in position order
+                ++checked;
+                size_t len = 0;
+                while (len < maxLen && buf[*it + len] == buf[pos + len])
+                    ++len;
+                if (len >= opt_.minMatch && len > best.length)
+                {
+                    best.length = static_cast<uint16_t>(len);
+                    best.distance = static_cast<uint16_t>(pos - *it);
+                }
+            }
+            return best;
+        }
+
+        fc::LZ77Options opt_;
+        std::vector<std::vector<uint32_t>> chains_;
+    };
+
+    // --finder: greedy LZ77 over each corpus with MatchFinder (head/prev ring, as deflate
+    // runs it, one encodeBlock per blockSize) and with the vector chains it replaced.
+    // Match-finder memory is fixed for the ring and grows with the input for the chains.
+    int runFinderBench(const std::vector<Corpus> &corpus, int reps, int warmup)
+    {
+        fc::LZ77Options opt;
+        opt.level = fc::CompressionLevel::Greedy;
+        const size_t blockSize = fc::DeflateOptions{}.blockSize;
+        // head_ (64K) and prev_ (window rounded up to a power of two), 4 bytes an entry
+        const size_t ringBytes = (65536 + 32768) * sizeof(uint32_t);
+        std::cout << "corpus        finder        tokens      MB/s  finder KiB\n";
+        for (const Corpus &c : corpus)
+        {
+            const std::string data = joined(c);
+            const uint8_t *buf = reinterpret_cast<const uint8_t *>(data.data());
+            fc::TokenBuffer tokens;
+            tokens.reserve(data.size());
+
+            size_t ringTokens = 0;
+            const double ringSec = medianSeconds(reps, warmup, [&]
+                                                 {
+                fc::LZ77Encoder lz77(opt);
+                tokens.clear();
+                for (size_t pos = 0; pos < data.size(); pos += blockSize)
+                    lz77.encodeBlock(buf, pos, std::min(pos + blockSize, data.size()), tokens);
+                ringTokens = tokens.size(); });
+
+            size_t chainTokens = 0, chainBytes = 0;
+            const double chainSec = medianSeconds(reps, warmup, [&]
+                                                  {
+                VectorChainFinder finder(opt);
+                tokens.clear();
+                finder.encode(buf, data.size(), tokens);
+                chainTokens = tokens.size();
+                chainBytes = finder.chainBytes(); });
+
+            const double mb = data.size() / 1e6;
+            char line[128];
+            std::snprintf(line, sizeof(line), "%-12s %-10s %10zu %9.1f %11zu\n", c.name.c_str(), "chains", chainTokens,
+                          mb / chainSec, chainBytes / 1024);
+            std::cout << line;
+            std::snprintf(line, sizeof(line), "%-12s %-10s %10zu %9.1f %11zu\n", c.name.c_str(), "ring", ringTokens,
+                          mb / ringSec, ringBytes / 1024);
+            std::cout << line;
+        }
+        return 0;
+    }
+
+    // --kernels: every match-length kernel over the same candidate pairs. The pairs are
+    // what a greedy match finder would compare: each position against the previous one
+    // with the same 3-byte hash within 32 KiB, capped at 258 bytes, as deflate does.
+    struct MatchPair
+    {
+        uint32_t a, b;
+        uint16_t maxLen;
+    };
+
+    int runKernelBench(const std::vector<Corpus> &corpus, int reps, int warmup)
+    {
+        struct Kernel
+        {
+            const char *name;
+            fc::MatchLengthFn fn;
+        };
+        std::vector<Kernel> kernels = {{"bytewise", fc::matchLengthBytewise}, {"word", fc::matchLengthWord}};
+        if (fc::MatchLengthFn f = fc::sse2MatchLength())
+            kernels.push_back({"sse2", f});
+        if (fc::MatchLengthFn f = fc::avx2MatchLength())
+            kernels.push_back({"avx2", f});
+
+        constexpr size_t MAX_PAIRS = 4u << 20;
+        std::cout << "corpus        kernel        pairs  avg len   Mcalls/s    GB/s  vs word\n";
+        for (const Corpus &c : corpus)
+        {
+            const std::string data = joined(c);
+            const uint8_t *buf = reinterpret_cast<const uint8_t *>(data.data());
+            std::vector<MatchPair> pairs;
+            std::vector<uint32_t> head(1u << 15, 0xFFFFFFFFu);
+            for (size_t i = 0; i + 3 <= data.size() && pairs.size() < MAX_PAIRS; ++i)
+            {
+                uint32_t h = ((buf[i] << 10) ^ (buf[i + 1] << 5) ^ buf[i + 2]) & 0x7FFF;
+                if (head[h] != 0xFFFFFFFFu && i - head[h] <= 32768)
+                    pairs.push_back({head[h], static_cast<uint32_t>(i),
+                                     static_cast<uint16_t>(std::min<size_t>(258, data.size() - i))});
+                head[h] = static_cast<uint32_t>(i);
+            }
+            if (pairs.empty())
+                continue;
+
+            // kernels[0] is the bytewise reference the others must agree with
+            std::vector<double> sec(kernels.size());
+            uint64_t expected = 0;
+            for (size_t k = 0; k < kernels.size(); ++k)
+            {
+                uint64_t total = 0;
+                sec[k] = medianSeconds(reps, warmup, [&]
+                                       {
+                    total = 0;
+                    for (const MatchPair &p : pairs)
+                        total += kernels[k].fn(buf + p.a, buf + p.b, p.maxLen); });
+                if (k == 0)
+                    expected = total;
+                else if (total != expected)
+                {
+                    std::cerr << "❌ " << c.name << ": " << kernels[k].name << " 内核结果不一致\n";
+                    return 3;
+                }
+            }
+            const double avgLen = expected / static_cast<double>(pairs.size());
+            for (size_t k = 0; k < kernels.size(); ++k)
+            {
+                char line[128];
+                std::snprintf(line, sizeof(line), "%-12s %-8s %10zu %8.1f %10.1f %7.2f %8.2f\n", c.name.c_str(),
+                              kernels[k].name, pairs.size(), avgLen, pairs.size() / sec[k] / 1e6,
+                              expected / sec[k] / 1e9, sec[1] / sec[k]);
+                std::cout << line;
+            }
+        }
+        return 0;
+    }
+
+    // --decode baseline: canonical decoding one readBits(1) per code bit, the cost model of
+    // the trie walk HuffmanCodec::decode used before its lookup tables
+    class BitwiseDecoder
+    {
+    public:
+        explicit BitwiseDecoder(const std::vector<uint8_t> &lengths)
+        {
+            for (uint8_t l : lengths)
+                ++count_[l];
+            count_[0] = 0;
+            int offs[fc::MAX_CODE_BITS + 2] = {};
+            for (int l = 1; l <= fc::MAX_CODE_BITS; ++l)
+                offs[l + 1] = offs[l] + count_[l];
+            symbols_.resize(offs[fc::MAX_CODE_BITS + 1]);
+            for (size_t s = 0; s < lengths.size(); ++s)
+                if (lengths[s])
+                    symbols_[offs[lengths[s]]++] = static_cast<uint16_t>(s);
+        }
+
+        bool decode(fc::BitReader &br, uint16_t &symbol) const
+        {
+            int code = 0, first = 0, index = 0;
+            for (int l = 1; l <= fc::MAX_CODE_BITS; ++l)
+            {
+                uint32_t bit = 0;
+                if (!br.readBits(1, bit))
+                    return false;
+                code |= static_cast<int>(bit);
+                if (code < first + count_[l])
+                {
+                    symbol = symbols_[index + code - first];
+                    return true;
+                }
+                index += count_[l];
+                first = (first + count_[l]) << 1;
+                code <<= 1;
+            }
+            return false;
+        }
+
+    private:
+        int count_[fc::MAX_CODE_BITS + 1] = {};
+        std::vector<uint16_t> symbols_; // by code length, then symbol
+    };
+
+    // --decode: each corpus's bytes as literal symbols under their own Huffman code, decoded
+    // through HuffmanCodec's two-level table and bit by bit
+    int runDecodeBench(const std::vector<Corpus> &corpus, int reps, int warmup)
+    {
+        std::cout << "corpus          symbols  bits/sym  bitwise Msym/s  table Msym/s  speedup\n";
+        for (const Corpus &c : corpus)
+        {
+            const std::string data = joined(c);
+            if (data.empty())
+                continue;
+            std::vector<uint32_t> freqs(256, 0);
+            for (char ch : data)
+                ++freqs[static_cast<uint8_t>(ch)];
+            fc::HuffmanCodec codec;
+            std::vector<uint8_t> lengths;
+            if (!codec.build(freqs) || !fc::HuffmanCodec::codeLengths(freqs, fc::MAX_CODE_BITS, lengths))
+            {
+                std::cerr << "❌ " << c.name << ": 无法构建 Huffman 码\n";
+                return 3;
+            }
+            std::vector<uint8_t> packed;
+            {
+                fc::BitWriter bw(packed);
+                for (char ch : data)
+                    codec.encode(static_cast<uint8_t>(ch), bw);
+                bw.flush();
+            }
+            const BitwiseDecoder bitwise(lengths);
+
+            std::vector<uint8_t> decoded(data.size());
+            bool ok = true;
+            auto run = [&](const auto &decoder)
+            {
+                return medianSeconds(reps, warmup, [&]
+                                     {
+                    fc::BitReader br(packed.data(), packed.size());
+                    for (auto &out : decoded)
+                    {
+                        uint16_t sym = 0;
+                        ok &= decoder.decode(br, sym);
+                        out = static_cast<uint8_t>(sym);
+                    }
+                    ok &= std::memcmp(decoded.data(), data.data(), data.size()) == 0; });
+            };
+            const double bitSec = run(bitwise);
+            const double tableSec = run(codec);
+            if (!ok)
+            {
+                std::cerr << "❌ " << c.name << ": 解码结果与原文不一致\n";
+                return 3;
+            }
+            char line[128];
+            std::snprintf(line, sizeof(line), "%-12s %10zu %9.2f %15.1f %13.1f %8.2f\n", c.name.c_str(), data.size(),
+                          packed.size() * 8.0 / data.size(), data.size() / bitSec / 1e6, data.size() / tableSec / 1e6,
+                          bitSec / tableSec);
+            std::cout << line;
+        }
+        return 0;
+    }
+
+    void printUsage(const char *exe)
+    {
+        std::cerr << "使用方法: " << exe << " [选项]\n"
+                  << "  --size <MB>         每个生成语料的大小 (默认 4)\n"
+                  << "  --corpus <目录>     改用目录中的文件作为语料 (每个文件一项)\n"
+                  << "  --only <a,b>        只测指定语料 (text,source,binary,random,repetitive,small-files)\n"
+                  << "  --levels <a,b>      匹配策略 (默认 fastest,greedy,lazy,optimal)\n"
+                  << "  --containers <a,b>  容器格式 fc / gzip / indexed (默认 fc,gzip)\n"
+                  << "  --threads <a,b>     压缩/解压线程数 (默认 1)\n"
+                  << "  --reps <N>          计时重复次数, 取中位数 (默认 5)\n"
+                  << "  --warmup <N>        预热次数 (默认 1)\n"
+                  << "  --csv               输出 CSV (默认 JSON)\n"
+                  << "  --out <文件>        写入文件而不是标准输出\n"
+                  << "  --kernels           改为比较各匹配长度内核 (bytewise/word/sse2/avx2), 输出文本表格\n"
+                  << "  --decode            改为比较 Huffman 解码: 两级查找表与逐位解码, 输出文本表格\n"
+                  << "  --finder            改为比较匹配查找器: head/prev 环形链与旧的逐桶 vector 链, 输出文本表格\n";
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    size_t sizeMb = 4;
+    std::string corpusDir, outPath;
+    std::vector<std::string> only;
+    std::vector<std::string> levels = {"fastest", "greedy", "lazy", "optimal"};
+    std::vector<std::string> containers = {"fc", "gzip"};
+    std::vector<std::string> threadList = {"1"};
+    int reps = 5;
+    int warmup = 1;
+    bool csv = false;
+    bool kernels = false;
+    bool decode = false;
+    bool finder = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--size" && hasValue)
+            sizeMb = std::strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--corpus" && hasValue)
+            corpusDir = argv[++i];
+        else if (arg == "--only" && hasValue)
+            only = splitList(argv[++i]);
+        else if (arg == "--levels" && hasValue)
+            levels = splitList(argv[++i]);
+        else if (arg == "--containers" && hasValue)
+            containers = splitList(argv[++i]);
+        else if (arg == "--threads" && hasValue)
+            threadList = splitList(argv[++i]);
+        else if (arg == "--reps" && hasValue)
+            reps = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--warmup" && hasValue)
+            warmup = std::max(0, std::atoi(argv[++i]));
+        else if (arg == "--csv")
+            csv = true;
+        else if (arg == "--out" && hasValue)
+            outPath = argv[++i];
+        else if (arg == "--kernels")
+            kernels = true;
+        else if (arg == "--decode")
+            decode = true;
+        else if (arg == "--finder")
+            finder = true;
+        else
+        {
+            std::cerr << "❌ 错误: 未知的选项 \"" << arg << "\"\n";
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    std::vector<Setting> settings;
+    for (const auto &l : levels)
+    {
+        fc::CompressionLevel level;
+        if (!parseLevel(l, level))
+        {
+            std::cerr << "❌ 错误: 未知的匹配策略 \"" << l << "\"\n";
+            return 1;
+        }
+        for (const auto &f : containers)
+        {
+            fc::ContainerFormat format;
+            if (!parseFormat(f, format))
+            {
+                std::cerr << "❌ 错误: 未知的容器格式 \"" << f << "\"\n";
+                return 1;
+            }
+            for (const auto &t : threadList)
+                settings.push_back({l, f, static_cast<uint32_t>(std::strtoul(t.c_str(), nullptr, 10))});
+        }
+    }
+
+    std::vector<Corpus> corpus;
+    if (!corpusDir.empty())
+    {
+        if (!loadCorpus(corpusDir, corpus) || corpus.empty())
+        {
+            std::cerr << "❌ 错误: 无法读取语料目录 \"" << corpusDir << "\"\n";
+            return 2;
+        }
+    }
+    else
+    {
+        corpus = builtinCorpus(sizeMb * 1000 * 1000);
+    }
+    if (!only.empty())
+    {
+        corpus.erase(std::remove_if(corpus.begin(), corpus.end(), [&](const Corpus &c)
+                                    { return std::find(only.begin(), only.end(), c.name) == only.end(); }),
+                     corpus.end());
+    }
+    if (kernels)
+        return runKernelBench(corpus, reps, warmup);
+    if (decode)
+        return runDecodeBench(corpus, reps, warmup);
+    if (finder)
+        return runFinderBench(corpus, reps, warmup);
+
+    std::vector<Result> results;
+    for (const Corpus &c : corpus)
+    {
+        for (const Setting &s : settings)
+        {
+            fc::DeflateOptions dopt{};
+            parseLevel(s.level, dopt.lz.level);
+            parseFormat(s.format, dopt.format);
+            dopt.threads = s.threads;
+            fc::InflateOptions iopt{};
+            iopt.threads = s.threads;
+
+            std::cerr << c.name << " " << s.level << "/" << s.format << "/t" << s.threads << " ...";
+            std::cerr.flush();
+            resetPeakRss();
+            Result r;
+            r.corpus = c.name;
+            r.files = c.files.size();
+            r.original = c.bytes();
+            r.setting = s;
+            std::vector<double> cSec, dSec;
+            std::string err;
+            for (int k = 0; k < warmup + reps; ++k)
+            {
+                double cs = 0, ds = 0;
+                if (!runPass(c, dopt, iopt, cs, ds, r.compressed, &err))
+                {
+                    std::cerr << "\n❌ " << c.name << " 失败: " << err << "\n";
+                    return 3;
+                }
+                if (k >= warmup)
+                {
+                    cSec.push_back(cs);
+                    dSec.push_back(ds);
+                }
+            }
+            const double mb = r.original / 1e6;
+            r.compressMBps = mb / std::max(1e-9, median(cSec));
+            r.decompressMBps = mb / std::max(1e-9, median(dSec));
+            r.peakRssKb = peakRssKb();
+            std::cerr << " " << static_cast<long>(r.compressMBps) << " / " << static_cast<long>(r.decompressMBps) << " MB/s\n";
+            results.push_back(r);
+        }
+    }
+
+    std::ofstream file;
+    if (!outPath.empty())
+    {
+        file.open(outPath);
+        if (!file)
+        {
+            std::cerr << "❌ 错误: 无法创建输出文件 \"" << outPath << "\"\n";
+            return 2;
+        }
+    }
+    std::ostream &out = outPath.empty() ? std::cout : file;
+    if (csv)
+        writeCsv(out, results);
+    else
+        writeJson(out, results, reps, warmup);
+    return 0;
+}
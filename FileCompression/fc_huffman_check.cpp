@@ -0,0 +1,256 @@
+// fc_huffman_check: randomized check of the length-limited Huffman builder
+//
+// Build (from this directory, all on one line):
+//   g++ -std=c++17 -O2 -o fc_huffman_check fc_huffman_check.cpp bit_io.cpp huffman.cpp
+//
+// Every trial draws a frequency table, builds codes under a length cap and checks that:
+//   - every used symbol gets a code of 1..cap bits and unused symbols none;
+//   - the code is complete (Kraft sum exactly 1; one used symbol gets a single 1-bit code);
+//   - its cost is the unbounded Huffman cost whenever that code already fits the cap,
+//     and never below it otherwise;
+//   - a random message over the used symbols survives encode + decode.
+// Fibonacci frequencies are the worst case for code length (n symbols want n - 1 bits),
+// so they force the package-merge path under every cap; they are also shuffled and
+// scattered over a DEFLATE-sized alphabet. Exits with 3 on the first failure.
+#include <iostream>
+#include <string>
+#include <vector>
+#include <queue>
+#include <functional>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+#include "bench_common.h"
+#include "bit_io.h"
+#include "huffman.h"
+
+namespace
+{
+    using fc::bench::Rng; // a fixed seed replays the same trials
+
+    struct Family
+    {
+        const char *name;
+        std::function<std::vector<uint32_t>(Rng &)> make;
+        size_t trials = 0;
+        size_t limited = 0; // trials where the unbounded code was longer than the cap
+    };
+
+    // fib(1..n): 1, 1, 2, 3, 5, ...; n <= 45 keeps the total inside 32 bits
+    std::vector<uint32_t> fibonacci(size_t n)
+    {
+        std::vector<uint32_t> f(n, 1);
+        for (size_t i = 2; i < n; ++i)
+            f[i] = f[i - 1] + f[i - 2];
+        return f;
+    }
+
+    // Fibonacci frequencies at random symbols of a larger alphabet, the rest unused
+    std::vector<uint32_t> scatter(const std::vector<uint32_t> &freqs, size_t alphabet, Rng &rng)
+    {
+        std::vector<size_t> slots(alphabet);
+        for (size_t i = 0; i < alphabet; ++i)
+            slots[i] = i;
+        for (size_t i = alphabet - 1; i > 0; --i)
+            std::swap(slots[i], slots[rng.below(static_cast<uint32_t>(i + 1))]);
+        std::vector<uint32_t> out(alphabet, 0);
+        for (size_t i = 0; i < freqs.size(); ++i)
+            out[slots[i]] = freqs[i];
+        return out;
+    }
+
+    // Total bits of an optimal unbounded prefix code, and its longest code
+    uint64_t unboundedCost(const std::vector<uint32_t> &freqs, int &maxLen)
+    {
+        struct Node
+        {
+            uint64_t weight;
+            int depth;
+            bool operator>(const Node &o) const { return weight != o.weight ? weight > o.weight : depth > o.depth; }
+        };
+        std::priority_queue<Node, std::vector<Node>, std::greater<Node>> heap;
+        for (uint32_t f : freqs)
+            if (f != 0)
+                heap.push({f, 0});
+        maxLen = heap.size() == 1 ? 1 : 0;
+        if (heap.size() == 1)
+            return heap.top().weight;
+        uint64_t cost = 0;
+        while (heap.size() > 1)
+        {
+            Node a = heap.top();
+            heap.pop();
+            Node b = heap.top();
+            heap.pop();
+            cost += a.weight + b.weight; // every merge adds one bit to each symbol below it
+            heap.push({a.weight + b.weight, std::max(a.depth, b.depth) + 1});
+        }
+        maxLen = heap.top().depth;
+        return cost;
+    }
+
+    bool checkOne(const std::vector<uint32_t> &freqs, int cap, Rng &rng, bool &limited, std::string &why)
+    {
+        std::vector<uint8_t> lens;
+        size_t used = 0;
+        for (uint32_t f : freqs)
+            used += f != 0;
+        if (!fc::HuffmanCodec::codeLengths(freqs, cap, lens))
+        {
+            // Only legitimate when 2^cap cannot give every used symbol a code
+            if (used > (size_t(1) << cap))
+                return true;
+            why = "codeLengths failed";
+            return false;
+        }
+
+        uint64_t kraft = 0, cost = 0; // Kraft sum in units of 2^-cap
+        for (size_t s = 0; s < freqs.size(); ++s)
+        {
+            if ((freqs[s] == 0) != (lens[s] == 0) || lens[s] > cap)
+            {
+                why = "symbol " + std::to_string(s) + " has length " + std::to_string(lens[s]);
+                return false;
+            }
+            if (lens[s])
+            {
+                kraft += uint64_t(1) << (cap - lens[s]);
+                cost += uint64_t(freqs[s]) * lens[s];
+            }
+        }
+        const uint64_t full = uint64_t(1) << cap;
+        if (used == 1 ? kraft != full / 2 : kraft != full)
+        {
+            why = "Kraft sum " + std::to_string(kraft) + " / " + std::to_string(full);
+            return false;
+        }
+
+        int freeLen = 0;
+        const uint64_t freeCost = unboundedCost(freqs, freeLen);
+        limited = freeLen > cap;
+        if (limited ? cost < freeCost : cost != freeCost)
+        {
+            why = "cost " + std::to_string(cost) + " against unbounded " + std::to_string(freeCost);
+            return false;
+        }
+
+        // Round trip a message over the used symbols through the built tables
+        fc::HuffmanCodec codec;
+        if (!codec.buildFromLengths(lens))
+        {
+            why = "buildFromLengths rejected the lengths";
+            return false;
+        }
+        std::vector<uint16_t> symbols, message(512);
+        for (size_t s = 0; s < freqs.size(); ++s)
+            if (freqs[s])
+                symbols.push_back(static_cast<uint16_t>(s));
+        for (auto &m : message)
+            m = symbols[rng.below(static_cast<uint32_t>(symbols.size()))];
+        std::vector<uint8_t> bytes;
+        {
+            fc::BitWriter bw(bytes);
+            for (uint16_t m : message)
+                codec.encode(m, bw);
+            bw.flush();
+        }
+        fc::BitReader br(bytes.data(), bytes.size());
+        for (uint16_t m : message)
+        {
+            uint16_t got = 0;
+            if (!codec.decode(br, got) || got != m)
+            {
+                why = "decoded " + std::to_string(got) + " for symbol " + std::to_string(m);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void printUsage(const char *exe)
+    {
+        std::cerr << "使用方法: " << exe << " [选项]\n"
+                  << "  --trials <N>  每类分布的试验次数 (默认 2000)\n"
+                  << "  --seed <N>    随机种子 (默认 1)\n";
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    size_t trials = 2000;
+    uint64_t seed = 1;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--trials" && hasValue)
+            trials = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--seed" && hasValue)
+            seed = std::strtoull(argv[++i], nullptr, 10);
+        else
+        {
+            std::cerr << "❌ 错误: 未知的选项 \"" << arg << "\"\n";
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    std::vector<Family> families = {
+        {"fibonacci", [](Rng &rng)
+         { return fibonacci(2 + rng.below(44)); }},
+        {"fib-scattered", [](Rng &rng)
+         { return scatter(fibonacci(2 + rng.below(44)), fc::LL_ALPHABET_SIZE, rng); }},
+        {"powers-of-2", [](Rng &rng)
+         {
+             std::vector<uint32_t> f(2 + rng.below(31));
+             for (size_t i = 0; i < f.size(); ++i)
+                 f[i] = 1u << (i % 32);
+             return f;
+         }},
+        {"random", [](Rng &rng)
+         {
+             std::vector<uint32_t> f(2 + rng.below(299));
+             for (auto &v : f)
+                 v = rng.below(4) == 0 ? 0 : 1 + rng.below(1u << rng.below(20));
+             if (std::all_of(f.begin(), f.end(), [](uint32_t v)
+                             { return v == 0; }))
+                 f[0] = 1;
+             return f;
+         }},
+        {"skewed", [](Rng &rng)
+         {
+             // A few huge counts over a long tail of ones, as in literal-heavy blocks
+             std::vector<uint32_t> f(fc::LL_ALPHABET_SIZE, 1);
+             for (int i = 0; i < 8; ++i)
+                 f[rng.below(static_cast<uint32_t>(f.size()))] = 1u << (20 + rng.below(10));
+             return f;
+         }},
+    };
+
+    Rng rng(seed);
+    std::cout << "family          trials  over-cap  result\n";
+    for (Family &fam : families)
+    {
+        for (size_t t = 0; t < trials; ++t)
+        {
+            const std::vector<uint32_t> freqs = fam.make(rng);
+            const int cap = (t % 3 == 0) ? fc::MAX_CODE_BITS : static_cast<int>(1 + rng.below(fc::MAX_CODE_BITS));
+            bool limited = false;
+            std::string why;
+            if (!checkOne(freqs, cap, rng, limited, why))
+            {
+                std::cerr << "❌ 失败: " << fam.name << " 第 " << t << " 次, " << freqs.size() << " 个符号, 上限 "
+                          << cap << " 位: " << why << "\n";
+                return 3;
+            }
+            ++fam.trials;
+            fam.limited += limited;
+        }
+        char line[96];
+        std::snprintf(line, sizeof(line), "%-14s %7zu %9zu  ok\n", fam.name, fam.trials, fam.limited);
+        std::cout << line;
+    }
+    return 0;
+}
@@ -0,0 +1,249 @@
+// fc_io_bench: file throughput over a directory, std::ifstream/ofstream against the
+// AsyncFileReader / AsyncFileWriter backends (worker threads, io_uring)
+//
+// Build (from this directory, all on one line):
+//   g++ -std=c++17 -O2 -pthread -o fc_io_bench fc_io_bench.cpp async_io.cpp bit_io.cpp
+//       checksum.cpp deflate.cpp dictionary.cpp huffman.cpp inflate.cpp lz77.cpp match_length.cpp
+//
+// Every regular file under the directory is processed one after another, as a batch
+// job running the CLI per file would: "copy" streams it to the output directory with
+// no codec (the I/O path alone), "zip" compresses it, "unzip" restores the zip output.
+// Figures are decimal MB of original data per second, the best of the repetitions.
+// Repeat runs read from the page cache; to measure the device, point --out at it and
+// drop caches (echo 3 > /proc/sys/vm/drop_caches) between runs.
+#include <iostream>
+#include <fstream>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+
+#include "async_io.h"
+#include "bench_common.h"
+#include "deflate.h"
+#include "inflate.h"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    using fc::bench::parseLevel;
+
+    struct Backend
+    {
+        const char *name;
+        bool async;
+        fc::IoBackend io;
+    };
+
+    // Open inPath / outPath as streams through backend b and run fn(in, out)
+    template <typename Fn>
+    bool withStreams(const Backend &b, const fc::AsyncIoOptions &aio, const std::string &inPath, const std::string &outPath,
+                     Fn fn, std::string &err)
+    {
+        if (!b.async)
+        {
+            std::ifstream in(inPath, std::ios::binary);
+            std::ofstream out(outPath, std::ios::binary | std::ios::trunc);
+            if (!in || !out)
+            {
+                err = "cannot open " + inPath + " or " + outPath;
+                return false;
+            }
+            bool ok = fn(in, out);
+            out.close();
+            return ok && !out.fail();
+        }
+
+        fc::AsyncIoOptions opt = aio;
+        opt.backend = b.io;
+        fc::AsyncFileReader reader;
+        fc::AsyncFileWriter writer;
+        if (!reader.open(inPath, opt, &err) || !writer.open(outPath, opt, &err))
+            return false;
+        std::istream in(&reader);
+        std::ostream out(&writer);
+        bool ok = fn(in, out) && reader.error().empty();
+        return writer.close(&err) && ok;
+    }
+
+    bool copyStream(std::istream &in, std::ostream &out)
+    {
+        std::vector<char> buf(64 * 1024);
+        while (in)
+        {
+            in.read(buf.data(), static_cast<std::streamsize>(buf.size()));
+            out.write(buf.data(), in.gcount());
+        }
+        return in.eof() && static_cast<bool>(out);
+    }
+
+    bool sameFile(const std::string &a, const std::string &b)
+    {
+        std::ifstream fa(a, std::ios::binary), fb(b, std::ios::binary);
+        std::vector<char> ba(64 * 1024), bb(64 * 1024);
+        while (fa && fb)
+        {
+            fa.read(ba.data(), static_cast<std::streamsize>(ba.size()));
+            fb.read(bb.data(), static_cast<std::streamsize>(bb.size()));
+            if (fa.gcount() != fb.gcount() || !std::equal(ba.begin(), ba.begin() + fa.gcount(), bb.begin()))
+                return false;
+        }
+        return fa.eof() && fb.eof();
+    }
+
+    void printUsage(const char *exe)
+    {
+        std::cerr << "使用方法: " << exe << " [选项] [目录]\n"
+                  << "  --out <目录>    输出目录 (默认系统临时目录下的 fc_io_bench_out)\n"
+                  << "  --files <N>     未给出目录时生成的文件数 (默认 32)\n"
+                  << "  --size <字节>   生成文件的大小 (默认 1048576)\n"
+                  << "  --chunk <字节>  异步读写的请求大小 (默认 262144)\n"
+                  << "  --depth <N>     每个文件同时在途的请求数 (默认 4)\n"
+                  << "  --level <名称>  匹配策略 fastest / greedy / lazy / optimal (默认 fastest)\n"
+                  << "  --repeat <N>    重复次数, 取最好的一次 (默认 3)\n";
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    std::string dir;
+    fs::path outDir = fs::temp_directory_path() / "fc_io_bench_out";
+    size_t files = 32;
+    size_t size = 1024 * 1024;
+    int repeat = 3;
+    fc::AsyncIoOptions aio{};
+    fc::DeflateOptions dopt{};
+    dopt.lz.level = fc::CompressionLevel::Fastest;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--out" && hasValue)
+            outDir = argv[++i];
+        else if (arg == "--files" && hasValue)
+            files = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--size" && hasValue)
+            size = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--chunk" && hasValue)
+            aio.chunkSize = std::max<size_t>(1, std::strtoull(argv[++i], nullptr, 10));
+        else if (arg == "--depth" && hasValue)
+            aio.depth = static_cast<unsigned>(std::max(1, std::atoi(argv[++i])));
+        else if (arg == "--level" && hasValue)
+        {
+            if (!parseLevel(argv[++i], dopt.lz.level))
+            {
+                std::cerr << "❌ 错误: 未知的匹配策略 \"" << argv[i] << "\"\n";
+                return 1;
+            }
+        }
+        else if (arg == "--repeat" && hasValue)
+            repeat = std::max(1, std::atoi(argv[++i]));
+        else if (!arg.empty() && arg[0] != '-' && dir.empty())
+            dir = arg;
+        else
+        {
+            std::cerr << "❌ 错误: 未知的选项 \"" << arg << "\"\n";
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    std::error_code ec;
+    if (dir.empty())
+    {
+        fs::path gen = fs::temp_directory_path() / "fc_io_bench_src";
+        fs::remove_all(gen, ec); // files left by a run with other --files / --size
+        fs::create_directories(gen, ec);
+        for (size_t i = 0; i < files; ++i)
+        {
+            std::ofstream f(gen / ("file" + std::to_string(i) + ".txt"), std::ios::binary | std::ios::trunc);
+            const std::string data = fc::bench::makeText(size, 0x9E3779B97F4A7C15ull + i);
+            f.write(data.data(), static_cast<std::streamsize>(data.size()));
+        }
+        dir = gen.string();
+    }
+
+    std::vector<std::string> inputs;
+    uint64_t totalBytes = 0;
+    for (const auto &entry : fs::recursive_directory_iterator(dir, ec))
+    {
+        if (entry.is_regular_file(ec))
+        {
+            inputs.push_back(entry.path().string());
+            totalBytes += entry.file_size(ec);
+        }
+    }
+    std::sort(inputs.begin(), inputs.end());
+    fs::create_directories(outDir, ec);
+    if (inputs.empty() || !fs::is_directory(outDir))
+    {
+        std::cerr << "❌ 错误: \"" << dir << "\" 下没有文件, 或无法创建 \"" << outDir.string() << "\"\n";
+        return 1;
+    }
+
+    std::vector<Backend> backends = {{"ifstream", false, fc::IoBackend::Auto}, {"threads", true, fc::IoBackend::Threads}};
+    if (fc::uringAvailable())
+        backends.push_back({"io_uring", true, fc::IoBackend::Uring});
+    else
+        std::cout << "(io_uring 不可用, 跳过)\n";
+
+    std::cout << inputs.size() << " 个文件, " << totalBytes << " 字节; chunk " << aio.chunkSize << ", depth " << aio.depth << "\n";
+    std::cout << "backend       copy MB/s    zip MB/s  unzip MB/s\n";
+    const double mb = static_cast<double>(totalBytes) / 1e6;
+    for (const Backend &b : backends)
+    {
+        double best[3] = {0, 0, 0};
+        std::string err;
+        for (int rep = 0; rep < repeat; ++rep)
+        {
+            for (int op = 0; op < 3; ++op)
+            {
+                const auto t0 = std::chrono::steady_clock::now();
+                for (size_t i = 0; i < inputs.size(); ++i)
+                {
+                    const std::string base = (outDir / ("f" + std::to_string(i))).string();
+                    bool ok = false;
+                    if (op == 0)
+                        ok = withStreams(b, aio, inputs[i], base + ".copy", copyStream, err);
+                    else if (op == 1)
+                        ok = withStreams(b, aio, inputs[i], base + ".fc", [&](std::istream &in, std::ostream &out)
+                                         { return fc::deflateStream(in, out, dopt, &err); }, err);
+                    else
+                        ok = withStreams(b, aio, base + ".fc", base + ".out", [&](std::istream &in, std::ostream &out)
+                                         { return fc::inflateStream(in, out, &err); }, err);
+                    if (!ok)
+                    {
+                        std::cerr << "❌ " << b.name << " 失败: " << inputs[i] << ": " << err << "\n";
+                        return 3;
+                    }
+                }
+                const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+                best[op] = std::max(best[op], mb / std::max(secs, 1e-9));
+            }
+        }
+
+        // Every backend must reproduce the inputs, so a broken path cannot post good numbers
+        for (size_t i = 0; i < inputs.size(); ++i)
+        {
+            const std::string base = (outDir / ("f" + std::to_string(i))).string();
+            if (!sameFile(inputs[i], base + ".copy") || !sameFile(inputs[i], base + ".out"))
+            {
+                std::cerr << "❌ " << b.name << ": " << inputs[i] << " 的输出不一致\n";
+                return 3;
+            }
+        }
+        char line[160];
+        std::snprintf(line, sizeof(line), "%-10s %12.1f %11.1f %11.1f\n", b.name, best[0], best[1], best[2]);
+        std::cout << line;
+    }
+    return 0;
+}
@@ -0,0 +1,180 @@
+// fc_token_bench: memory per input byte of the LZ77 token stream, TokenBuffer against
+// the std::vector<Token> it replaced, and the cost of walking each
+//
+// Build (from this directory, all on one line):
+//   g++ -std=c++17 -O2 -o fc_token_bench fc_token_bench.cpp bit_io.cpp huffman.cpp lz77.cpp match_length.cpp
+//
+// Inputs are tokenized in blocks of --block bytes, as deflate does, each block with the
+// ones before it as history. Memory is what one block's tokens occupy (std::vector
+// counts sizeof(Token) per token, TokenBuffer its packed bytes), divided by the block's
+// input size; "peak" is the largest block. The walk time is one pass over every token
+// gathering symbol counts, the work planBlocks does before any Huffman coding.
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+
+#include "bench_common.h"
+#include "huffman.h"
+#include "lz77.h"
+
+namespace
+{
+    using fc::bench::levelName;
+    using fc::bench::parseLevel;
+
+    std::vector<uint8_t> bytes(const std::string &s)
+    {
+        return std::vector<uint8_t>(s.begin(), s.end());
+    }
+
+    struct Input
+    {
+        std::string name;
+        std::vector<uint8_t> data;
+    };
+
+    // Symbol counts as planBlocks gathers them; the sum keeps the walk from being optimized out
+    struct Histogram
+    {
+        uint32_t ll[fc::LL_ALPHABET_SIZE] = {};
+        uint32_t dist[fc::DIST_ALPHABET_SIZE] = {};
+        uint64_t raw = 0;
+
+        void add(const fc::Token &t)
+        {
+            if (t.kind == fc::TokenKind::Literal)
+            {
+                ++ll[t.literal];
+                raw += 1;
+            }
+            else
+            {
+                ++ll[fc::FIRST_LENGTH_SYMBOL + fc::lengthCode(t.length)];
+                ++dist[fc::distCode(t.distance)];
+                raw += t.length;
+            }
+        }
+    };
+
+    template <typename Tokens>
+    double walkMicros(const Tokens &tokens, uint64_t &raw)
+    {
+        Histogram h;
+        const auto t0 = std::chrono::steady_clock::now();
+        for (const auto &t : tokens)
+            h.add(t);
+        const auto t1 = std::chrono::steady_clock::now();
+        raw += h.raw;
+        return std::chrono::duration<double, std::micro>(t1 - t0).count();
+    }
+
+    void printUsage(const char *exe)
+    {
+        std::cerr << "使用方法: " << exe << " [选项] [文件...]\n"
+                  << "  --size <字节>   生成输入的大小 (默认 4194304); 给出文件时不生成\n"
+                  << "  --block <字节>  每块输入字节数 (默认 1048576)\n"
+                  << "  --level <名称>  只测该匹配策略 fastest / greedy / lazy / optimal (默认前三种)\n";
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    size_t size = 4 * 1024 * 1024;
+    size_t blockSize = 1024 * 1024;
+    std::vector<fc::CompressionLevel> levels = {fc::CompressionLevel::Fastest, fc::CompressionLevel::Greedy,
+                                                fc::CompressionLevel::Lazy};
+    std::vector<Input> inputs;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--size" && hasValue)
+            size = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--block" && hasValue)
+            blockSize = std::max<size_t>(1, std::strtoull(argv[++i], nullptr, 10));
+        else if (arg == "--level" && hasValue)
+        {
+            levels.assign(1, fc::CompressionLevel::Greedy);
+            if (!parseLevel(argv[++i], levels[0]))
+            {
+                std::cerr << "❌ 错误: 未知的匹配策略 \"" << argv[i] << "\"\n";
+                return 1;
+            }
+        }
+        else if (!arg.empty() && arg[0] == '-')
+        {
+            std::cerr << "❌ 错误: 未知的选项 \"" << arg << "\"\n";
+            printUsage(argv[0]);
+            return 1;
+        }
+        else
+        {
+            std::ifstream in(arg, std::ios::binary);
+            if (!in)
+            {
+                std::cerr << "❌ 错误: 无法打开输入文件 \"" << arg << "\"\n";
+                return 1;
+            }
+            inputs.push_back({std::filesystem::path(arg).filename().string(), std::vector<uint8_t>(std::istreambuf_iterator<char>(in), {})});
+        }
+    }
+    if (inputs.empty())
+    {
+        inputs.push_back({"text", bytes(fc::bench::makeText(size, 1))});
+        inputs.push_back({"random", bytes(fc::bench::makeRandom(size, 2))});
+        inputs.push_back({"repetitive", bytes(fc::bench::makeRepetitive(size, 3))});
+    }
+
+    std::cout << "input        level     tokens/B   vector B/B  buffer B/B   peak B/B   walk vec us  walk buf us\n";
+    for (const Input &input : inputs)
+    {
+        for (fc::CompressionLevel level : levels)
+        {
+            fc::LZ77Options opt;
+            opt.level = level;
+            fc::LZ77Encoder lz77(opt);
+            fc::TokenBuffer tokens;
+            std::vector<fc::Token> unpacked;
+            size_t tokenCount = 0, packedBytes = 0;
+            double peak = 0, vecMicros = 0, bufMicros = 0;
+            uint64_t rawVec = 0, rawBuf = 0;
+            const uint8_t *data = input.data.data();
+            for (size_t pos = 0; pos < input.data.size(); pos += blockSize)
+            {
+                const size_t n = std::min(blockSize, input.data.size() - pos);
+                tokens.clear();
+                lz77.encodeBlock(data, pos, pos + n, tokens);
+                unpacked.clear();
+                for (const fc::Token &t : tokens)
+                    unpacked.push_back(t);
+                tokenCount += tokens.size();
+                packedBytes += tokens.byteSize();
+                peak = std::max(peak, static_cast<double>(tokens.byteSize()) / static_cast<double>(n));
+                vecMicros += walkMicros(unpacked, rawVec);
+                bufMicros += walkMicros(tokens, rawBuf);
+            }
+            if (rawVec != input.data.size() || rawBuf != input.data.size())
+            {
+                std::cerr << "❌ 失败: " << input.name << " 的记号没有覆盖全部输入\n";
+                return 3;
+            }
+
+            const double total = static_cast<double>(std::max<size_t>(input.data.size(), 1));
+            char line[200];
+            std::snprintf(line, sizeof(line), "%-12s %-8s %9.3f %12.3f %11.3f %10.3f %13.0f %12.0f\n",
+                          input.name.substr(0, 12).c_str(), levelName(level), tokenCount / total,
+                          tokenCount * sizeof(fc::Token) / total, packedBytes / total, peak, vecMicros, bufMicros);
+            std::cout << line;
+        }
+    }
+    return 0;
+}
@@ -1,34 +1,64 @@
 #include "huffman.h"
 #include "bit_io.h"
-#include <queue>
 #include <algorithm>
+#include <array>
+#include <cassert>
 #include <cstdint>
 
 namespace fc
 {
+    const uint16_t LENGTH_BASE[LENGTH_CODES] = {
+        3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+        35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+    const uint8_t LENGTH_EXTRA[LENGTH_CODES] = {
+        0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+        3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+    const uint16_t DIST_BASE[DIST_ALPHABET_SIZE] = {
+        1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+        257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+    const uint8_t DIST_EXTRA[DIST_ALPHABET_SIZE] = {
+        0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+        7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
     namespace
     {
-        struct BuildNode
+        // Direct lookup tables: length 0-258, and distance split zlib-style into
+        // d-1 < 256 and (d-1) >> 7 for the rest
+        struct CodeLookup
         {
-            uint64_t freq = 0;
-            int left = -1;
-            int right = -1;
-            int symbol = -1; // >=0 for leaf
-        };
+            uint8_t length[259] = {};
+            uint8_t distLow[256] = {};
+            uint8_t distHigh[256] = {};
 
-        struct HeapItem
-        {
-            uint64_t freq;
-            int index;
-            int tie; // deterministic ordering
-            bool operator<(const HeapItem &o) const
+            CodeLookup()
             {
-                if (freq != o.freq)
-                    return freq > o.freq; // min-heap by freq
-                return tie > o.tie;       // smaller tie first
+                for (uint16_t c = 0; c < LENGTH_CODES; ++c)
+                {
+                    uint16_t top = (c + 1u < LENGTH_CODES) ? LENGTH_BASE[c + 1] : 259;
+                    for (uint16_t len = LENGTH_BASE[c]; len < top; ++len)
+                        length[len] = static_cast<uint8_t>(c);
+                }
+                for (uint8_t c = 0; c < DIST_ALPHABET_SIZE; ++c)
+                {
+                    uint32_t lo = DIST_BASE[c] - 1u;
+                    uint32_t hi = lo + (1u << DIST_EXTRA[c]);
+                    for (uint32_t d = lo; d < hi; ++d)
+                    {
+                        if (d < 256)
+                            distLow[d] = c;
+                        else
+                            distHigh[d >> 7] = c;
+                    }
+                }
             }
         };
 
+        const CodeLookup &codeLookup()
+        {
+            static const CodeLookup table;
+            return table;
+        }
+
         static inline uint32_t reverseBits(uint32_t v, int bits)
         {
             uint32_t r = 0;
@@ -40,88 +70,268 @@ namespace fc
         }
     }
 
-    bool HuffmanCodec::build(const std::vector<uint32_t> &freqs)
+    uint16_t lengthCode(uint16_t length)
     {
-        if (freqs.empty())
-            return false;
-        int nonZeroCount = 0;
-        for (auto f : freqs)
-            if (f)
-                ++nonZeroCount;
-        if (nonZeroCount == 0)
-            return false;
+        assert(length >= 3 && length <= 258);
+        return codeLookup().length[length];
+    }
+
+    uint16_t distCode(uint32_t distance)
+    {
+        assert(distance >= 1 && distance <= 32768);
+        uint32_t d = distance - 1u;
+        return (d < 256) ? codeLookup().distLow[d] : codeLookup().distHigh[d >> 7];
+    }
 
-        std::vector<uint16_t> codeLen(freqs.size(), 0);
-        if (nonZeroCount == 1)
+    namespace
+    {
+        // Working array on the stack for DEFLATE-sized alphabets, on the heap beyond that,
+        // so building codes for a block does not allocate
+        template <typename T>
+        class Scratch
         {
-            for (size_t s = 0; s < freqs.size(); ++s)
+        public:
+            static constexpr size_t INLINE = 320; // >= 288 LL symbols, 286 + 30 lengths
+
+            explicit Scratch(size_t n)
             {
+                if (n > INLINE)
+                    heap_.resize(n);
+                data_ = (n > INLINE) ? heap_.data() : inline_.data();
+            }
+            T *data() { return data_; }
+            T &operator[](size_t i) { return data_[i]; }
+
+        private:
+            std::array<T, INLINE> inline_;
+            std::vector<T> heap_;
+            T *data_ = nullptr;
+        };
+
+        // Unbounded Huffman code lengths for the non-zero freqs
+        void computeCodeLengths(const uint32_t *freqs, size_t count, int nonZeroCount, std::vector<uint8_t> &codeLen)
+        {
+            codeLen.assign(count, 0);
+            if (nonZeroCount == 1)
+            {
+                for (size_t s = 0; s < count; ++s)
+                {
+                    if (freqs[s] != 0)
+                    {
+                        codeLen[s] = 1; // single-symbol code length = 1
+                        break;
+                    }
+                }
+                return;
+            }
+
+            // Moffat-Katajainen in-place minimum-redundancy lengths over the weights sorted
+            // ascending: no tree nodes and no heap, which matters when the encoder sizes many
+            // candidate blocks
+            struct Leaf
+            {
+                uint64_t weight;
+                uint16_t symbol;
+            };
+            const int n = nonZeroCount;
+            Scratch<Leaf> leaves(static_cast<size_t>(n));
+            for (size_t s = 0, i = 0; s < count; ++s)
                 if (freqs[s] != 0)
+                    leaves[i++] = {freqs[s], static_cast<uint16_t>(s)};
+            std::sort(leaves.data(), leaves.data() + n, [](const Leaf &x, const Leaf &y)
+                      { return (x.weight != y.weight) ? (x.weight < y.weight) : (x.symbol < y.symbol); });
+
+            Scratch<uint64_t> a(static_cast<size_t>(n));
+            for (int i = 0; i < n; ++i)
+                a[i] = leaves[i].weight;
+
+            // Pass 1, left to right: combine pairs, leaving parent links in the internal slots
+            a[0] += a[1];
+            int root = 0;
+            int leaf = 2;
+            for (int next = 1; next < n - 1; ++next)
+            {
+                if (leaf >= n || a[root] < a[leaf])
+                {
+                    a[next] = a[root];
+                    a[root++] = static_cast<uint64_t>(next);
+                }
+                else
+                {
+                    a[next] = a[leaf++];
+                }
+                if (leaf >= n || (root < next && a[root] < a[leaf]))
+                {
+                    a[next] += a[root];
+                    a[root++] = static_cast<uint64_t>(next);
+                }
+                else
                 {
-                    codeLen[s] = 1; // single-symbol code length = 1
-                    break;
+                    a[next] += a[leaf++];
                 }
             }
+
+            // Pass 2, right to left: parent links become internal node depths
+            a[n - 2] = 0;
+            for (int next = n - 3; next >= 0; --next)
+                a[next] = a[a[next]] + 1;
+
+            // Pass 3, right to left: leaf depths from the number of internal nodes per level
+            int avail = 1;
+            int used = 0;
+            uint64_t depth = 0;
+            root = n - 2;
+            int next = n - 1;
+            while (avail > 0)
+            {
+                while (root >= 0 && a[root] == depth)
+                {
+                    ++used;
+                    --root;
+                }
+                while (avail > used)
+                {
+                    a[next--] = depth;
+                    --avail;
+                }
+                avail = 2 * used;
+                ++depth;
+                used = 0;
+            }
+
+            for (int i = 0; i < n; ++i)
+                codeLen[leaves[i].symbol] = static_cast<uint8_t>(std::min<uint64_t>(a[i], 255));
         }
-        else
+
+        // Package-merge (Larmore & Hirschberg): optimal code lengths with none above maxBits.
+        // Level 0 holds the leaves sorted by weight; each further level merges the leaves
+        // with adjacent pairs ("packages") of the level below. A leaf's code length is the
+        // number of times it occurs among the cheapest 2n-2 items of the top level.
+        // Requires 2 <= n <= 2^maxBits. Only runs when the plain lengths exceed the cap.
+        void packageMerge(const uint32_t *freqs, size_t count, int maxBits, std::vector<uint8_t> &codeLen)
         {
-            // Build Huffman tree
-            std::vector<BuildNode> nodes;
-            nodes.reserve(freqs.size() * 2);
-            std::priority_queue<HeapItem> pq;
-            int tieCounter = 0;
-            for (size_t s = 0; s < freqs.size(); ++s)
+            struct Item
             {
-                if (freqs[s] == 0)
-                    continue;
-                BuildNode leaf;
-                leaf.freq = freqs[s];
-                leaf.symbol = static_cast<int>(s);
-                nodes.push_back(leaf);
-                int idx = static_cast<int>(nodes.size() - 1);
-                pq.push(HeapItem{leaf.freq, idx, static_cast<int>(s)});
-            }
-            while (pq.size() > 1)
+                uint64_t weight;
+                int32_t a; // leaf: symbol; package: first child in the level below
+                int32_t b; // -1 for a leaf; package: second child
+            };
+            std::vector<Item> leaves;
+            for (size_t s = 0; s < count; ++s)
+                if (freqs[s] != 0)
+                    leaves.push_back({freqs[s], static_cast<int32_t>(s), -1});
+            std::stable_sort(leaves.begin(), leaves.end(), [](const Item &x, const Item &y)
+                             { return x.weight < y.weight; });
+
+            const size_t n = leaves.size();
+            std::vector<std::vector<Item>> levels(static_cast<size_t>(maxBits));
+            levels[0] = leaves;
+            for (size_t l = 1; l < levels.size(); ++l)
             {
-                HeapItem a = pq.top();
-                pq.pop();
-                HeapItem b = pq.top();
-                pq.pop();
-                BuildNode parent;
-                parent.freq = a.freq + b.freq;
-                parent.left = a.index;
-                parent.right = b.index;
-                nodes.push_back(parent);
-                int pidx = static_cast<int>(nodes.size() - 1);
-                pq.push(HeapItem{parent.freq, pidx, ++tieCounter});
+                const std::vector<Item> &below = levels[l - 1];
+                std::vector<Item> &cur = levels[l];
+                cur.reserve(n + below.size() / 2);
+                size_t li = 0;
+                size_t pi = 0;
+                while (li < n || pi + 1 < below.size())
+                {
+                    bool takePackage = pi + 1 < below.size() &&
+                                       (li == n || below[pi].weight + below[pi + 1].weight < leaves[li].weight);
+                    if (takePackage)
+                    {
+                        cur.push_back({below[pi].weight + below[pi + 1].weight,
+                                       static_cast<int32_t>(pi), static_cast<int32_t>(pi + 1)});
+                        pi += 2;
+                    }
+                    else
+                    {
+                        cur.push_back(leaves[li++]);
+                    }
+                }
             }
-            int root = pq.top().index;
 
-            struct Item
+            codeLen.assign(count, 0);
+            struct Pos
             {
-                int idx;
-                int depth;
+                size_t level;
+                int32_t idx;
             };
-            std::vector<Item> st;
-            st.push_back({root, 0});
+            std::vector<Pos> st;
+            for (size_t i = 0; i < 2 * n - 2; ++i)
+                st.push_back({levels.size() - 1, static_cast<int32_t>(i)});
             while (!st.empty())
             {
-                Item cur = st.back();
+                Pos p = st.back();
                 st.pop_back();
-                const BuildNode &n = nodes[cur.idx];
-                if (n.symbol >= 0)
+                const Item &it = levels[p.level][static_cast<size_t>(p.idx)];
+                if (it.b < 0)
                 {
-                    codeLen[static_cast<size_t>(n.symbol)] = static_cast<uint16_t>(cur.depth == 0 ? 1 : cur.depth);
+                    ++codeLen[static_cast<size_t>(it.a)];
                 }
                 else
                 {
-                    if (n.left >= 0)
-                        st.push_back({n.left, cur.depth + 1});
-                    if (n.right >= 0)
-                        st.push_back({n.right, cur.depth + 1});
+                    st.push_back({p.level - 1, it.a});
+                    st.push_back({p.level - 1, it.b});
                 }
             }
         }
+    }
+
+    bool HuffmanCodec::build(const std::vector<uint32_t> &freqs, int maxBits)
+    {
+        std::vector<uint8_t> codeLen;
+        return codeLengths(freqs, maxBits, codeLen) && buildFromLengths(codeLen);
+    }
+
+    bool HuffmanCodec::codeLengths(const std::vector<uint32_t> &freqs, int maxBits, std::vector<uint8_t> &lengths)
+    {
+        return codeLengths(freqs.data(), freqs.size(), maxBits, lengths);
+    }
+
+    bool HuffmanCodec::codeLengths(const uint32_t *freqs, size_t count, int maxBits, std::vector<uint8_t> &lengths)
+    {
+        if (count == 0 || maxBits < 1 || maxBits > MAX_CODE_BITS)
+            return false;
+        int nonZeroCount = 0;
+        for (size_t s = 0; s < count; ++s)
+            if (freqs[s])
+                ++nonZeroCount;
+        if (nonZeroCount == 0 || nonZeroCount > (1 << maxBits))
+            return false;
+
+        computeCodeLengths(freqs, count, nonZeroCount, lengths);
+
+        // Over the limit: redo with package-merge, which is optimal under the cap
+        if (*std::max_element(lengths.begin(), lengths.end()) > maxBits)
+            packageMerge(freqs, count, maxBits, lengths);
+        return true;
+    }
+
+    bool HuffmanCodec::buildFromLengths(const std::vector<uint8_t> &lengths)
+    {
+        return buildFromLengths(lengths.data(), lengths.size());
+    }
+
+    bool HuffmanCodec::buildFromLengths(const uint8_t *lengths, size_t count)
+    {
+        // Reject over-subscribed length sets (Kraft sum > 1); incomplete sets are allowed
+        // and their unused bit patterns simply fail to decode
+        uint64_t kraft = 0;
+        int nonZeroCount = 0;
+        for (size_t s = 0; s < count; ++s)
+        {
+            const uint8_t len = lengths[s];
+            if (len == 0)
+                continue;
+            if (len > MAX_CODE_BITS)
+                return false;
+            ++nonZeroCount;
+            kraft += 1ull << (63 - len);
+            if (kraft > (1ull << 63))
+                return false;
+        }
+        if (nonZeroCount == 0)
+            return false;
 
         // Canonical assignment
         struct SymLen
@@ -129,19 +339,19 @@ namespace fc
             uint16_t sym;
             uint16_t len;
         };
-        std::vector<SymLen> v;
-        v.reserve(freqs.size());
-        for (uint16_t s = 0; s < freqs.size(); ++s)
-            if (codeLen[s] > 0)
-                v.push_back({s, codeLen[s]});
-        std::sort(v.begin(), v.end(), [](const SymLen &a, const SymLen &b)
+        Scratch<SymLen> v(static_cast<size_t>(nonZeroCount));
+        for (size_t s = 0, i = 0; s < count; ++s)
+            if (lengths[s] > 0)
+                v[i++] = {static_cast<uint16_t>(s), lengths[s]};
+        std::sort(v.data(), v.data() + nonZeroCount, [](const SymLen &a, const SymLen &b)
                   { return (a.len != b.len) ? (a.len < b.len) : (a.sym < b.sym); });
 
-        codes_.assign(freqs.size(), Code{});
+        codes_.assign(count, Code{});
         uint32_t code = 0;
         uint16_t prevLen = 0;
-        for (const auto &sl : v)
+        for (int i = 0; i < nonZeroCount; ++i)
         {
+            const SymLen &sl = v[static_cast<size_t>(i)];
             if (sl.len > prevLen)
             {
                 code <<= (sl.len - prevLen);
@@ -155,30 +365,61 @@ namespace fc
             ++code;
         }
 
-        // Build LSB-first decode trie
-        decNodes_.clear();
-        decNodes_.reserve(v.size() * 2 + 1);
-        decNodes_.push_back(DecNode{}); // root 0
-        for (const auto &sl : v)
+        maxLen_ = v[static_cast<size_t>(nonZeroCount - 1)].len;
+        buildDecodeTable(count);
+        return true;
+    }
+
+    void HuffmanCodec::buildDecodeTable(size_t symbolCount)
+    {
+        const uint32_t primarySize = 1u << PRIMARY_BITS;
+        const uint32_t primaryMask = primarySize - 1u;
+        table_.assign(primarySize, DecEntry{});
+
+        // Sub-table width per primary slot: longest code whose low PRIMARY_BITS match it
+        std::array<uint8_t, 1u << PRIMARY_BITS> subBits{};
+        for (size_t s = 0; s < symbolCount; ++s)
         {
-            const Code &c = codes_[sl.sym];
-            int node = 0;
-            for (int i = 0; i < c.bitlen; ++i)
+            const Code &c = codes_[s];
+            if (c.bitlen > PRIMARY_BITS)
             {
-                uint32_t bit = (c.bits >> i) & 1u; // LSB-first traverse
-                int &next = (bit == 0) ? decNodes_[node].left : decNodes_[node].right;
-                if (next == -1)
-                {
-                    next = static_cast<int>(decNodes_.size());
-                    decNodes_.push_back(DecNode{});
-                }
-                node = next;
+                uint8_t &w = subBits[c.bits & primaryMask];
+                w = std::max<uint8_t>(w, static_cast<uint8_t>(c.bitlen - PRIMARY_BITS));
             }
-            decNodes_[node].isLeaf = true;
-            decNodes_[node].symbol = sl.sym;
+        }
+        for (uint32_t i = 0; i < primarySize; ++i)
+        {
+            if (subBits[i] == 0)
+                continue;
+            table_[i].value = static_cast<uint16_t>(table_.size());
+            table_[i].subBits = subBits[i];
+            table_.resize(table_.size() + (size_t(1) << subBits[i]));
         }
 
-        return true;
+        // Replicate each code across every slot whose low bits equal the code
+        for (size_t s = 0; s < symbolCount; ++s)
+        {
+            const Code &c = codes_[s];
+            if (c.bitlen == 0)
+                continue;
+            DecEntry e;
+            e.value = static_cast<uint16_t>(s);
+            e.len = c.bitlen;
+            if (c.bitlen <= PRIMARY_BITS)
+            {
+                for (uint32_t i = c.bits; i < primarySize; i += (1u << c.bitlen))
+                    table_[i] = e;
+            }
+            else
+            {
+                const DecEntry &link = table_[c.bits & primaryMask];
+                uint32_t subSize = 1u << link.subBits;
+                uint32_t high = c.bits >> PRIMARY_BITS;
+                int highLen = c.bitlen - PRIMARY_BITS;
+                for (uint32_t i = high; i < subSize; i += (1u << highLen))
+                    table_[link.value + i] = e;
+            }
+        }
     }
 
     bool HuffmanCodec::encode(uint16_t symbol, BitWriter &bw) const
@@ -192,26 +433,4 @@ namespace fc
         return true;
     }
 
-    bool HuffmanCodec::decode(BitReader &br, uint16_t &symbol) const
-    {
-        if (decNodes_.empty())
-            return false;
-        int node = 0;
-        while (true)
-        {
-            if (decNodes_[node].isLeaf)
-            {
-                symbol = static_cast<uint16_t>(decNodes_[node].symbol);
-                return true;
-            }
-            uint32_t bit = 0;
-            if (!br.readBits(1, bit))
-                return false;
-            int next = (bit == 0) ? decNodes_[node].left : decNodes_[node].right;
-            if (next == -1)
-                return false;
-            node = next;
-        }
-    }
-
 } // namespace fc
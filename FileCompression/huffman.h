@@ -4,6 +4,7 @@
 #include <iosfwd>
 #include <cstddef>
 #include <unordered_map>
+#include "bit_io.h"
 
 namespace fc
 {
@@ -17,35 +18,95 @@ namespace fc
     // In DEFLATE: literal/length alphabet size typically 286 (0-285), distance 30 (0-29)
     constexpr size_t LL_ALPHABET_SIZE = 286;
     constexpr size_t DIST_ALPHABET_SIZE = 30;
+    constexpr uint16_t END_OF_BLOCK = 256;
+    constexpr uint16_t FIRST_LENGTH_SYMBOL = 257;
+    constexpr size_t LENGTH_CODES = 29;
+    // Longest code DEFLATE can carry; build() never exceeds it and buildFromLengths() rejects more
+    constexpr int MAX_CODE_BITS = 15;
 
-    class BitWriter; // fwd
-    class BitReader; // fwd
+    // RFC 1951 3.2.5 base values and extra-bit counts, shared by encoder and decoder.
+    // Length code i is LL symbol FIRST_LENGTH_SYMBOL + i; distance code i is dist symbol i.
+    extern const uint16_t LENGTH_BASE[LENGTH_CODES];
+    extern const uint8_t LENGTH_EXTRA[LENGTH_CODES];
+    extern const uint16_t DIST_BASE[DIST_ALPHABET_SIZE];
+    extern const uint8_t DIST_EXTRA[DIST_ALPHABET_SIZE];
+
+    // Length code (0-28) for a match length in 3-258. The range is only asserted here: the
+    // table has 259 entries, and deflate keeps lengths inside it by rejecting LZ77Options
+    // outside MIN_MATCH_LENGTH..MAX_MATCH_LENGTH before any block is encoded.
+    uint16_t lengthCode(uint16_t length);
+    // Distance code (0-29) for a distance in 1-32768
+    uint16_t distCode(uint32_t distance);
 
     class HuffmanCodec
     {
     public:
         HuffmanCodec() = default;
-        // Build canonical codes from freqs; returns false if all freqs are zero
-        bool build(const std::vector<uint32_t> &freqs);
+        // Build canonical codes from freqs with no code longer than maxBits (1..MAX_CODE_BITS);
+        // returns false if all freqs are zero or 2^maxBits cannot cover the used symbols
+        bool build(const std::vector<uint32_t> &freqs, int maxBits = MAX_CODE_BITS);
+        // The code lengths build() would assign, without building any tables
+        static bool codeLengths(const std::vector<uint32_t> &freqs, int maxBits, std::vector<uint8_t> &lengths);
+        static bool codeLengths(const uint32_t *freqs, size_t count, int maxBits, std::vector<uint8_t> &lengths);
+        // Build canonical codes straight from code lengths (0 = unused symbol);
+        // returns false for an empty or over-subscribed set, or a length above MAX_CODE_BITS.
+        // Rebuilding reuses the tables' memory, so a long-lived codec stops allocating.
+        bool buildFromLengths(const std::vector<uint8_t> &lengths);
+        bool buildFromLengths(const uint8_t *lengths, size_t count);
+        // Drop the codes, keeping the tables' memory; decode() then fails
+        void clear();
         // Encode a symbol using the built table
         bool encode(uint16_t symbol, BitWriter &bw) const;
         // Decode a symbol from bitstream
         bool decode(BitReader &br, uint16_t &symbol) const;
         size_t size() const;
+        uint8_t codeLength(uint16_t symbol) const { return symbol < codes_.size() ? codes_[symbol].bitlen : 0; }
 
     private:
+        void buildDecodeTable(size_t symbolCount);
+
         // Canonical code table: index by symbol
         std::vector<Code> codes_;
-        struct DecNode
+
+        // Two-level decode table: the primary level is indexed by the next PRIMARY_BITS
+        // bits; longer codes continue in a sub-table sized for the longest code sharing
+        // that prefix. One peek + one consume decodes a full symbol. With codes capped at
+        // MAX_CODE_BITS a sub-table is at most 2^(MAX_CODE_BITS - PRIMARY_BITS) entries.
+        static constexpr int PRIMARY_BITS = 10;
+        struct DecEntry
         {
-            int left = -1;
-            int right = -1;
-            int symbol = -1;
-            bool isLeaf = false;
+            uint16_t value = 0;  // symbol, or sub-table offset when subBits > 0
+            uint8_t len = 0;     // code length; 0 marks an unused bit pattern
+            uint8_t subBits = 0; // index width of the linked sub-table
         };
-        std::vector<DecNode> decNodes_; // LSB-first decode trie, root at index 0
+        std::vector<DecEntry> table_;
+        int maxLen_ = 0;
     };
 
     inline size_t HuffmanCodec::size() const { return codes_.size(); }
 
+    // Inline: it runs once per literal, length and distance, so the call would dominate
+    inline bool HuffmanCodec::decode(BitReader &br, uint16_t &symbol) const
+    {
+        if (table_.empty())
+            return false;
+
+        uint32_t bits = br.peekBits(maxLen_);
+        const DecEntry *e = &table_[bits & ((1u << PRIMARY_BITS) - 1u)];
+        if (e->subBits)
+            e = &table_[e->value + ((bits >> PRIMARY_BITS) & ((1u << e->subBits) - 1u))];
+        if (e->len == 0 || e->len > br.bitsAvailable())
+            return false;
+        br.consume(e->len);
+        symbol = static_cast<uint16_t>(e->value);
+        return true;
+    }
+
+    inline void HuffmanCodec::clear()
+    {
+        codes_.clear();
+        table_.clear();
+        maxLen_ = 0;
+    }
+
 } // namespace fc
@@ -1,303 +1,1612 @@
 #include "inflate.h"
+#include "deflate.h"
 #include "bit_io.h"
 #include "huffman.h"
+#include "checksum.h"
+#include "dictionary.h"
 #include <string>
 #include <istream>
 #include <ostream>
 #include <cstdint>
+#include <cstddef>
 #include <vector>
+#include <array>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#ifdef __linux__
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 namespace fc
 {
     namespace
     {
         constexpr uint32_t MAGIC = 0x31304346u; // "FC01" in little-endian
+        constexpr uint64_t UNKNOWN_SIZE = ~0ull;
+        constexpr uint8_t BLOCK_FINAL = 0x01;
+        constexpr uint8_t HEADER_INDEXED = 0x01;
+        constexpr uint8_t HEADER_DICTIONARY = 0x02;
+        constexpr uint32_t INDEX_MAGIC = 0x58494346u; // "FCIX" in little-endian
+        constexpr size_t INDEX_ENTRY_SIZE = 20;
+        constexpr size_t INDEX_FOOTER_SIZE = 16;
+        constexpr size_t HEADER_SIZE = 19; // magic, version, flags, windowSize, originalSize
+        constexpr size_t CHECKSUM_SIZE = 4; // CRC-32 of all the data, after the final block
+        constexpr size_t MAX_HISTORY = 32768;
+        constexpr size_t COPY_SLACK = 8; // overshoot allowed for 8-byte match copies
+        // Most output one compressed byte can yield: a 258-byte match coded in 2 bits
+        constexpr uint64_t MAX_EXPANSION = 1032;
+
+        constexpr uint32_t GZIP_MAGIC = 0x8b1fu; // 1f 8b read LSB-first
+        constexpr uint8_t GZ_FHCRC = 0x02;
+        constexpr uint8_t GZ_FEXTRA = 0x04;
+        constexpr uint8_t GZ_FNAME = 0x08;
+        constexpr uint8_t GZ_FCOMMENT = 0x10;
+        constexpr size_t CL_ALPHABET_SIZE = 19;
+        constexpr uint8_t CL_ORDER[CL_ALPHABET_SIZE] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
 
         struct FileHeader
         {
-            uint16_t version = 1;
+            uint16_t version = FORMAT_VERSION;
+            uint8_t flags = 0;
             uint32_t windowSize = 32768;
             uint64_t originalSize = 0;
-            std::vector<std::pair<uint16_t, uint32_t>> llFreqs;
-            std::vector<std::pair<uint16_t, uint32_t>> distFreqs;
+            uint32_t dictionaryId = 0; // with HEADER_DICTIONARY
+        };
+
+        struct BlockHeader
+        {
+            uint8_t flags = 0;
+            uint32_t rawSize = 0;
+            uint32_t crc = 0;
         };
 
-        // Little-endian read helpers
-        inline bool readU16LE(std::istream &in, uint16_t &v)
+        // Little-endian read helpers (BitReader is LSB-first, so whole bytes arrive in LE order)
+        inline bool readU16LE(BitReader &br, uint16_t &v)
         {
-            unsigned char buf[2];
-            in.read(reinterpret_cast<char *>(buf), 2);
-            if (in.gcount() != 2)
+            uint32_t x = 0;
+            if (!br.readBits(16, x))
                 return false;
-            v = static_cast<uint16_t>(buf[0]) | (static_cast<uint16_t>(buf[1]) << 8);
+            v = static_cast<uint16_t>(x);
             return true;
         }
 
-        inline bool readU32LE(std::istream &in, uint32_t &v)
+        inline bool readU32LE(BitReader &br, uint32_t &v)
         {
-            unsigned char buf[4];
-            in.read(reinterpret_cast<char *>(buf), 4);
-            if (in.gcount() != 4)
-                return false;
-            v = static_cast<uint32_t>(buf[0]) | (static_cast<uint32_t>(buf[1]) << 8) |
-                (static_cast<uint32_t>(buf[2]) << 16) | (static_cast<uint32_t>(buf[3]) << 24);
-            return true;
+            return br.readBits(32, v);
         }
 
-        inline bool readU64LE(std::istream &in, uint64_t &v)
+        inline bool readU64LE(BitReader &br, uint64_t &v)
         {
-            unsigned char buf[8];
-            in.read(reinterpret_cast<char *>(buf), 8);
-            if (in.gcount() != 8)
+            uint32_t lo = 0, hi = 0;
+            if (!br.readBits(32, lo) || !br.readBits(32, hi))
                 return false;
-            v = 0;
-            for (int i = 0; i < 8; ++i)
-            {
-                v |= static_cast<uint64_t>(buf[i]) << (i * 8);
-            }
+            v = static_cast<uint64_t>(lo) | (static_cast<uint64_t>(hi) << 32);
             return true;
         }
 
-        bool readHeader(std::istream &in, FileHeader &hdr, std::string *err)
+        bool readHeader(BitReader &br, FileHeader &hdr, std::string *err)
         {
             uint32_t magic = 0;
-            if (!readU32LE(in, magic) || magic != MAGIC)
+            if (!readU32LE(br, magic) || magic != MAGIC)
             {
                 if (err)
                     *err = "readHeader: invalid magic or truncated";
                 return false;
             }
 
-            if (!readU16LE(in, hdr.version))
+            if (!readU16LE(br, hdr.version))
             {
                 if (err)
                     *err = "readHeader: failed to read version";
                 return false;
             }
 
-            if (!readU32LE(in, hdr.windowSize))
+            uint32_t flags = 0;
+            if (!br.readBits(8, flags))
             {
                 if (err)
-                    *err = "readHeader: failed to read windowSize";
+                    *err = "readHeader: failed to read flags";
                 return false;
             }
+            hdr.flags = static_cast<uint8_t>(flags);
 
-            if (!readU64LE(in, hdr.originalSize))
+            if (!readU32LE(br, hdr.windowSize))
             {
                 if (err)
-                    *err = "readHeader: failed to read originalSize";
+                    *err = "readHeader: failed to read windowSize";
                 return false;
             }
 
-            uint16_t llCount = 0;
-            if (!readU16LE(in, llCount))
+            if (!readU64LE(br, hdr.originalSize))
             {
                 if (err)
-                    *err = "readHeader: failed to read llFreqCount";
+                    *err = "readHeader: failed to read originalSize";
                 return false;
             }
-            hdr.llFreqs.clear();
-            hdr.llFreqs.reserve(llCount);
-            for (uint16_t i = 0; i < llCount; ++i)
-            {
-                uint16_t sym = 0;
-                uint32_t freq = 0;
-                if (!readU16LE(in, sym) || !readU32LE(in, freq))
-                {
-                    if (err)
-                        *err = "readHeader: failed to read LL freq entry";
-                    return false;
-                }
-                hdr.llFreqs.push_back({sym, freq});
-            }
 
-            uint16_t distCount = 0;
-            if (!readU16LE(in, distCount))
+            if (hdr.version != FORMAT_VERSION)
             {
                 if (err)
-                    *err = "readHeader: failed to read distFreqCount";
+                    *err = "readHeader: unsupported version " + std::to_string(hdr.version);
                 return false;
             }
-            hdr.distFreqs.clear();
-            hdr.distFreqs.reserve(distCount);
-            for (uint16_t i = 0; i < distCount; ++i)
+
+            if (hdr.flags & HEADER_DICTIONARY)
             {
-                uint16_t sym = 0;
-                uint32_t freq = 0;
-                if (!readU16LE(in, sym) || !readU32LE(in, freq))
+                // Indexed blocks are decoded independently, so none of them can use one
+                if ((hdr.flags & HEADER_INDEXED) || !readU32LE(br, hdr.dictionaryId))
                 {
                     if (err)
-                        *err = "readHeader: failed to read dist freq entry";
+                        *err = "readHeader: invalid preset dictionary header";
                     return false;
                 }
-                hdr.distFreqs.push_back({sym, freq});
             }
 
             return true;
         }
-    }
 
-    bool inflateStream(std::istream &in, std::ostream &out, std::string *err)
-    {
-        // Read header
-        FileHeader hdr;
-        if (!readHeader(in, hdr, err))
+        // Block headers sit on byte boundaries inside the bitstream
+        bool readBlockHeader(BitReader &br, BlockHeader &bh, std::string *err)
         {
-            return false;
+            uint32_t flags = 0;
+            br.alignToByte();
+            if (!br.readBits(8, flags) || !br.readBits(32, bh.rawSize) || !br.readBits(32, bh.crc))
+            {
+                if (err)
+                    *err = "readBlockHeader: truncated block header";
+                return false;
+            }
+            bh.flags = static_cast<uint8_t>(flags);
+            return true;
         }
 
-        // Rebuild frequency tables from header
-        std::vector<uint32_t> llFreqs(286, 0);
-        std::vector<uint32_t> distFreqs(30, 0);
+        // Decode target: the history followed by fresh output in one flat range, backed by
+        // a vector that grows on demand or by fixed caller memory (zero-copy)
+        struct OutputSpan
+        {
+            uint8_t *data = nullptr;
+            size_t size = 0;     // bytes produced, history included
+            size_t capacity = 0; // writable bytes at data
+            std::vector<uint8_t> *vec = nullptr;
+
+            explicit OutputSpan(std::vector<uint8_t> &v) : data(v.data()), size(v.size()), capacity(v.size()), vec(&v) {}
+            OutputSpan(uint8_t *d, size_t cap) : data(d), capacity(cap) {}
+
+            // Room for n more bytes; a vector also gets slack for wide match copies
+            bool ensure(size_t n)
+            {
+                if (capacity - size >= n)
+                    return true;
+                if (!vec)
+                    return false;
+                vec->resize(std::max(size + n + COPY_SLACK, vec->size() * 2));
+                data = vec->data();
+                capacity = vec->size();
+                return true;
+            }
+
+            // Trim a vector back to the bytes produced
+            void finish()
+            {
+                if (vec)
+                    vec->resize(size);
+            }
+
+            // Keep only the last window as history once fresh bytes were handed off
+            void keepHistory()
+            {
+                if (size > MAX_HISTORY)
+                {
+                    std::memmove(data, data + size - MAX_HISTORY, MAX_HISTORY);
+                    size = MAX_HISTORY;
+                }
+            }
+        };
 
-        for (const auto &p : hdr.llFreqs)
+        // LZ77 copy of length bytes from dst - distance, 8 bytes at a time. An overlapping
+        // source (distance < length) repeats its pattern; short distances first lay down
+        // one stride (a multiple of distance >= 8) byte by byte, then copy from a stride
+        // back. May write up to COPY_SLACK - 1 bytes past dst + length.
+        inline void copyMatch(uint8_t *dst, size_t distance, size_t length)
         {
-            if (p.first < llFreqs.size())
+            uint8_t *end = dst + length;
+            const uint8_t *src = dst - distance;
+            if (distance == 1)
+            {
+                std::memset(dst, *src, length);
+                return;
+            }
+            if (distance < 8)
             {
-                llFreqs[p.first] = p.second;
+                size_t stride = distance * ((8 + distance - 1) / distance);
+                size_t head = std::min(length, stride);
+                for (size_t i = 0; i < head; ++i)
+                    dst[i] = src[i];
+                dst += head;
+                src = dst - stride;
+            }
+            while (dst < end)
+            {
+                std::memcpy(dst, src, 8);
+                dst += 8;
+                src += 8;
             }
         }
-        for (const auto &p : hdr.distFreqs)
+
+        // Decode Huffman-coded literals/matches until EOB, appending to output (which holds
+        // the history). Back-references may not reach below floor; output may not grow past limit.
+        bool decodeSymbols(BitReader &br, const HuffmanCodec &llCodec, const HuffmanCodec &distCodec,
+                           OutputSpan &output, size_t floor, size_t limit, std::string *err)
         {
-            if (p.first < distFreqs.size())
+            while (true)
             {
-                distFreqs[p.first] = p.second;
+                uint16_t sym = 0;
+                if (!llCodec.decode(br, sym))
+                {
+                    if (err)
+                        *err = "inflateStream: failed to decode LL symbol";
+                    return false;
+                }
+
+                size_t length = 1;
+                uint32_t distance = 0;
+                if (sym == END_OF_BLOCK)
+                {
+                    // EOB
+                    return true;
+                }
+                else if (sym > END_OF_BLOCK)
+                {
+                    // Match: length symbol + extra bits, distance symbol + extra bits
+                    size_t lc = sym - FIRST_LENGTH_SYMBOL;
+                    uint32_t lenExtra = 0;
+                    if (lc >= LENGTH_CODES || !br.readBits(LENGTH_EXTRA[lc], lenExtra))
+                    {
+                        if (err)
+                            *err = "inflateStream: invalid or truncated length code";
+                        return false;
+                    }
+                    length = LENGTH_BASE[lc] + lenExtra;
+
+                    uint16_t dc = 0;
+                    uint32_t distExtra = 0;
+                    if (!distCodec.decode(br, dc) || dc >= DIST_ALPHABET_SIZE || !br.readBits(DIST_EXTRA[dc], distExtra))
+                    {
+                        if (err)
+                            *err = "inflateStream: invalid or truncated distance code";
+                        return false;
+                    }
+                    distance = DIST_BASE[dc] + distExtra;
+                    if (distance > output.size - floor)
+                    {
+                        if (err)
+                            *err = "inflateStream: distance exceeds output size";
+                        return false;
+                    }
+                }
+
+                if (length > limit - output.size)
+                {
+                    if (err)
+                        *err = "inflateStream: block overruns its declared size";
+                    return false;
+                }
+                if (!output.ensure(length))
+                {
+                    if (err)
+                        *err = "inflateStream: output buffer too small";
+                    return false;
+                }
+
+                uint8_t *dst = output.data + output.size;
+                if (distance == 0)
+                {
+                    *dst = static_cast<uint8_t>(sym);
+                }
+                else if (output.capacity - output.size >= length + COPY_SLACK)
+                {
+                    copyMatch(dst, distance, length);
+                }
+                else
+                {
+                    // Tail of fixed caller memory: no room to overshoot
+                    for (size_t i = 0; i < length; ++i)
+                        dst[i] = dst[i - distance];
+                }
+                output.size += length;
             }
         }
 
-        // Build Huffman codecs
-        HuffmanCodec llCodec, distCodec;
-        if (!llCodec.build(llFreqs))
+        // Codecs for dynamic blocks, rebuilt in place block after block so their tables
+        // are allocated once per decode (or once per InflateContext)
+        struct DynamicCodes
         {
-            if (err)
-                *err = "inflateStream: failed to build LL Huffman tree";
-            return false;
-        }
+            HuffmanCodec ll, dist, cl;
+        };
 
-        // Check if we have any distance codes
-        bool hasMatches = false;
-        for (auto f : distFreqs)
+        // RFC 1951 3.2.7 dynamic block header: code-length code, then LL + distance lengths
+        bool readDynamicTables(BitReader &br, DynamicCodes &codes, std::string *err)
         {
-            if (f > 0)
+            uint32_t hlit = 0, hdist = 0, hclen = 0;
+            if (!br.readBits(5, hlit) || !br.readBits(5, hdist) || !br.readBits(4, hclen))
+            {
+                if (err)
+                    *err = "inflateStream: truncated dynamic block header";
+                return false;
+            }
+            hlit += 257;
+            hdist += 1;
+            hclen += 4;
+            if (hlit > LL_ALPHABET_SIZE || hdist > DIST_ALPHABET_SIZE)
             {
-                hasMatches = true;
-                break;
+                if (err)
+                    *err = "inflateStream: too many length or distance symbols";
+                return false;
             }
-        }
-        if (hasMatches)
-        {
-            if (!distCodec.build(distFreqs))
+
+            std::array<uint8_t, CL_ALPHABET_SIZE> clLens{};
+            for (uint32_t i = 0; i < hclen; ++i)
+            {
+                uint32_t len = 0;
+                if (!br.readBits(3, len))
+                {
+                    if (err)
+                        *err = "inflateStream: truncated code-length code";
+                    return false;
+                }
+                clLens[CL_ORDER[i]] = static_cast<uint8_t>(len);
+            }
+            HuffmanCodec &clCodec = codes.cl;
+            if (!clCodec.buildFromLengths(clLens.data(), clLens.size()))
             {
                 if (err)
-                    *err = "inflateStream: failed to build Distance Huffman tree";
+                    *err = "inflateStream: invalid code-length code";
                 return false;
             }
-        }
 
-        // Decode bit stream
-        BitReader br(in);
-        std::vector<uint8_t> output;
-        output.reserve(static_cast<size_t>(hdr.originalSize));
+            std::array<uint8_t, LL_ALPHABET_SIZE + DIST_ALPHABET_SIZE> lens;
+            size_t count = 0;
+            while (count < hlit + hdist)
+            {
+                uint16_t sym = 0;
+                if (!clCodec.decode(br, sym))
+                {
+                    if (err)
+                        *err = "inflateStream: failed to decode code lengths";
+                    return false;
+                }
+                if (sym < 16)
+                {
+                    lens[count++] = static_cast<uint8_t>(sym);
+                    continue;
+                }
+
+                uint8_t value = 0;
+                uint32_t repeat = 0;
+                bool ok = true;
+                if (sym == 16)
+                {
+                    ok = count > 0 && br.readBits(2, repeat);
+                    value = count > 0 ? lens[count - 1] : 0;
+                    repeat += 3;
+                }
+                else if (sym == 17)
+                {
+                    ok = br.readBits(3, repeat);
+                    repeat += 3;
+                }
+                else
+                {
+                    ok = br.readBits(7, repeat);
+                    repeat += 11;
+                }
+                if (!ok || count + repeat > hlit + hdist)
+                {
+                    if (err)
+                        *err = "inflateStream: invalid code-length repeat";
+                    return false;
+                }
+                std::fill_n(lens.begin() + count, repeat, value);
+                count += repeat;
+            }
+
+            const uint8_t *distLens = lens.data() + hlit;
+            if (lens[END_OF_BLOCK] == 0 || !codes.ll.buildFromLengths(lens.data(), hlit))
+            {
+                if (err)
+                    *err = "inflateStream: invalid literal/length code";
+                return false;
+            }
+            // All-zero distance lengths are legal for a block without matches. The codec
+            // is cleared then, so a distance symbol fails rather than decoding against the
+            // previous block's table.
+            bool anyDist = std::any_of(distLens, distLens + hdist, [](uint8_t l)
+                                       { return l > 0; });
+            if (!anyDist)
+                codes.dist.clear();
+            else if (!codes.dist.buildFromLengths(distLens, hdist))
+            {
+                if (err)
+                    *err = "inflateStream: invalid distance code";
+                return false;
+            }
+            return true;
+        }
 
-        while (true)
+        bool readGzipHeader(BitReader &br, std::string *err)
         {
-            uint16_t sym = 0;
-            if (!llCodec.decode(br, sym))
+            uint8_t h[10];
+            if (!br.readBytes(h, sizeof(h)) || h[0] != 0x1f || h[1] != 0x8b || h[2] != 8)
+            {
+                if (err)
+                    *err = "readGzipHeader: not a deflate gzip member";
+                return false;
+            }
+            uint8_t flags = h[3];
+            bool ok = true;
+            if (flags & GZ_FEXTRA)
+            {
+                uint16_t xlen = 0;
+                ok = readU16LE(br, xlen);
+                for (uint16_t i = 0; ok && i < xlen; ++i)
+                {
+                    uint32_t skip = 0;
+                    ok = br.readBits(8, skip);
+                }
+            }
+            // FNAME and FCOMMENT are zero-terminated strings
+            for (uint8_t f : {GZ_FNAME, GZ_FCOMMENT})
+            {
+                if (!(flags & f))
+                    continue;
+                uint32_t c = 1;
+                while (ok && c != 0)
+                    ok = br.readBits(8, c);
+            }
+            if (ok && (flags & GZ_FHCRC))
+            {
+                uint32_t skip = 0;
+                ok = br.readBits(16, skip);
+            }
+            if (!ok)
             {
                 if (err)
-                    *err = "inflateStream: failed to decode LL symbol";
+                    *err = "readGzipHeader: truncated header";
                 return false;
             }
+            return true;
+        }
 
-            if (sym < 256)
+        // RFC 1951 3.2.6 fixed literal/length and distance codes
+        struct FixedCodes
+        {
+            HuffmanCodec ll, dist;
+            FixedCodes()
             {
-                // Literal
-                output.push_back(static_cast<uint8_t>(sym));
+                std::vector<uint8_t> lens(288, 8);
+                std::fill(lens.begin() + 144, lens.begin() + 256, 9);
+                std::fill(lens.begin() + 256, lens.begin() + 280, 7);
+                ll.buildFromLengths(lens);
+                dist.buildFromLengths(std::vector<uint8_t>(32, 5));
             }
-            else if (sym == 256)
+        };
+
+        const FixedCodes &fixedCodes()
+        {
+            static const FixedCodes codes;
+            return codes;
+        }
+
+        // Decode one RFC 1951 block (stored, fixed or dynamic) onto output; header receives
+        // its 3-bit BFINAL/BTYPE header. Back-references may not reach below floor; output
+        // may not grow past limit.
+        bool inflateDeflateBlock(BitReader &br, DynamicCodes &codes, OutputSpan &output, size_t floor, size_t limit,
+                                 uint32_t &header, std::string *err)
+        {
+            if (!br.readBits(3, header))
             {
-                // EOB
-                break;
+                if (err)
+                    *err = "inflateStream: truncated deflate block header";
+                return false;
             }
-            else if (sym >= 257)
+
+            uint32_t type = header >> 1;
+            if (type == 0)
             {
-                // Match: decode length and distance
-                // Read length (9 bits)
-                uint32_t lenVal = 0;
-                if (!br.readBits(9, lenVal))
+                // Stored: byte-aligned LEN, NLEN, raw bytes
+                uint16_t len = 0, nlen = 0;
+                br.alignToByte();
+                if (!readU16LE(br, len) || !readU16LE(br, nlen) || len != static_cast<uint16_t>(~nlen))
                 {
                     if (err)
-                        *err = "inflateStream: failed to read length";
+                        *err = "inflateStream: corrupt stored block length";
                     return false;
                 }
-                uint16_t length = static_cast<uint16_t>(lenVal);
-
-                // Decode distance symbol (if matches exist)
-                if (hasMatches)
+                if (len > limit - output.size)
                 {
-                    uint16_t distSym = 0;
-                    if (!distCodec.decode(br, distSym))
-                    {
-                        if (err)
-                            *err = "inflateStream: failed to decode distance symbol";
-                        return false;
-                    }
+                    if (err)
+                        *err = "inflateStream: block overruns its declared size";
+                    return false;
                 }
-
-                // Read distance (15 bits)
-                uint32_t distVal = 0;
-                if (!br.readBits(15, distVal))
+                if (!output.ensure(len))
                 {
                     if (err)
-                        *err = "inflateStream: failed to read distance";
+                        *err = "inflateStream: output buffer too small";
                     return false;
                 }
-                uint16_t distance = static_cast<uint16_t>(distVal);
-
-                // Perform LZ77 backreference copy (supports overlapping)
-                if (distance > output.size())
+                if (!br.readBytes(output.data + output.size, len))
                 {
                     if (err)
-                        *err = "inflateStream: distance exceeds output size";
+                        *err = "inflateStream: truncated stored block";
                     return false;
                 }
+                output.size += len;
+                return true;
+            }
+            if (type == 1)
+            {
+                const FixedCodes &fixed = fixedCodes();
+                return decodeSymbols(br, fixed.ll, fixed.dist, output, floor, limit, err);
+            }
+            if (type == 2)
+            {
+                return readDynamicTables(br, codes, err) &&
+                       decodeSymbols(br, codes.ll, codes.dist, output, floor, limit, err);
+            }
+            if (err)
+                *err = "inflateStream: invalid deflate block type";
+            return false;
+        }
+
+        // Decode one FC block's RFC 1951 blocks, appending to output (which holds the
+        // history), and check them against the block's CRC-32
+        bool inflateBlock(BitReader &br, const BlockHeader &bh, DynamicCodes &codes, OutputSpan &output, std::string *err)
+        {
+            const size_t blockStart = output.size;
+            const size_t blockEnd = blockStart + bh.rawSize;
+            uint32_t header = 0;
+            do
+            {
+                if (!inflateDeflateBlock(br, codes, output, 0, blockEnd, header, err))
+                    return false;
+            } while (!(header & 1u));
 
-                size_t start = output.size() - distance;
-                for (uint16_t i = 0; i < length; ++i)
+            if (output.size != blockEnd)
+            {
+                if (err)
                 {
-                    output.push_back(output[start + i]);
+                    *err = "inflateStream: block size mismatch (expected " +
+                           std::to_string(bh.rawSize) + ")";
                 }
+                return false;
             }
-            else
+            if (crc32(0, output.data + blockStart, bh.rawSize) != bh.crc)
+            {
+                if (err)
+                    *err = "inflateStream: block checksum mismatch";
+                return false;
+            }
+            return true;
+        }
+
+        // Decode one gzip member: header, RFC 1951 blocks, CRC-32/ISIZE trailer.
+        // output/out follow the same convention as inflateBlocks below.
+        bool inflateGzipMember(BitReader &br, DynamicCodes &codes, OutputSpan &output, std::ostream *out, std::string *err)
+        {
+            if (!readGzipHeader(br, err))
+                return false;
+
+            const size_t floor = output.size; // members cannot reference earlier members
+            size_t pending = output.size;     // first byte not yet checksummed/written
+            uint32_t crc = 0;
+            uint64_t size = 0;
+            uint32_t header = 0;
+            do
+            {
+                if (!inflateDeflateBlock(br, codes, output, floor, SIZE_MAX, header, err))
+                    return false;
+
+                size_t fresh = output.size - pending;
+                crc = crc32(crc, output.data + pending, fresh);
+                size += fresh;
+                if (out)
+                {
+                    out->write(reinterpret_cast<const char *>(output.data + pending), static_cast<std::streamsize>(fresh));
+                    if (!*out)
+                    {
+                        if (err)
+                            *err = "inflateStream: failed to write output";
+                        return false;
+                    }
+                    output.keepHistory();
+                }
+                pending = output.size;
+            } while (!(header & 1u));
+
+            uint32_t storedCrc = 0, storedSize = 0;
+            br.alignToByte();
+            if (!readU32LE(br, storedCrc) || !readU32LE(br, storedSize))
+            {
+                if (err)
+                    *err = "inflateStream: truncated gzip trailer";
+                return false;
+            }
+            if (storedCrc != crc || storedSize != static_cast<uint32_t>(size))
             {
                 if (err)
-                    *err = "inflateStream: invalid symbol";
+                    *err = "inflateStream: gzip CRC or length mismatch";
                 return false;
             }
+            if (out)
+                output.size = 0;
+            return true;
         }
 
-        // Verify output size
-        if (output.size() != hdr.originalSize)
+        struct IndexEntry
         {
-            if (err)
+            uint64_t compressedOffset = 0;
+            uint64_t uncompressedOffset = 0;
+            uint32_t rawSize = 0;
+        };
+
+        inline uint64_t loadLE(const uint8_t *p, int bytes)
+        {
+            uint64_t v = 0;
+            for (int i = bytes - 1; i >= 0; --i)
+                v = (v << 8) | p[i];
+            return v;
+        }
+
+        // Parse the FCIndexed trailer. tail holds the last tailSize bytes of a container of
+        // containerSize bytes and must cover the whole index. On success indexOffset is
+        // where the index starts, i.e. the end of the last block.
+        bool parseIndex(const uint8_t *tail, size_t tailSize, uint64_t containerSize, const FileHeader &hdr,
+                        std::vector<IndexEntry> &index, uint64_t &indexOffset, std::string *err)
+        {
+            auto fail = [err](const char *msg)
+            {
+                if (err)
+                    *err = msg;
+                return false;
+            };
+            if (tailSize < INDEX_FOOTER_SIZE)
+                return fail("inflateStream: truncated block index");
+            const uint8_t *footer = tail + tailSize - INDEX_FOOTER_SIZE;
+            indexOffset = loadLE(footer, 8);
+            uint64_t count = loadLE(footer + 8, 4);
+            if (loadLE(footer + 12, 4) != INDEX_MAGIC || count == 0 || indexOffset < HEADER_SIZE + CHECKSUM_SIZE ||
+                indexOffset + count * INDEX_ENTRY_SIZE + INDEX_FOOTER_SIZE != containerSize ||
+                containerSize - indexOffset > tailSize)
+                return fail("inflateStream: corrupt block index");
+
+            // Blocks must be in order, contiguous in the output and inside the block area
+            const uint8_t *p = tail + tailSize - (containerSize - indexOffset);
+            index.resize(static_cast<size_t>(count));
+            uint64_t nextComp = HEADER_SIZE;
+            uint64_t nextRaw = 0;
+            for (IndexEntry &e : index)
             {
-                *err = "inflateStream: output size mismatch (expected " +
-                       std::to_string(hdr.originalSize) + ", got " +
-                       std::to_string(output.size()) + ")";
+                e.compressedOffset = loadLE(p, 8);
+                e.uncompressedOffset = loadLE(p + 8, 8);
+                e.rawSize = static_cast<uint32_t>(loadLE(p + 16, 4));
+                p += INDEX_ENTRY_SIZE;
+                if (e.compressedOffset < nextComp || e.compressedOffset >= indexOffset - CHECKSUM_SIZE ||
+                    e.uncompressedOffset != nextRaw)
+                    return fail("inflateStream: corrupt block index");
+                nextComp = e.compressedOffset + 1;
+                nextRaw += e.rawSize;
             }
-            return false;
+            // Sizes come from the file, so bound each block by what its bytes can decode to
+            // before anyone allocates output for them
+            for (size_t i = 0; i < index.size(); ++i)
+            {
+                const uint64_t compEnd = (i + 1 < index.size()) ? index[i + 1].compressedOffset : indexOffset - CHECKSUM_SIZE;
+                if (index[i].rawSize > (compEnd - index[i].compressedOffset) * MAX_EXPANSION)
+                    return fail("inflateStream: corrupt block index");
+            }
+            if (hdr.originalSize != UNKNOWN_SIZE && nextRaw != hdr.originalSize)
+                return fail("inflateStream: block index disagrees with the header size");
+            return true;
         }
 
-        // Write output
-        out.write(reinterpret_cast<const char *>(output.data()), output.size());
-        if (!out)
+        // Run task(i) for every i in [0, count) on up to threads threads; stops handing out
+        // work after the first failure, whose message ends up in err
+        bool parallelFor(size_t count, unsigned threads, const std::function<bool(size_t, std::string *)> &task, std::string *err)
         {
-            if (err)
-                *err = "inflateStream: failed to write output";
-            return false;
+            std::atomic<size_t> next{0};
+            std::atomic<bool> failed{false};
+            std::mutex mu;
+            std::string firstErr;
+            auto worker = [&]
+            {
+                std::string e;
+                for (size_t i; !failed && (i = next++) < count;)
+                {
+                    if (!task(i, &e))
+                    {
+                        std::lock_guard<std::mutex> lock(mu);
+                        if (!failed.exchange(true))
+                            firstErr = e;
+                    }
+                }
+            };
+            std::vector<std::thread> pool;
+            for (size_t t = 1; t < std::min<size_t>(threads, count); ++t)
+                pool.emplace_back(worker);
+            worker();
+            for (auto &t : pool)
+                t.join();
+            if (failed && err)
+                *err = firstErr;
+            return !failed;
         }
 
-        return true;
+        // One self-contained FCIndexed block into exactly rawSize bytes at dst; crc, if set,
+        // receives the block's (verified) CRC-32
+        bool decodeIndexedBlock(const uint8_t *data, size_t size, uint8_t *dst, uint32_t rawSize, uint32_t *crc,
+                                std::string *err)
+        {
+            BitReader br(data, size);
+            BlockHeader bh;
+            if (!readBlockHeader(br, bh, err))
+                return false;
+            if (bh.rawSize != rawSize)
+            {
+                if (err)
+                    *err = "inflateStream: block header disagrees with the block index";
+                return false;
+            }
+            OutputSpan output(dst, rawSize);
+            DynamicCodes codes;
+            if (crc)
+                *crc = bh.crc;
+            return inflateBlock(br, bh, codes, output, err);
+        }
+
+        // fetch(offset, size, data) points data at container bytes [offset, offset + size),
+        // valid until the next call
+        using RangeFetch = std::function<bool(uint64_t, size_t, const uint8_t *&, std::string *)>;
+
+        // Decode an indexed container in batches of a few blocks per thread. Output lands in
+        // flat at each block's final offset, or with flat null, in a staging buffer that is
+        // written to out once the batch is done.
+        bool inflateIndexed(const std::vector<IndexEntry> &index, uint64_t indexOffset, unsigned threads,
+                            const RangeFetch &fetch, uint8_t *flat, std::ostream *out, std::string *err)
+        {
+            const size_t batch = 4 * static_cast<size_t>(threads);
+            std::vector<uint8_t> staging;
+            std::vector<uint32_t> crcs(batch);
+            uint32_t crc = 0;
+            for (size_t first = 0; first < index.size(); first += batch)
+            {
+                const size_t last = std::min(first + batch, index.size());
+                auto compEnd = [&](size_t i)
+                {
+                    return (i + 1 < index.size()) ? index[i + 1].compressedOffset : indexOffset;
+                };
+                const uint64_t compBegin = index[first].compressedOffset;
+                const uint64_t rawBegin = index[first].uncompressedOffset;
+                const uint64_t rawEnd = index[last - 1].uncompressedOffset + index[last - 1].rawSize;
+
+                const uint8_t *comp = nullptr;
+                if (!fetch(compBegin, static_cast<size_t>(compEnd(last - 1) - compBegin), comp, err))
+                    return false;
+                uint8_t *dst = flat ? flat + rawBegin : nullptr;
+                if (!flat)
+                {
+                    staging.resize(static_cast<size_t>(rawEnd - rawBegin));
+                    dst = staging.data();
+                }
+
+                auto task = [&](size_t k, std::string *e)
+                {
+                    const IndexEntry &b = index[first + k];
+                    return decodeIndexedBlock(comp + (b.compressedOffset - compBegin),
+                                              static_cast<size_t>(compEnd(first + k) - b.compressedOffset),
+                                              dst + (b.uncompressedOffset - rawBegin), b.rawSize, &crcs[k], e);
+                };
+                if (!parallelFor(last - first, threads, task, err))
+                    return false;
+
+                // Each block checked its own CRC; chain them and, after the last batch,
+                // compare with the whole-data CRC that precedes the index
+                for (size_t i = first; i < last; ++i)
+                    crc = crc32Combine(crc, crcs[i - first], index[i].rawSize);
+                if (last == index.size() &&
+                    static_cast<uint32_t>(loadLE(comp + (indexOffset - CHECKSUM_SIZE - compBegin), 4)) != crc)
+                {
+                    if (err)
+                        *err = "inflateStream: data checksum mismatch";
+                    return false;
+                }
+
+                if (out)
+                {
+                    out->write(reinterpret_cast<const char *>(staging.data()), static_cast<std::streamsize>(staging.size()));
+                    if (!*out)
+                    {
+                        if (err)
+                            *err = "inflateStream: failed to write output";
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+
+        // Stream source for inflateIndexed; base is where the container starts in the stream
+        RangeFetch streamFetch(std::istream &in, std::streampos base, std::vector<uint8_t> &buf)
+        {
+            return [&in, base, &buf](uint64_t offset, size_t size, const uint8_t *&data, std::string *err)
+            {
+                buf.resize(size);
+                in.clear();
+                in.seekg(base + static_cast<std::streamoff>(offset));
+                in.read(reinterpret_cast<char *>(buf.data()), static_cast<std::streamsize>(size));
+                if (static_cast<size_t>(in.gcount()) != size)
+                {
+                    if (err)
+                        *err = "inflateStream: truncated block data";
+                    return false;
+                }
+                data = buf.data();
+                return true;
+            };
+        }
+
+        RangeFetch spanFetch(const uint8_t *container)
+        {
+            return [container](uint64_t offset, size_t, const uint8_t *&data, std::string *)
+            {
+                data = container + offset;
+                return true;
+            };
+        }
+
+        // Read the index of an indexed container that starts at base in a seekable stream
+        bool readStreamIndex(std::istream &in, std::streampos base, const FileHeader &hdr,
+                             std::vector<IndexEntry> &index, uint64_t &indexOffset, std::string *err)
+        {
+            in.clear();
+            in.seekg(0, std::ios::end);
+            std::streampos end = in.tellg();
+            if (end == std::streampos(-1) || end - base < static_cast<std::streamoff>(HEADER_SIZE + INDEX_FOOTER_SIZE))
+            {
+                if (err)
+                    *err = "inflateStream: truncated block index";
+                return false;
+            }
+            const uint64_t containerSize = static_cast<uint64_t>(end - base);
+            uint8_t footer[INDEX_FOOTER_SIZE];
+            in.seekg(end - static_cast<std::streamoff>(INDEX_FOOTER_SIZE));
+            in.read(reinterpret_cast<char *>(footer), INDEX_FOOTER_SIZE);
+            uint64_t offset = loadLE(footer, 8);
+            if (!in || offset < HEADER_SIZE || offset >= containerSize)
+            {
+                if (err)
+                    *err = "inflateStream: corrupt block index";
+                return false;
+            }
+
+            std::vector<uint8_t> tail(static_cast<size_t>(containerSize - offset));
+            in.seekg(base + static_cast<std::streamoff>(offset));
+            in.read(reinterpret_cast<char *>(tail.data()), static_cast<std::streamsize>(tail.size()));
+            if (!in)
+            {
+                if (err)
+                    *err = "inflateStream: truncated block index";
+                return false;
+            }
+            return parseIndex(tail.data(), tail.size(), containerSize, hdr, index, indexOffset, err);
+        }
+
+        unsigned resolveThreads(uint32_t threads)
+        {
+            if (threads == 0)
+                threads = std::max(1u, std::thread::hardware_concurrency());
+            return threads;
+        }
+
+        // Load the preset dictionary the container was written with as history in front of
+        // the output; primed receives the number of history bytes placed (0 without one)
+        bool primeDictionary(const FileHeader &hdr, const InflateOptions &opt, OutputSpan &output, size_t &primed, std::string *err)
+        {
+            primed = 0;
+            if (!(hdr.flags & HEADER_DICTIONARY))
+                return true;
+            if (opt.dictionary.empty())
+            {
+                if (err)
+                    *err = "inflateStream: container needs preset dictionary " + std::to_string(hdr.dictionaryId);
+                return false;
+            }
+            if (dictionaryId(opt.dictionary) != hdr.dictionaryId)
+            {
+                if (err)
+                    *err = "inflateStream: wrong preset dictionary (container needs " + std::to_string(hdr.dictionaryId) + ")";
+                return false;
+            }
+            primed = std::min<size_t>(opt.dictionary.size(), std::min<size_t>(hdr.windowSize, MAX_HISTORY));
+            if (!output.ensure(primed))
+            {
+                if (err)
+                    *err = "inflateStream: output buffer too small";
+                return false;
+            }
+            std::memcpy(output.data, opt.dictionary.data() + opt.dictionary.size() - primed, primed);
+            output.size = primed;
+            return true;
+        }
+
+        // A gzip file is one or more members back to back
+        bool inflateGzip(BitReader &br, DynamicCodes &codes, OutputSpan &output, std::ostream *out, std::string *err)
+        {
+            do
+            {
+                if (!inflateGzipMember(br, codes, output, out, err))
+                    return false;
+            } while (br.peekBits(16) == GZIP_MAGIC);
+            return true;
+        }
+
+        // Decode every block after the file header. With out set, each finished block is
+        // written there and output keeps only the last window as history; otherwise the
+        // whole result accumulates in output.
+        bool inflateBlocks(BitReader &br, const FileHeader &hdr, DynamicCodes &codes, OutputSpan &output, std::ostream *out,
+                           std::string *err)
+        {
+            uint64_t produced = 0;
+            uint32_t crc = 0;
+            BlockHeader bh;
+            do
+            {
+                if (!readBlockHeader(br, bh, err))
+                {
+                    return false;
+                }
+
+                size_t histLen = output.size;
+                if (!inflateBlock(br, bh, codes, output, err))
+                {
+                    return false;
+                }
+                produced += bh.rawSize;
+                crc = crc32Combine(crc, bh.crc, bh.rawSize);
+
+                if (out)
+                {
+                    // Write this block's bytes, then trim history back to one window
+                    out->write(reinterpret_cast<const char *>(output.data + histLen), static_cast<std::streamsize>(bh.rawSize));
+                    if (!*out)
+                    {
+                        if (err)
+                            *err = "inflateStream: failed to write output";
+                        return false;
+                    }
+                    output.keepHistory();
+                }
+            } while (!(bh.flags & BLOCK_FINAL));
+
+            // Verify output size
+            if (hdr.originalSize != UNKNOWN_SIZE && produced != hdr.originalSize)
+            {
+                if (err)
+                {
+                    *err = "inflateStream: output size mismatch (expected " +
+                           std::to_string(hdr.originalSize) + ", got " +
+                           std::to_string(produced) + ")";
+                }
+                return false;
+            }
+
+            // Blocks verified themselves; the trailer covers the sequence as a whole
+            uint32_t stored = 0;
+            br.alignToByte();
+            if (!readU32LE(br, stored))
+            {
+                if (err)
+                    *err = "inflateStream: truncated data checksum";
+                return false;
+            }
+            if (stored != crc)
+            {
+                if (err)
+                    *err = "inflateStream: data checksum mismatch";
+                return false;
+            }
+            return true;
+        }
+
+        // Working memory of one decode. The free functions build one per call;
+        // InflateContext keeps one, so repeat calls find their memory already there.
+        struct Workspace
+        {
+            explicit Workspace(const InflateOptions &o) : opt(o) {}
+
+            InflateOptions opt;
+            DynamicCodes codes;
+            std::vector<uint8_t> history; // stream output window
+            std::vector<uint8_t> staging; // BitReader buffer for stream input
+        };
+
+        bool inflateStreamWith(Workspace &ws, std::istream &in, std::ostream &out, std::string *err)
+        {
+            const InflateOptions &opt = ws.opt;
+            const std::streampos base = in.tellg();
+            if (base == std::streampos(-1))
+                in.clear();
+            BitReader br(in, ws.staging);
+            OutputSpan output(ws.history);
+            output.size = 0; // keep the capacity, drop the previous call's bytes
+            if (br.peekBits(16) == GZIP_MAGIC)
+                return inflateGzip(br, ws.codes, output, &out, err);
+
+            FileHeader hdr;
+            if (!readHeader(br, hdr, err))
+            {
+                return false;
+            }
+
+            const unsigned threads = resolveThreads(opt.threads);
+            if ((hdr.flags & HEADER_INDEXED) && threads > 1 && base != std::streampos(-1))
+            {
+                std::vector<IndexEntry> index;
+                uint64_t indexOffset = 0;
+                if (!readStreamIndex(in, base, hdr, index, indexOffset, err))
+                    return false;
+                std::vector<uint8_t> buf;
+                return inflateIndexed(index, indexOffset, threads, streamFetch(in, base, buf), nullptr, &out, err);
+            }
+
+            size_t primed = 0;
+            return primeDictionary(hdr, opt, output, primed, err) && inflateBlocks(br, hdr, ws.codes, output, &out, err);
+        }
+
+        bool inflateBufferWith(Workspace &ws, const uint8_t *data, size_t size, std::vector<uint8_t> &out, std::string *err)
+        {
+            const InflateOptions &opt = ws.opt;
+            BitReader br(data, size);
+            out.clear();
+            OutputSpan output(out);
+            bool ok = false;
+            if (br.peekBits(16) == GZIP_MAGIC)
+            {
+                ok = inflateGzip(br, ws.codes, output, nullptr, err);
+            }
+            else
+            {
+                FileHeader hdr;
+                if (!readHeader(br, hdr, err))
+                {
+                    return false;
+                }
+
+                const unsigned threads = resolveThreads(opt.threads);
+                if ((hdr.flags & HEADER_INDEXED) && threads > 1)
+                {
+                    std::vector<IndexEntry> index;
+                    uint64_t indexOffset = 0;
+                    if (!parseIndex(data, size, size, hdr, index, indexOffset, err))
+                        return false;
+                    out.resize(static_cast<size_t>(index.back().uncompressedOffset + index.back().rawSize));
+                    return inflateIndexed(index, indexOffset, threads, spanFetch(data), out.data(), nullptr, err);
+                }
+
+                size_t primed = 0;
+                if (!primeDictionary(hdr, opt, output, primed, err))
+                    return false;
+                // Reserve the recorded size, but no more than the input can decode to
+                if (hdr.originalSize != UNKNOWN_SIZE)
+                    output.ensure(static_cast<size_t>(std::min<uint64_t>(hdr.originalSize, size * MAX_EXPANSION)));
+                ok = inflateBlocks(br, hdr, ws.codes, output, nullptr, err);
+                output.finish();
+                out.erase(out.begin(), out.begin() + static_cast<std::ptrdiff_t>(primed));
+                return ok;
+            }
+            output.finish();
+            return ok;
+        }
+    }
+
+    bool inflateStream(std::istream &in, std::ostream &out, std::string *err)
+    {
+        return inflateStream(in, out, InflateOptions{}, err);
+    }
+
+    bool inflateStream(std::istream &in, std::ostream &out, const InflateOptions &opt, std::string *err)
+    {
+        Workspace ws(opt);
+        return inflateStreamWith(ws, in, out, err);
+    }
+
+    bool verifyStream(std::istream &in, const InflateOptions &opt, uint64_t *originalSize, std::string *err)
+    {
+        // Counts what the decoder writes and drops it
+        struct DiscardBuf : std::streambuf
+        {
+            uint64_t bytes = 0;
+            std::streamsize xsputn(const char *, std::streamsize n) override
+            {
+                bytes += static_cast<uint64_t>(n);
+                return n;
+            }
+            int_type overflow(int_type c) override
+            {
+                ++bytes;
+                return traits_type::not_eof(c);
+            }
+        };
+        DiscardBuf sink;
+        std::ostream out(&sink);
+        Workspace ws(opt);
+        if (!inflateStreamWith(ws, in, out, err))
+            return false;
+        if (originalSize)
+            *originalSize = sink.bytes;
+        return true;
+    }
+
+    bool inflateBuffer(const uint8_t *data, size_t size, std::vector<uint8_t> &out, std::string *err)
+    {
+        return inflateBuffer(data, size, out, InflateOptions{}, err);
+    }
+
+    bool inflateBuffer(const uint8_t *data, size_t size, std::vector<uint8_t> &out, const InflateOptions &opt, std::string *err)
+    {
+        Workspace ws(opt);
+        return inflateBufferWith(ws, data, size, out, err);
+    }
+
+    bool inflatedSize(const uint8_t *data, size_t size, uint64_t &originalSize, std::string *err)
+    {
+        BitReader br(data, size);
+        if (br.peekBits(16) == GZIP_MAGIC)
+        {
+            if (err)
+                *err = "inflatedSize: gzip input does not record its size up front";
+            return false;
+        }
+        FileHeader hdr;
+        if (!readHeader(br, hdr, err))
+        {
+            return false;
+        }
+        if (hdr.originalSize == UNKNOWN_SIZE)
+        {
+            if (err)
+                *err = "inflatedSize: size was not known when the container was written";
+            return false;
+        }
+        originalSize = hdr.originalSize;
+        return true;
+    }
+
+    bool inflateInto(const uint8_t *data, size_t size, uint8_t *dst, size_t capacity, size_t *outSize, std::string *err)
+    {
+        return inflateInto(data, size, dst, capacity, outSize, InflateOptions{}, err);
+    }
+
+    bool inflateInto(const uint8_t *data, size_t size, uint8_t *dst, size_t capacity, size_t *outSize,
+                     const InflateOptions &opt, std::string *err)
+    {
+        BitReader br(data, size);
+        OutputSpan output(dst, capacity);
+        DynamicCodes codes;
+        bool ok = false;
+        if (outSize)
+            *outSize = 0;
+        if (br.peekBits(16) == GZIP_MAGIC)
+        {
+            ok = inflateGzip(br, codes, output, nullptr, err);
+        }
+        else
+        {
+            FileHeader hdr;
+            if (!readHeader(br, hdr, err))
+            {
+                return false;
+            }
+
+            const unsigned threads = resolveThreads(opt.threads);
+            if ((hdr.flags & HEADER_INDEXED) && threads > 1)
+            {
+                std::vector<IndexEntry> index;
+                uint64_t indexOffset = 0;
+                if (!parseIndex(data, size, size, hdr, index, indexOffset, err))
+                    return false;
+                uint64_t total = index.back().uncompressedOffset + index.back().rawSize;
+                if (total > capacity)
+                {
+                    if (err)
+                        *err = "inflateStream: output buffer too small";
+                    return false;
+                }
+                ok = inflateIndexed(index, indexOffset, threads, spanFetch(data), dst, nullptr, err);
+                if (ok && outSize)
+                    *outSize = static_cast<size_t>(total);
+                return ok;
+            }
+
+            if (hdr.flags & HEADER_DICTIONARY)
+            {
+                // The dictionary must sit right before the output, which dst has no room
+                // for: decode into a buffer and copy
+                std::vector<uint8_t> tmp;
+                if (!inflateBuffer(data, size, tmp, opt, err))
+                    return false;
+                if (tmp.size() > capacity)
+                {
+                    if (err)
+                        *err = "inflateStream: output buffer too small";
+                    return false;
+                }
+                if (!tmp.empty())
+                    std::memcpy(dst, tmp.data(), tmp.size());
+                if (outSize)
+                    *outSize = tmp.size();
+                return true;
+            }
+
+            ok = inflateBlocks(br, hdr, codes, output, nullptr, err);
+        }
+        if (outSize)
+            *outSize = output.size;
+        return ok;
+    }
+
+#ifdef __linux__
+    namespace
+    {
+        // inflateToFile's path for input it cannot map: decode through an ofstream.
+        // br is positioned after the FC header, or at the gzip magic.
+        bool inflateToFileStreamed(BitReader &br, bool gzip, const FileHeader &hdr, const InflateOptions &opt,
+                                   const std::string &path, std::string *err)
+        {
+            std::ofstream out(path, std::ios::binary | std::ios::trunc);
+            if (!out)
+            {
+                if (err)
+                    *err = "inflateToFile: cannot open " + path;
+                return false;
+            }
+            DynamicCodes codes;
+            std::vector<uint8_t> history;
+            OutputSpan output(history);
+            size_t primed = 0;
+            bool ok = gzip ? inflateGzip(br, codes, output, &out, err)
+                           : primeDictionary(hdr, opt, output, primed, err) &&
+                                 inflateBlocks(br, hdr, codes, output, &out, err);
+            out.close();
+            if (ok && !out.fail())
+                return true;
+            ::unlink(path.c_str()); // no partial output left behind
+            if (ok && err)
+                *err = "inflateToFile: cannot write " + path;
+            return false;
+        }
+    }
+
+    bool inflateToFile(std::istream &in, const std::string &path, std::string *err)
+    {
+        return inflateToFile(in, path, InflateOptions{}, err);
+    }
+
+    bool inflateToFile(std::istream &in, const std::string &path, const InflateOptions &opt, std::string *err)
+    {
+        // A seekable input's size bounds the output size the header may claim
+        uint64_t inputSize = UNKNOWN_SIZE;
+        const std::streampos base = in.tellg();
+        if (base == std::streampos(-1))
+        {
+            in.clear();
+        }
+        else
+        {
+            in.seekg(0, std::ios::end);
+            const std::streampos end = in.tellg();
+            if (in && end != std::streampos(-1))
+                inputSize = static_cast<uint64_t>(end - base);
+            in.clear();
+            in.seekg(base);
+        }
+        BitReader br(in);
+        DynamicCodes codes;
+        FileHeader hdr;
+        bool gzip = br.peekBits(16) == GZIP_MAGIC;
+        if (!gzip && !readHeader(br, hdr, err))
+        {
+            return false;
+        }
+
+        // Indexed blocks go to their final offsets in parallel; the index also gives the size
+        std::vector<IndexEntry> index;
+        uint64_t indexOffset = 0;
+        const unsigned threads = resolveThreads(opt.threads);
+        const bool parallel = !gzip && (hdr.flags & HEADER_INDEXED) && threads > 1 && base != std::streampos(-1);
+        if (parallel)
+        {
+            if (!readStreamIndex(in, base, hdr, index, indexOffset, err))
+                return false;
+            hdr.originalSize = index.back().uncompressedOffset + index.back().rawSize;
+        }
+
+        // Without a size up front there is nothing to map, and a preset dictionary would
+        // have to precede the mapping: decode through the stream path. So does input of
+        // unknown length, as nothing bounds the size its header claims.
+        if (gzip || hdr.originalSize == UNKNOWN_SIZE || (hdr.flags & HEADER_DICTIONARY) || inputSize == UNKNOWN_SIZE)
+            return inflateToFileStreamed(br, gzip, hdr, opt, path, err);
+
+        if (hdr.originalSize > inputSize * MAX_EXPANSION)
+        {
+            if (err)
+                *err = "inflateToFile: header size is more than the input can decode to";
+            return false;
+        }
+        int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+        {
+            if (err)
+                *err = "inflateToFile: cannot open " + path;
+            return false;
+        }
+
+        const size_t length = static_cast<size_t>(hdr.originalSize);
+        void *map = nullptr;
+        if (length > 0)
+        {
+            // Reserve the blocks up front: a store to a page of a sparse file that the disk
+            // or quota cannot back raises SIGBUS instead of returning an error
+            const int rc = ::posix_fallocate(fd, 0, static_cast<off_t>(length));
+            if (rc == EOPNOTSUPP || rc == EINVAL)
+            {
+                // The file system cannot reserve space: decode through the stream instead,
+                // from the start of the input, as the index read may have moved it
+                ::close(fd);
+                in.clear();
+                in.seekg(base);
+                BitReader again(in);
+                FileHeader h;
+                return readHeader(again, h, err) && inflateToFileStreamed(again, false, h, opt, path, err);
+            }
+            if (rc != 0)
+            {
+                ::close(fd);
+                ::unlink(path.c_str());
+                if (err)
+                    *err = "inflateToFile: cannot allocate " + std::to_string(length) + " bytes for " + path;
+                return false;
+            }
+            map = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (map == MAP_FAILED)
+            {
+                ::close(fd);
+                ::unlink(path.c_str());
+                if (err)
+                    *err = "inflateToFile: cannot map " + path;
+                return false;
+            }
+        }
+
+        bool ok = false;
+        if (parallel)
+        {
+            std::vector<uint8_t> buf;
+            ok = inflateIndexed(index, indexOffset, threads, streamFetch(in, base, buf), static_cast<uint8_t *>(map), nullptr, err);
+        }
+        else
+        {
+            OutputSpan output(static_cast<uint8_t *>(map), length);
+            ok = inflateBlocks(br, hdr, codes, output, nullptr, err);
+        }
+        if (map)
+            ::munmap(map, length);
+        ::close(fd);
+        if (!ok)
+            ::unlink(path.c_str());
+        return ok;
+    }
+#endif
+
+    struct RangeReader::Impl
+    {
+        explicit Impl(std::istream &in, size_t cacheBlocks) : in(in), cacheBlocks(std::max<size_t>(1, cacheBlocks)) {}
+
+        std::istream &in;
+        size_t cacheBlocks;
+        std::streampos base;
+        std::vector<IndexEntry> index;
+        uint64_t indexOffset = 0;
+        uint64_t total = 0;
+        bool opened = false;
+        std::vector<uint8_t> comp;
+        RangeFetch fetch;
+
+        // Decoded blocks, most recently used first
+        std::list<std::pair<size_t, std::vector<uint8_t>>> lru;
+        std::unordered_map<size_t, std::list<std::pair<size_t, std::vector<uint8_t>>>::iterator> cached;
+
+        const std::vector<uint8_t> *block(size_t i, std::string *err)
+        {
+            auto hit = cached.find(i);
+            if (hit != cached.end())
+            {
+                lru.splice(lru.begin(), lru, hit->second);
+                return &lru.front().second;
+            }
+
+            // Reuse the evicted block's storage for the new one
+            std::vector<uint8_t> raw;
+            if (lru.size() >= cacheBlocks)
+            {
+                raw.swap(lru.back().second);
+                cached.erase(lru.back().first);
+                lru.pop_back();
+            }
+
+            const IndexEntry &b = index[i];
+            const uint64_t compEnd = (i + 1 < index.size()) ? index[i + 1].compressedOffset : indexOffset;
+            const uint8_t *data = nullptr;
+            raw.resize(b.rawSize);
+            if (!fetch(b.compressedOffset, static_cast<size_t>(compEnd - b.compressedOffset), data, err) ||
+                !decodeIndexedBlock(data, static_cast<size_t>(compEnd - b.compressedOffset), raw.data(), b.rawSize, nullptr, err))
+                return nullptr;
+            lru.emplace_front(i, std::move(raw));
+            cached[i] = lru.begin();
+            return &lru.front().second;
+        }
+
+        // Hand the pieces of [offset, offset + length) to sink in order, one per block
+        bool forEachSlice(uint64_t offset, uint64_t length, const std::function<bool(const uint8_t *, size_t)> &sink, std::string *err)
+        {
+            auto fail = [err](const char *msg)
+            {
+                if (err)
+                    *err = msg;
+                return false;
+            };
+            if (!opened)
+                return fail("inflateRange: reader is not open");
+            if (offset > total)
+                return fail("inflateRange: offset is past the end of the data");
+            length = std::min(length, total - offset);
+
+            // Last block starting at or before offset; the first block starts at 0
+            auto after = std::upper_bound(index.begin(), index.end(), offset, [](uint64_t off, const IndexEntry &e)
+                                          { return off < e.uncompressedOffset; });
+            size_t i = static_cast<size_t>(after - index.begin()) - 1;
+            for (; length > 0; ++i)
+            {
+                const uint64_t skip = offset - index[i].uncompressedOffset;
+                if (skip >= index[i].rawSize)
+                    continue;
+                const std::vector<uint8_t> *raw = block(i, err);
+                if (!raw)
+                    return false;
+                const size_t n = static_cast<size_t>(std::min<uint64_t>(length, index[i].rawSize - skip));
+                if (!sink(raw->data() + skip, n))
+                    return fail("inflateRange: failed to write output");
+                offset += n;
+                length -= n;
+            }
+            return true;
+        }
+    };
+
+    RangeReader::RangeReader(std::istream &in, size_t cacheBlocks) : impl_(new Impl(in, cacheBlocks)) {}
+
+    RangeReader::~RangeReader() = default;
+
+    bool RangeReader::open(std::string *err)
+    {
+        Impl &r = *impl_;
+        r.opened = false;
+        r.lru.clear();
+        r.cached.clear();
+
+        r.in.clear();
+        r.base = r.in.tellg();
+        if (r.base == std::streampos(-1))
+        {
+            if (err)
+                *err = "inflateRange: input is not seekable";
+            return false;
+        }
+        BitReader br(r.in);
+        FileHeader hdr;
+        if (br.peekBits(16) == GZIP_MAGIC)
+        {
+            if (err)
+                *err = "inflateRange: gzip input has no block index";
+            return false;
+        }
+        if (!readHeader(br, hdr, err))
+        {
+            return false;
+        }
+        if (!(hdr.flags & HEADER_INDEXED))
+        {
+            if (err)
+                *err = "inflateRange: container has no block index";
+            return false;
+        }
+        if (!readStreamIndex(r.in, r.base, hdr, r.index, r.indexOffset, err))
+            return false;
+
+        r.total = r.index.back().uncompressedOffset + r.index.back().rawSize;
+        r.fetch = streamFetch(r.in, r.base, r.comp);
+        r.opened = true;
+        return true;
+    }
+
+    uint64_t RangeReader::size() const
+    {
+        return impl_->total;
+    }
+
+    bool RangeReader::read(uint64_t offset, uint64_t length, std::vector<uint8_t> &out, std::string *err)
+    {
+        out.clear();
+        auto sink = [&out](const uint8_t *p, size_t n)
+        {
+            out.insert(out.end(), p, p + n);
+            return true;
+        };
+        return impl_->forEachSlice(offset, length, sink, err);
+    }
+
+    bool RangeReader::read(uint64_t offset, uint64_t length, std::ostream &out, std::string *err)
+    {
+        auto sink = [&out](const uint8_t *p, size_t n)
+        {
+            out.write(reinterpret_cast<const char *>(p), static_cast<std::streamsize>(n));
+            return static_cast<bool>(out);
+        };
+        return impl_->forEachSlice(offset, length, sink, err);
+    }
+
+    bool inflateRange(std::istream &in, uint64_t offset, uint64_t length, std::ostream &out, std::string *err)
+    {
+        RangeReader reader(in, 1);
+        return reader.open(err) && reader.read(offset, length, out, err);
+    }
+
+    struct InflateContext::Impl : Workspace
+    {
+        using Workspace::Workspace;
+    };
+
+    InflateContext::InflateContext(const InflateOptions &opt) : impl_(std::make_unique<Impl>(opt)) {}
+
+    InflateContext::~InflateContext() = default;
+
+    void InflateContext::reset(const InflateOptions &opt)
+    {
+        impl_->opt = opt;
+    }
+
+    const InflateOptions &InflateContext::options() const
+    {
+        return impl_->opt;
+    }
+
+    bool InflateContext::decompress(const uint8_t *data, size_t size, std::vector<uint8_t> &out, std::string *err)
+    {
+        return inflateBufferWith(*impl_, data, size, out, err);
+    }
+
+    bool InflateContext::decompress(std::istream &in, std::ostream &out, std::string *err)
+    {
+        return inflateStreamWith(*impl_, in, out, err);
     }
 
 } // namespace fc
@@ -1,11 +1,108 @@
 #pragma once
 #include <iosfwd>
+#include <memory>
 #include <string>
+#include <vector>
+#include <cstdint>
 
 namespace fc
 {
 
+    struct InflateOptions
+    {
+        // Decoding threads for FCIndexed containers; 0 = one per hardware thread.
+        // Other inputs are always decoded serially.
+        uint32_t threads = 1;
+        // Preset dictionary for containers written with one (see LZ77Options::dictionary);
+        // must match the compressor's bytes exactly
+        std::vector<uint8_t> dictionary;
+    };
+
     // Decompress from custom DEFLATE-like container
     bool inflateStream(std::istream &in, std::ostream &out, std::string *err);
+    // Indexed containers on a seekable stream are decoded in parallel batches
+    bool inflateStream(std::istream &in, std::ostream &out, const InflateOptions &opt, std::string *err);
+
+    // Decode in without keeping the output, checking the block and whole-data CRC-32s
+    // (or the gzip trailer); originalSize, if set, receives the decoded size
+    bool verifyStream(std::istream &in, const InflateOptions &opt, uint64_t *originalSize, std::string *err);
+
+    // Decompress an in-memory container into out (replacing its contents)
+    bool inflateBuffer(const uint8_t *data, size_t size, std::vector<uint8_t> &out, std::string *err);
+    bool inflateBuffer(const uint8_t *data, size_t size, std::vector<uint8_t> &out, const InflateOptions &opt, std::string *err);
+
+    // Original size recorded in an FC container header, for sizing the inflateInto target.
+    // False for gzip input and for containers written from a non-seekable stream.
+    bool inflatedSize(const uint8_t *data, size_t size, uint64_t &originalSize, std::string *err);
+
+    // Decompress straight into caller memory with no intermediate buffer; fails if the
+    // result does not fit in capacity. outSize receives the bytes written. Containers with
+    // a preset dictionary are the exception: the dictionary has to precede the output, so
+    // they are decoded into a temporary buffer and copied.
+    bool inflateInto(const uint8_t *data, size_t size, uint8_t *dst, size_t capacity, size_t *outSize, std::string *err);
+    bool inflateInto(const uint8_t *data, size_t size, uint8_t *dst, size_t capacity, size_t *outSize,
+                     const InflateOptions &opt, std::string *err);
+
+    // Decompressor for many calls in a row; the counterpart of DeflateContext. Keeps the
+    // Huffman tables, stream window and read buffer between calls, so a warmed-up
+    // decompress() allocates nothing but the growth of out. One context per thread.
+    class InflateContext
+    {
+    public:
+        explicit InflateContext(const InflateOptions &opt = {});
+        ~InflateContext();
+        InflateContext(const InflateContext &) = delete;
+        InflateContext &operator=(const InflateContext &) = delete;
+
+        void reset(const InflateOptions &opt);
+        const InflateOptions &options() const;
+
+        // Same results as inflateBuffer / inflateStream with options()
+        bool decompress(const uint8_t *data, size_t size, std::vector<uint8_t> &out, std::string *err);
+        bool decompress(std::istream &in, std::ostream &out, std::string *err);
+
+    private:
+        struct Impl;
+        std::unique_ptr<Impl> impl_;
+    };
+
+#ifdef __linux__
+    // Decompress into path through a shared mmap sized from the FC header, so the output
+    // never passes through a user-space buffer. Gzip input, containers without a recorded
+    // size and unseekable input go through the streaming path instead. A header size the
+    // input could not decode to is rejected before path is touched, and the file's blocks
+    // are reserved before mapping (a file system that cannot reserve them gets the
+    // streaming path too). On any failure path is removed rather than left truncated or
+    // partial.
+    bool inflateToFile(std::istream &in, const std::string &path, std::string *err);
+    // Indexed blocks are decoded in parallel straight to their final offsets in the mapping
+    bool inflateToFile(std::istream &in, const std::string &path, const InflateOptions &opt, std::string *err);
+#endif
+
+    // Random access into an FCIndexed container: only the blocks covering a requested
+    // range are read and decoded, and the most recently used blocks stay decoded for
+    // nearby reads. in must be seekable and outlive the reader.
+    class RangeReader
+    {
+    public:
+        explicit RangeReader(std::istream &in, size_t cacheBlocks = 8);
+        ~RangeReader();
+
+        // Read the header and block index; fails for gzip and non-indexed containers
+        bool open(std::string *err);
+        // Decompressed size of the whole container
+        uint64_t size() const;
+        // Bytes [offset, offset + length) into out (replacing its contents). The range is
+        // clipped at the end of the data; an offset past the end is an error.
+        bool read(uint64_t offset, uint64_t length, std::vector<uint8_t> &out, std::string *err);
+        bool read(uint64_t offset, uint64_t length, std::ostream &out, std::string *err);
+
+    private:
+        struct Impl;
+        std::unique_ptr<Impl> impl_;
+    };
+
+    // One-shot range read; use a RangeReader to keep the block cache across reads
+    bool inflateRange(std::istream &in, uint64_t offset, uint64_t length, std::ostream &out, std::string *err);
 
 } // namespace fc
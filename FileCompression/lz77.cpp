@@ -1,8 +1,10 @@
 #include "lz77.h"
+#include "huffman.h"
 #include <istream>
 #include <vector>
 #include <algorithm>
 #include <cstring>
+#include <cmath>
 
 namespace fc
 {
@@ -11,6 +13,13 @@ namespace fc
         // 3-byte rolling hash constant
         constexpr uint32_t HASH_SHIFT = 5;
         constexpr uint32_t HASH_MASK = 0xFFFFu; // 16-bit hash for reasonable table size
+        constexpr size_t HASH_SIZE = HASH_MASK + 1;
+        // Largest window the DEFLATE distance codes (1-32768) can address
+        constexpr uint32_t MAX_WINDOW = 32 * 1024;
+        // Lazy level: matches at least this long are taken without looking one byte ahead
+        constexpr uint16_t LAZY_LIMIT = 32;
+        // Optimal level: positions inside a match this long are not searched
+        constexpr uint16_t NICE_LENGTH = 128;
 
         inline uint32_t hashFunc(uint8_t a, uint8_t b, uint8_t c)
         {
@@ -20,132 +29,403 @@ namespace fc
             return h;
         }
 
-        struct Match
+        inline uint32_t roundUpPow2(uint32_t v)
         {
-            uint16_t length = 0;
-            uint16_t distance = 0;
-        };
+            uint32_t p = 1;
+            while (p < v)
+                p <<= 1;
+            return p;
+        }
 
-        // Find longest match in sliding window using hash chain
-        Match findLongestMatch(const std::vector<uint8_t> &buf,
-                               size_t pos,
-                               const std::vector<std::vector<uint32_t>> &hashTable,
-                               uint32_t windowSize,
-                               uint32_t maxCandidates,
-                               uint16_t minMatch,
-                               uint16_t maxMatch)
-        {
-            Match best{0, 0};
-            if (pos + minMatch > buf.size())
-                return best;
-
-            // Compute hash of current 3-byte sequence
-            uint32_t h = hashFunc(buf[pos], buf[pos + 1], buf[pos + 2]);
-            const auto &chain = hashTable[h];
-
-            // Search window start
-            size_t windowStart = (pos > windowSize) ? (pos - windowSize) : 0;
-
-            // Limit candidates
-            uint32_t checked = 0;
-            for (auto it = chain.rbegin(); it != chain.rend() && checked < maxCandidates; ++it)
-            {
-                uint32_t candPos = *it;
-                if (candPos >= pos)
-                    continue; // future or self
-                if (candPos < windowStart)
-                    break; // out of window (chain is sorted)
+        // Bit-cost estimates for the optimal parser, in 1/COST_SCALE bits
+        constexpr uint32_t COST_SCALE = 16;
 
-                ++checked;
+        struct CostModel
+        {
+            uint32_t literal[256];
+            uint32_t length[259];                // symbol + extra bits, by match length
+            uint32_t dist[DIST_ALPHABET_SIZE];   // symbol + extra bits, by distance code
+        };
 
-                // Compute distance
-                uint16_t dist = static_cast<uint16_t>(pos - candPos);
+        // -log2(freq / total), pricing unseen symbols as if seen once
+        uint32_t symbolCost(uint64_t freq, uint64_t total)
+        {
+            double p = static_cast<double>(std::max<uint64_t>(freq, 1)) / static_cast<double>(std::max<uint64_t>(total, 1));
+            double bits = std::min(std::max(-std::log2(p), 1.0), static_cast<double>(MAX_CODE_BITS));
+            return static_cast<uint32_t>(bits * COST_SCALE);
+        }
 
-                // Find match length
-                size_t maxLen = std::min<size_t>(maxMatch, buf.size() - pos);
-                size_t len = 0;
-                while (len < maxLen && buf[candPos + len] == buf[pos + len])
+        void seedCostModel(const uint8_t *data, size_t n, CostModel &m)
+        {
+            uint64_t hist[256] = {};
+            for (size_t i = 0; i < n; ++i)
+                ++hist[data[i]];
+            for (int b = 0; b < 256; ++b)
+                m.literal[b] = symbolCost(hist[b], n);
+            for (uint16_t len = 3; len < 259; ++len)
+                m.length[len] = (7 + LENGTH_EXTRA[lengthCode(len)]) * COST_SCALE;
+            for (size_t c = 0; c < DIST_ALPHABET_SIZE; ++c)
+                m.dist[c] = (5 + DIST_EXTRA[c]) * COST_SCALE;
+        }
+
+        void refineCostModel(const std::vector<Token> &tokens, CostModel &m)
+        {
+            uint64_t ll[LL_ALPHABET_SIZE] = {}, dist[DIST_ALPHABET_SIZE] = {};
+            uint64_t llTotal = 1; // end of block
+            uint64_t distTotal = 0;
+            for (const Token &t : tokens)
+            {
+                ++llTotal;
+                if (t.kind == TokenKind::Literal)
                 {
-                    ++len;
+                    ++ll[t.literal];
+                    continue;
                 }
+                ++ll[FIRST_LENGTH_SYMBOL + lengthCode(t.length)];
+                ++dist[distCode(t.distance)];
+                ++distTotal;
+            }
+            for (int b = 0; b < 256; ++b)
+                m.literal[b] = symbolCost(ll[b], llTotal);
+            for (uint16_t len = 3; len < 259; ++len)
+            {
+                uint16_t c = lengthCode(len);
+                m.length[len] = symbolCost(ll[FIRST_LENGTH_SYMBOL + c], llTotal) + LENGTH_EXTRA[c] * COST_SCALE;
+            }
+            for (size_t c = 0; c < DIST_ALPHABET_SIZE; ++c)
+                m.dist[c] = symbolCost(dist[c], distTotal) + DIST_EXTRA[c] * COST_SCALE;
+        }
+    }
+
+    MatchFinder::MatchFinder(const LZ77Options &opt)
+        : opt_(opt)
+    {
+        window_ = std::min(std::max<uint32_t>(opt_.windowSize, 2), MAX_WINDOW);
+        windowMask_ = roundUpPow2(window_) - 1;
+        head_.assign(HASH_SIZE, NIL);
+        prev_.assign(static_cast<size_t>(windowMask_) + 1, NIL);
+        chains_ = opt_.level != CompressionLevel::Fastest;
+        maxProbes_ = chains_ ? opt_.maxCandidates : 1;
+        matchLength_ = bestMatchLength();
+    }
+
+    void MatchFinder::reset()
+    {
+        // prev_ needs no clearing, as in zlib: a position's link is written when it is
+        // inserted, and chains only reach positions inserted since the reset
+        std::fill(head_.begin(), head_.end(), NIL);
+    }
+
+    void MatchFinder::insert(const uint8_t *buf, size_t pos)
+    {
+        uint32_t h = hashFunc(buf[pos], buf[pos + 1], buf[pos + 2]);
+        if (chains_)
+            prev_[pos & windowMask_] = head_[h];
+        head_[h] = static_cast<uint32_t>(pos);
+    }
+
+    Match MatchFinder::find(const uint8_t *buf, size_t pos, size_t end) const
+    {
+        return search(buf, pos, end, [](const Match &) {});
+    }
 
-                if (len >= minMatch)
+    void MatchFinder::findAll(const uint8_t *buf, size_t pos, size_t end, std::vector<Match> &out) const
+    {
+        search(buf, pos, end, [&out](const Match &m)
+               { out.push_back(m); });
+    }
+
+    template <typename OnMatch>
+    Match MatchFinder::search(const uint8_t *buf, size_t pos, size_t end, OnMatch &&onMatch) const
+    {
+        Match best{0, 0};
+        if (pos + opt_.minMatch > end || pos + 3 > end)
+            return best;
+
+        // Oldest usable position: distance must stay below the window size
+        size_t limit = (pos >= window_) ? (pos - window_ + 1) : 0;
+        size_t maxLen = std::min<size_t>(opt_.maxMatch, end - pos);
+        const uint8_t *cur = buf + pos;
+
+        uint32_t cand = head_[hashFunc(cur[0], cur[1], cur[2])];
+        uint32_t checked = 0;
+        while (cand != NIL && cand >= limit && cand < pos && checked < maxProbes_)
+        {
+            ++checked;
+            const uint8_t *ref = buf + cand;
+
+            // Cheap reject: a better match must extend past the current best length
+            if (ref[best.length] == cur[best.length])
+            {
+                size_t len = matchLength_(ref, cur, maxLen);
+
+                // Chain runs newest to oldest, so a tie keeps the smaller distance
+                if (len >= opt_.minMatch && len > best.length)
                 {
-                    // Prefer longer match; if tie, prefer smaller distance
-                    if (len > best.length || (len == best.length && dist < best.distance))
-                    {
-                        best.length = static_cast<uint16_t>(len);
-                        best.distance = dist;
-                    }
+                    best.length = static_cast<uint16_t>(len);
+                    best.distance = static_cast<uint16_t>(pos - cand);
+                    onMatch(best);
+                    if (len == maxLen)
+                        break;
                 }
             }
 
-            return best;
+            uint32_t next = prev_[cand & windowMask_];
+            if (next >= cand)
+                break; // ring slot already reused by a newer position
+            cand = next;
         }
+
+        return best;
     }
 
-    bool LZ77Encoder::encode(std::istream &in, std::vector<Token> &outTokens, size_t *inputSize)
+    void MatchFinder::slide(size_t delta)
+    {
+        // Positions that fall off the front become NIL; ring slots stay aligned
+        // because delta is a multiple of the ring size
+        auto rebase = [delta](uint32_t &p)
+        {
+            p = (p == NIL || p < delta) ? NIL : static_cast<uint32_t>(p - delta);
+        };
+        std::for_each(head_.begin(), head_.end(), rebase);
+        std::for_each(prev_.begin(), prev_.end(), rebase);
+    }
+
+    bool LZ77Encoder::encode(std::istream &in, TokenBuffer &outTokens, size_t *inputSize)
     {
         outTokens.clear();
+        if (!validMatchLengths(opt_))
+            return false;
 
-        // Read entire input into buffer for efficient lookback
-        std::vector<uint8_t> buf;
-        buf.reserve(1024 * 64); // start with 64KB
-        while (true)
+        // Read entire input into buffer for efficient lookback, 64KB at a time, after
+        // the usable part of any preset dictionary
+        const size_t dictLen = usableDictionarySize(opt_);
+        std::vector<uint8_t> buf(opt_.dictionary.end() - static_cast<std::ptrdiff_t>(dictLen), opt_.dictionary.end());
+        constexpr size_t CHUNK = 1024 * 64;
+        while (in)
         {
-            int ch = in.get();
-            if (ch == EOF)
-                break;
-            buf.push_back(static_cast<uint8_t>(ch));
+            size_t at = buf.size();
+            buf.resize(at + CHUNK);
+            in.read(reinterpret_cast<char *>(buf.data() + at), static_cast<std::streamsize>(CHUNK));
+            buf.resize(at + static_cast<size_t>(in.gcount()));
         }
 
         if (inputSize)
-            *inputSize = buf.size();
-        if (buf.empty())
-            return true;
+            *inputSize = buf.size() - dictLen;
+
+        // Positions are stored as 32-bit indices in the hash chains
+        if (buf.size() >= 0xFFFFFFFFu)
+            return false;
 
-        // Build hash table: hash -> list of positions
-        // Use 65K buckets (16-bit hash)
-        std::vector<std::vector<uint32_t>> hashTable(65536);
+        reset();
+        encodeBlock(buf.data(), dictLen, buf.size(), outTokens);
+        return true;
+    }
 
-        size_t pos = 0;
-        while (pos < buf.size())
+    void LZ77Encoder::encodeBlock(const uint8_t *buf, size_t start, size_t end, TokenBuffer &outTokens)
+    {
+        switch (opt_.level)
         {
-            // Try to find match if we have at least minMatch bytes ahead
-            if (pos + opt_.minMatch <= buf.size())
-            {
-                Match m = findLongestMatch(buf, pos, hashTable, opt_.windowSize, opt_.maxCandidates, opt_.minMatch, opt_.maxMatch);
-                if (m.length >= opt_.minMatch)
-                {
-                    // Emit match token
-                    outTokens.push_back(Token::makeMatch(m.length, m.distance));
+        case CompressionLevel::Lazy:
+            encodeLazy(buf, start, end, outTokens);
+            break;
+        case CompressionLevel::Optimal:
+            encodeOptimal(buf, start, end, outTokens);
+            break;
+        default:
+            encodeGreedy(buf, start, end, outTokens);
+            break;
+        }
 
-                    // Insert all positions in matched region into hash table (for future lookups)
-                    for (uint16_t i = 0; i < m.length && pos + i + 2 < buf.size(); ++i)
-                    {
-                        uint32_t h = hashFunc(buf[pos + i], buf[pos + i + 1], buf[pos + i + 2]);
-                        hashTable[h].push_back(static_cast<uint32_t>(pos + i));
-                    }
+        while (insertPos_ + 2 < end)
+        {
+            finder_.insert(buf, insertPos_++);
+        }
+    }
 
-                    pos += m.length;
-                    continue;
+    void LZ77Encoder::skipBlock(const uint8_t *buf, size_t end)
+    {
+        // Positions further back than the window can never be matched from the next block
+        if (end > opt_.windowSize)
+            insertPos_ = std::max<size_t>(insertPos_, end - opt_.windowSize);
+        while (insertPos_ + 2 < end)
+        {
+            finder_.insert(buf, insertPos_++);
+        }
+    }
+
+    void LZ77Encoder::catchUp(const uint8_t *buf, size_t pos, size_t end)
+    {
+        // Positions whose 3-byte hash needed bytes from this block
+        while (insertPos_ < pos && insertPos_ + 2 < end)
+        {
+            finder_.insert(buf, insertPos_++);
+        }
+    }
+
+    void LZ77Encoder::encodeGreedy(const uint8_t *buf, size_t start, size_t end, TokenBuffer &outTokens)
+    {
+        const bool indexMatches = opt_.level != CompressionLevel::Fastest;
+        size_t pos = start;
+        while (pos < end)
+        {
+            catchUp(buf, pos, end);
+
+            Match m = finder_.find(buf, pos, end);
+            if (m.length >= opt_.minMatch)
+            {
+                // Emit match token; the matched region is inserted on the next iteration,
+                // except at Fastest, which only indexes where the match starts
+                outTokens.pushMatch(m.length, m.distance);
+                if (!indexMatches)
+                {
+                    if (pos + 2 < end)
+                        finder_.insert(buf, pos);
+                    insertPos_ = pos + m.length;
                 }
+                pos += m.length;
+                continue;
             }
 
             // No match or not enough bytes: emit literal
-            outTokens.push_back(Token::makeLiteral(buf[pos]));
+            outTokens.pushLiteral(buf[pos]);
+            ++pos;
+        }
+    }
 
-            // Insert current position into hash table if possible
-            if (pos + 2 < buf.size())
+    void LZ77Encoder::encodeLazy(const uint8_t *buf, size_t start, size_t end, TokenBuffer &outTokens)
+    {
+        size_t pos = start;
+        while (pos < end)
+        {
+            catchUp(buf, pos, end);
+            Match m = finder_.find(buf, pos, end);
+
+            // Defer the match while the next position starts a longer one
+            while (m.length >= opt_.minMatch && m.length < LAZY_LIMIT && pos + 1 < end)
             {
-                uint32_t h = hashFunc(buf[pos], buf[pos + 1], buf[pos + 2]);
-                hashTable[h].push_back(static_cast<uint32_t>(pos));
+                catchUp(buf, pos + 1, end);
+                Match next = finder_.find(buf, pos + 1, end);
+                if (next.length <= m.length)
+                    break;
+                outTokens.pushLiteral(buf[pos]);
+                ++pos;
+                m = next;
             }
 
+            if (m.length >= opt_.minMatch)
+            {
+                outTokens.pushMatch(m.length, m.distance);
+                pos += m.length;
+                continue;
+            }
+            outTokens.pushLiteral(buf[pos]);
             ++pos;
         }
+    }
 
-        return true;
+    void LZ77Encoder::encodeOptimal(const uint8_t *buf, size_t start, size_t end, TokenBuffer &outTokens)
+    {
+        const size_t n = end - start;
+        if (n == 0)
+            return;
+
+        // Candidate matches at every position, gathered once and shared by both passes
+        std::vector<uint32_t> &first = optFirst_;
+        std::vector<Match> &cands = optCands_;
+        first.resize(n + 1);
+        cands.clear();
+        cands.reserve(n);
+        size_t skipUntil = start;
+        for (size_t pos = start; pos < end; ++pos)
+        {
+            first[pos - start] = static_cast<uint32_t>(cands.size());
+            catchUp(buf, pos, end);
+            if (pos < skipUntil)
+                continue;
+            size_t before = cands.size();
+            finder_.findAll(buf, pos, end, cands);
+            if (cands.size() > before && cands.back().length >= NICE_LENGTH)
+                skipUntil = pos + cands.back().length;
+        }
+        first[n] = static_cast<uint32_t>(cands.size());
+
+        // Pass 1 prices literals by byte frequency and matches like the fixed Huffman
+        // code; pass 2 reprices every symbol from the tokens pass 1 chose
+        CostModel model;
+        seedCostModel(buf + start, n, model);
+
+        const uint16_t minLen = std::max<uint16_t>(opt_.minMatch, 3);
+        std::vector<uint64_t> &cost = optCost_;
+        std::vector<Match> &step = optStep_;
+        std::vector<Token> &parse = optParse_;
+        cost.resize(n + 1);
+        step.resize(n + 1);
+        for (int pass = 0; pass < 2; ++pass)
+        {
+            std::fill(cost.begin(), cost.end(), UINT64_MAX);
+            cost[0] = 0;
+            for (size_t i = 0; i < n; ++i)
+            {
+                uint64_t c = cost[i] + model.literal[buf[start + i]];
+                if (c < cost[i + 1])
+                {
+                    cost[i + 1] = c;
+                    step[i + 1] = Match{0, 0};
+                }
+
+                // Each candidate covers the lengths past the previous one
+                uint16_t len = minLen;
+                for (uint32_t k = first[i]; k < first[i + 1]; ++k)
+                {
+                    const Match &m = cands[k];
+                    uint64_t base = cost[i] + model.dist[distCode(m.distance)];
+                    for (; len <= m.length; ++len)
+                    {
+                        c = base + model.length[len];
+                        if (c < cost[i + len])
+                        {
+                            cost[i + len] = c;
+                            step[i + len] = Match{len, m.distance};
+                        }
+                    }
+                }
+            }
+
+            parse.clear();
+            for (size_t i = n; i > 0;)
+            {
+                const Match &m = step[i];
+                if (m.length == 0)
+                {
+                    parse.push_back(Token::makeLiteral(buf[start + i - 1]));
+                    --i;
+                }
+                else
+                {
+                    parse.push_back(Token::makeMatch(m.length, m.distance));
+                    i -= m.length;
+                }
+            }
+            std::reverse(parse.begin(), parse.end());
+            if (pass == 0)
+                refineCostModel(parse, model);
+        }
+
+        for (const Token &t : parse)
+            outTokens.push_back(t);
+    }
+
+    void LZ77Encoder::slide(size_t delta)
+    {
+        finder_.slide(delta);
+        insertPos_ = (insertPos_ > delta) ? (insertPos_ - delta) : 0;
+    }
+
+    void LZ77Encoder::reset()
+    {
+        finder_.reset();
+        insertPos_ = 0;
     }
 
 } // namespace fc
@@ -1,20 +1,61 @@
 #pragma once
+#include <cassert>
 #include <cstdint>
 #include <vector>
 #include <iosfwd>
 #include <cstddef>
+#include "match_length.h"
 
 namespace fc
 {
 
+    // Match selection strategy, fastest to smallest output. Rough figures against Greedy
+    // on English text / binary data:
+    //   Fastest: one probe of the hash head, no chains, match interiors not indexed.
+    //            ~2.3x the speed, output 15-50% larger. For hot-path logs.
+    //   Greedy:  longest match at each position, up to maxCandidates chain probes.
+    //   Lazy:    greedy, but emits a literal first when pos+1 starts a longer match.
+    //            ~1.5-2x slower, output ~3% smaller.
+    //   Optimal: minimum-cost parse over every candidate, with bit costs refined over
+    //            two passes. ~10-15x slower, output 4-6% smaller. For cold archives.
+    enum class CompressionLevel : uint8_t
+    {
+        Fastest = 0,
+        Greedy = 1,
+        Lazy = 2,
+        Optimal = 3
+    };
+
+    // Match lengths a token and a DEFLATE length code can carry
+    constexpr uint16_t MIN_MATCH_LENGTH = 3;
+    constexpr uint16_t MAX_MATCH_LENGTH = 258;
+
     struct LZ77Options
     {
         uint32_t windowSize = 32 * 1024; // 32KB
+        // MIN_MATCH_LENGTH <= minMatch <= maxMatch <= MAX_MATCH_LENGTH; deflate rejects others
         uint16_t minMatch = 3;
         uint16_t maxMatch = 258;
-        uint32_t maxCandidates = 256; // for future optimization
+        uint32_t maxCandidates = 256; // max hash-chain entries probed per position
+        CompressionLevel level = CompressionLevel::Greedy;
+        // Preset dictionary: bytes expected to recur in the input, e.g. from
+        // trainDictionary(). Its last windowSize bytes act as history before the first
+        // input byte, so the decoder must be given the same bytes.
+        std::vector<uint8_t> dictionary;
     };
 
+    // Whether opt's minMatch and maxMatch are within the range above
+    inline bool validMatchLengths(const LZ77Options &opt)
+    {
+        return opt.minMatch >= MIN_MATCH_LENGTH && opt.minMatch <= opt.maxMatch && opt.maxMatch <= MAX_MATCH_LENGTH;
+    }
+
+    // Bytes of opt.dictionary that matches can reach: at most its last windowSize
+    inline size_t usableDictionarySize(const LZ77Options &opt)
+    {
+        return (opt.dictionary.size() < opt.windowSize) ? opt.dictionary.size() : opt.windowSize;
+    }
+
     enum class TokenKind : uint8_t
     {
         Literal = 0,
@@ -45,15 +86,198 @@ namespace fc
         }
     };
 
+    // Tokens packed as a byte stream, at 1-1.01 bytes per literal rather than sizeof(Token):
+    //   0x00-0x7F h   a run of h + 1 literals, whose raw bytes follow
+    //   0x80 l d d    a match: length - 3 in l, distance - 1 in d (little-endian)
+    // Matches take 4 bytes whatever they cover, so a block's tokens need at most
+    // 4/3 of its input. Reading goes through const_iterator, which yields Tokens.
+    class TokenBuffer
+    {
+    public:
+        static constexpr size_t MAX_RUN = 128;
+        static constexpr uint8_t MATCH_TAG = 0x80;
+        static constexpr size_t MATCH_BYTES = 4;
+
+        void clear()
+        {
+            bytes_.clear();
+            run_ = NO_RUN;
+            count_ = 0;
+        }
+        // Room for the tokens of inputBytes input, however they parse
+        void reserve(size_t inputBytes) { bytes_.reserve(inputBytes + inputBytes / 3 + MATCH_BYTES); }
+        void pushLiteral(uint8_t v)
+        {
+            if (run_ != NO_RUN && bytes_[run_] < MAX_RUN - 1)
+                ++bytes_[run_];
+            else
+            {
+                run_ = bytes_.size();
+                bytes_.push_back(0);
+            }
+            bytes_.push_back(v);
+            ++count_;
+        }
+        // length in 3-258, distance in 1-32768
+        void pushMatch(uint16_t length, uint16_t distance)
+        {
+            assert(length >= MIN_MATCH_LENGTH && length <= MAX_MATCH_LENGTH && distance >= 1);
+            const uint32_t d = distance - 1u;
+            const uint8_t rec[MATCH_BYTES] = {MATCH_TAG, static_cast<uint8_t>(length - 3u), static_cast<uint8_t>(d),
+                                              static_cast<uint8_t>(d >> 8)};
+            bytes_.insert(bytes_.end(), rec, rec + MATCH_BYTES);
+            run_ = NO_RUN;
+            ++count_;
+        }
+        void push_back(const Token &t)
+        {
+            if (t.kind == TokenKind::Literal)
+                pushLiteral(t.literal);
+            else
+                pushMatch(t.length, t.distance);
+        }
+
+        size_t size() const { return count_; } // tokens
+        bool empty() const { return count_ == 0; }
+        size_t byteSize() const { return bytes_.size(); }
+        size_t capacityBytes() const { return bytes_.capacity(); }
+
+        class const_iterator
+        {
+        public:
+            const_iterator() = default;
+            Token operator*() const
+            {
+                if (left_ > 0)
+                    return Token::makeLiteral(*p_);
+                return Token::makeMatch(static_cast<uint16_t>(p_[1] + 3u),
+                                        static_cast<uint16_t>((p_[2] | (p_[3] << 8)) + 1u));
+            }
+            const_iterator &operator++()
+            {
+                if (left_ > 0)
+                {
+                    ++p_;
+                    if (--left_ == 0)
+                        enter(p_);
+                }
+                else
+                    enter(p_ + MATCH_BYTES);
+                return *this;
+            }
+            bool operator==(const const_iterator &o) const { return p_ == o.p_; }
+            bool operator!=(const const_iterator &o) const { return p_ != o.p_; }
+
+        private:
+            friend class TokenBuffer;
+            const_iterator(const uint8_t *p, const uint8_t *end) : end_(end) { enter(p); }
+            // Step onto the record at p; a literal run is entered at its first byte
+            void enter(const uint8_t *p)
+            {
+                if (p != end_ && *p < MATCH_TAG)
+                {
+                    left_ = *p + 1u;
+                    ++p;
+                }
+                p_ = p;
+            }
+
+            const uint8_t *p_ = nullptr;   // current literal, or the current match record
+            const uint8_t *end_ = nullptr;
+            uint32_t left_ = 0; // literals left in the run, this one included; 0 on a match
+        };
+
+        const_iterator begin() const { return const_iterator(bytes_.data(), bytes_.data() + bytes_.size()); }
+        const_iterator end() const
+        {
+            const uint8_t *e = bytes_.data() + bytes_.size();
+            return const_iterator(e, e);
+        }
+
+    private:
+        static constexpr size_t NO_RUN = SIZE_MAX;
+        std::vector<uint8_t> bytes_;
+        size_t run_ = NO_RUN; // header of the literal run still open at the end
+        size_t count_ = 0;
+    };
+
+    struct Match
+    {
+        uint16_t length = 0;
+        uint16_t distance = 0;
+    };
+
+    // zlib-style hash-chain match finder.
+    // head_ maps a 3-byte hash to the most recent position, prev_ links each position
+    // to the previous one with the same hash. prev_ is a ring indexed by pos modulo the
+    // window, so memory stays fixed no matter how much input passes through.
+    class MatchFinder
+    {
+    public:
+        explicit MatchFinder(const LZ77Options &opt = {});
+        void reset();
+        // Insert position pos; requires buf[pos..pos+2] to be readable
+        void insert(const uint8_t *buf, size_t pos);
+        // Longest match for buf[pos..end) against previously inserted positions
+        Match find(const uint8_t *buf, size_t pos, size_t end) const;
+        // Append each match longer than the ones before it, in chain order; every entry
+        // is the nearest match reaching its length
+        void findAll(const uint8_t *buf, size_t pos, size_t end, std::vector<Match> &out) const;
+        // Rebase stored positions after the caller drops delta bytes from the front
+        // of its buffer; delta must be a multiple of slideUnit()
+        void slide(size_t delta);
+        size_t slideUnit() const { return static_cast<size_t>(windowMask_) + 1; }
+
+    private:
+        template <typename OnMatch>
+        Match search(const uint8_t *buf, size_t pos, size_t end, OnMatch &&onMatch) const;
+
+        static constexpr uint32_t NIL = 0xFFFFFFFFu;
+        LZ77Options opt_{};
+        bool chains_ = true;      // maintain prev_ (all levels but Fastest)
+        uint32_t maxProbes_ = 0;  // candidates examined per find
+        MatchLengthFn matchLength_ = nullptr;
+        uint32_t window_ = 0;     // effective window (max distance + 1)
+        uint32_t windowMask_ = 0; // prev_ ring size - 1
+        std::vector<uint32_t> head_;
+        std::vector<uint32_t> prev_;
+    };
+
     class LZ77Encoder
     {
     public:
-        explicit LZ77Encoder(const LZ77Options &opt = {}) : opt_(opt) {}
-        // Naive baseline: emits literals only for now; will be replaced with real matching.
-        bool encode(std::istream &in, std::vector<Token> &outTokens, size_t *inputSize = nullptr);
+        explicit LZ77Encoder(const LZ77Options &opt = {}) : opt_(opt), finder_(opt) {}
+        // LZ77 over the whole input stream; false for invalid match lengths or input past 4 GiB
+        bool encode(std::istream &in, TokenBuffer &outTokens, size_t *inputSize = nullptr);
+
+        // Block interface for streaming: tokenize buf[start, end), appending to outTokens.
+        // buf[0, start) must hold the bytes of earlier blocks (the history).
+        void encodeBlock(const uint8_t *buf, size_t start, size_t end, TokenBuffer &outTokens);
+        // The block ending at end was not tokenized (stored as is): index only its last
+        // window, so the next block can still match into it
+        void skipBlock(const uint8_t *buf, size_t end);
+        // Caller dropped delta bytes from the front of its buffer (multiple of slideUnit())
+        void slide(size_t delta);
+        size_t slideUnit() const { return finder_.slideUnit(); }
+        // Forget all history
+        void reset();
 
     private:
+        // Insert every position before pos whose 3-byte hash lies inside buf[0, end)
+        void catchUp(const uint8_t *buf, size_t pos, size_t end);
+        void encodeGreedy(const uint8_t *buf, size_t start, size_t end, TokenBuffer &outTokens);
+        void encodeLazy(const uint8_t *buf, size_t start, size_t end, TokenBuffer &outTokens);
+        void encodeOptimal(const uint8_t *buf, size_t start, size_t end, TokenBuffer &outTokens);
+
         LZ77Options opt_{};
+        MatchFinder finder_;
+        size_t insertPos_ = 0; // next position to add to the hash chains
+        // encodeOptimal's per-block arrays, kept so repeated blocks reuse their memory
+        std::vector<uint32_t> optFirst_;  // index into optCands_ of each position's candidates
+        std::vector<Match> optCands_;
+        std::vector<uint64_t> optCost_;
+        std::vector<Match> optStep_;      // how each position is reached; length 0 = literal
+        std::vector<Token> optParse_;
     };
 
 } // namespace fc
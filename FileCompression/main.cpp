@@ -4,9 +4,17 @@
 #include <string>
 #include <iomanip>
 #include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iterator>
+#include <vector>
 
 #include "deflate.h"
 #include "inflate.h"
+#include "dictionary.h"
+#include "archive.h"
+#include "checksum.h"
+#include "async_io.h"
 
 // 获取文件大小
 static size_t getFileSize(std::ifstream &file)
@@ -17,6 +25,47 @@ static size_t getFileSize(std::ifstream &file)
     return size;
 }
 
+// 读取整个文件
+static bool readFile(const std::string &path, std::vector<uint8_t> &data)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+    data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+// 训练样本: 目录下的每个文件为一个样本, 否则文件中的每一行为一个样本
+static bool loadSamples(const std::string &path, std::vector<std::vector<uint8_t>> &samples)
+{
+    std::error_code ec;
+    if (std::filesystem::is_directory(path, ec))
+    {
+        for (const auto &entry : std::filesystem::directory_iterator(path, ec))
+        {
+            std::vector<uint8_t> data;
+            if (entry.is_regular_file(ec) && readFile(entry.path().string(), data) && !data.empty())
+                samples.push_back(std::move(data));
+        }
+        return !ec;
+    }
+
+    std::vector<uint8_t> data;
+    if (!readFile(path, data))
+        return false;
+    size_t begin = 0;
+    for (size_t i = 0; i <= data.size(); ++i)
+    {
+        if (i == data.size() || data[i] == '\n')
+        {
+            if (i > begin)
+                samples.emplace_back(data.begin() + begin, data.begin() + i);
+            begin = i + 1;
+        }
+    }
+    return true;
+}
+
 static void print_usage(const char *exe)
 {
     std::cout << "=========================================\n"
@@ -25,23 +74,176 @@ static void print_usage(const char *exe)
               << "使用方法:\n"
               << "  压缩:   " << exe << " <源文件> <目标文件> zip\n"
               << "  解压缩: " << exe << " <源文件> <目标文件> unzip\n"
+              << "  gzip 压缩:   " << exe << " <源文件> <目标文件> gzip\n"
+              << "  gzip 解压缩: " << exe << " <源文件> <目标文件> gunzip\n"
+              << "  区间解压:   " << exe << " <源文件> <目标文件> range -o <偏移> -n <长度>\n"
+              << "  训练字典:   " << exe << " <样本目录或每行一个样本的文件> <字典文件> train-dict\n"
+              << "  目录归档:   " << exe << " <源目录> <归档文件> archive\n"
+              << "  解开归档:   " << exe << " <归档文件> <目标目录> extract [-e <成员>]...\n"
+              << "  列出成员:   " << exe << " <归档文件> - list\n"
+              << "  校验:       " << exe << " <压缩文件或归档> - verify\n"
+              << "\n选项:\n"
+              << "  -t, --threads <N>  压缩/解压线程数 (默认 1, 0 = 按 CPU 核数)\n"
+              << "  -l, --level <L>    匹配策略: fastest / greedy (默认) / lazy / optimal\n"
+              << "  -i, --indexed      压缩为带块索引的容器, 解压时可多线程并行\n"
+              << "  -m, --mmap         解压时通过 mmap 直接写入目标文件 (仅 Linux)\n"
+              << "  -p, --pipeline     单线程压缩时让读取/匹配/熵编码三段流水并行 (输出不变)\n"
+              << "  --io <后端>        zip/unzip: 异步读写文件, 多个请求同时在途: auto / threads / uring\n"
+              << "  -o, --offset <N>   range: 起始偏移 (解压后的字节位置, 默认 0)\n"
+              << "  -n, --length <N>   range: 读取的字节数 (默认读到末尾)\n"
+              << "  -d, --dict <文件>  zip/unzip: 使用预置字典 (解压时须与压缩时相同)\n"
+              << "  --dict-size <N>    train-dict: 字典最大字节数 (默认 32768)\n"
+              << "  -e, --entry <路径> extract: 只解出该成员 (可重复, 默认全部)\n"
               << "\n示例:\n"
               << "  " << exe << " data.txt data.fc zip\n"
               << "  " << exe << " data.fc restored.txt unzip\n"
+              << "  " << exe << " data.txt data.txt.gz gzip\n"
+              << "  " << exe << " big.bin big.fc zip -t 8\n"
+              << "  " << exe << " app.log app.fc zip -i\n"
+              << "  " << exe << " /mnt/nfs/big.log big.fc zip -p\n"
+              << "  " << exe << " /nvme/big.bin big.fc zip --io auto\n"
+              << "  " << exe << " app.fc part.log range -o 1048576 -n 4096\n"
+              << "  " << exe << " samples/ records.dict train-dict\n"
+              << "  " << exe << " record.json record.fc zip -d records.dict\n"
+              << "  " << exe << " logs/ logs.fca archive -t 8\n"
+              << "  " << exe << " logs.fca restored/ extract -e 2026/10/app.log\n"
+              << "  " << exe << " data.fc - verify\n"
               << "=========================================\n";
 }
 
+static bool parseLevel(const std::string &name, fc::CompressionLevel &level)
+{
+    if (name == "fastest")
+        level = fc::CompressionLevel::Fastest;
+    else if (name == "greedy")
+        level = fc::CompressionLevel::Greedy;
+    else if (name == "lazy")
+        level = fc::CompressionLevel::Lazy;
+    else if (name == "optimal")
+        level = fc::CompressionLevel::Optimal;
+    else
+        return false;
+    return true;
+}
+
+static bool parseIoBackend(const std::string &name, fc::IoBackend &backend)
+{
+    if (name == "auto")
+        backend = fc::IoBackend::Auto;
+    else if (name == "threads")
+        backend = fc::IoBackend::Threads;
+    else if (name == "uring")
+        backend = fc::IoBackend::Uring;
+    else
+        return false;
+    return true;
+}
+
+// --io: 通过异步读写器执行一次压缩/解压调用
+template <typename Run>
+static bool runAsyncIo(const std::string &inPath, const std::string &outPath, const fc::AsyncIoOptions &aio,
+                       fc::IoBackend &used, Run run, std::string &err)
+{
+    fc::AsyncFileReader reader;
+    fc::AsyncFileWriter writer;
+    if (!reader.open(inPath, aio, &err) || !writer.open(outPath, aio, &err))
+        return false;
+    used = reader.backend();
+    std::istream in(&reader);
+    std::ostream out(&writer);
+    bool ok = run(in, out);
+    if (!reader.error().empty())
+    {
+        err = reader.error(); // 编解码器只看到输入提前结束
+        ok = false;
+    }
+    std::string writeErr;
+    if (!writer.close(&writeErr))
+    {
+        err = writeErr; // 比编解码器的 "output stream error" 更能说明问题
+        ok = false;
+    }
+    return ok;
+}
+
 int main(int argc, char *argv[])
 {
     std::string inPath, outPath, mode;
+    uint32_t threads = 1;
+    fc::CompressionLevel level = fc::CompressionLevel::Greedy;
+    bool useMmap = false;
+    bool indexed = false;
+    bool pipeline = false;
+    bool asyncIo = false;
+    fc::AsyncIoOptions aio{};
+    uint64_t rangeOffset = 0;
+    uint64_t rangeLength = ~0ull;
+    std::string dictPath;
+    size_t dictSize = 32768;
+    std::vector<std::string> members;
 
     // 检查是否通过命令行参数运行
-    if (argc == 4)
+    if (argc >= 4)
     {
         // 命令行模式
         inPath = argv[1];
         outPath = argv[2];
         mode = argv[3];
+        for (int i = 4; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            if ((arg == "-t" || arg == "--threads") && i + 1 < argc)
+            {
+                threads = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+            }
+            else if ((arg == "-o" || arg == "--offset") && i + 1 < argc)
+            {
+                rangeOffset = std::strtoull(argv[++i], nullptr, 10);
+            }
+            else if ((arg == "-n" || arg == "--length") && i + 1 < argc)
+            {
+                rangeLength = std::strtoull(argv[++i], nullptr, 10);
+            }
+            else if ((arg == "-d" || arg == "--dict") && i + 1 < argc)
+            {
+                dictPath = argv[++i];
+            }
+            else if (arg == "--dict-size" && i + 1 < argc)
+            {
+                dictSize = static_cast<size_t>(std::strtoull(argv[++i], nullptr, 10));
+            }
+            else if ((arg == "-e" || arg == "--entry") && i + 1 < argc)
+            {
+                members.push_back(argv[++i]);
+            }
+            else if (arg == "-i" || arg == "--indexed")
+            {
+                indexed = true;
+            }
+            else if (arg == "-m" || arg == "--mmap")
+            {
+                useMmap = true;
+            }
+            else if (arg == "-p" || arg == "--pipeline")
+            {
+                pipeline = true;
+            }
+            else if ((arg == "-l" || arg == "--level") && i + 1 < argc && parseLevel(argv[i + 1], level))
+            {
+                ++i;
+            }
+            else if (arg == "--io" && i + 1 < argc && parseIoBackend(argv[i + 1], aio.backend))
+            {
+                asyncIo = true;
+                ++i;
+            }
+            else
+            {
+                std::cerr << "❌ 错误: 未知的选项 \"" << arg << "\"\n\n";
+                print_usage(argv[0]);
+                return 1;
+            }
+        }
     }
     else
     {
@@ -56,12 +258,228 @@ int main(int argc, char *argv[])
         std::cout << "请输入目标文件路径: ";
         std::getline(std::cin, outPath);
 
-        std::cout << "请输入操作 (zip=压缩 / unzip=解压缩): ";
+        std::cout << "请输入操作 (zip=压缩 / unzip=解压缩 / gzip / gunzip / range / train-dict / archive / extract / list / verify): ";
         std::getline(std::cin, mode);
 
+        if (mode == "range")
+        {
+            std::string value;
+            std::cout << "请输入起始偏移: ";
+            std::getline(std::cin, value);
+            rangeOffset = std::strtoull(value.c_str(), nullptr, 10);
+            std::cout << "请输入读取长度 (留空读到末尾): ";
+            std::getline(std::cin, value);
+            if (!value.empty())
+                rangeLength = std::strtoull(value.c_str(), nullptr, 10);
+        }
+
         std::cout << "\n=========================================\n";
     }
 
+    // gzip 成员没有块索引, -i 只适用于 FC 容器
+    if (mode == "gzip" && indexed)
+    {
+        std::cerr << "❌ 错误: -i 只能与 zip 一起使用, gzip 格式不支持块索引\n";
+        return 1;
+    }
+
+    // 训练字典: 输入可以是目录, 在打开输入文件之前处理
+    if (mode == "train-dict")
+    {
+        std::cout << "\n📚 开始训练字典...\n";
+        std::cout << "   样本来源: " << inPath << "\n";
+        std::cout << "   字典文件: " << outPath << "\n";
+
+        std::vector<std::vector<uint8_t>> samples;
+        if (!loadSamples(inPath, samples))
+        {
+            std::cerr << "❌ 错误: 无法读取样本 \"" << inPath << "\"\n";
+            return 2;
+        }
+
+        auto startTime = std::chrono::high_resolution_clock::now();
+        std::vector<uint8_t> dictionary;
+        std::string err;
+        if (!fc::trainDictionary(samples, dictSize, dictionary, &err))
+        {
+            std::cerr << "\n❌ 训练失败: " << err << "\n";
+            return 4;
+        }
+
+        std::ofstream out(outPath, std::ios::binary);
+        out.write(reinterpret_cast<const char *>(dictionary.data()), static_cast<std::streamsize>(dictionary.size()));
+        out.close();
+        if (!out)
+        {
+            std::cerr << "❌ 错误: 无法写入字典文件 \"" << outPath << "\"\n";
+            return 3;
+        }
+
+        auto endTime = std::chrono::high_resolution_clock::now();
+        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime);
+
+        std::cout << "\n✅ 训练完成!\n";
+        std::cout << "   样本数: " << samples.size() << "\n";
+        std::cout << "   字典大小: " << dictionary.size() << " 字节\n";
+        std::cout << "   字典 ID: " << fc::dictionaryId(dictionary) << "\n";
+        std::cout << "   用时: " << duration.count() << " 毫秒\n";
+
+        return 0;
+    }
+
+    std::vector<uint8_t> dictionary;
+    if (!dictPath.empty() && !readFile(dictPath, dictionary))
+    {
+        std::cerr << "❌ 错误: 无法读取字典文件 \"" << dictPath << "\"\n";
+        return 2;
+    }
+
+    // 归档: 源为目录, 目标为目录, 或不需要目标文件, 在打开输入文件之前处理
+    if (mode == "archive")
+    {
+        std::cout << "\n🗄️  开始归档...\n";
+        std::cout << "   源目录: " << inPath << "\n";
+        std::cout << "   归档文件: " << outPath << "\n";
+        auto startTime = std::chrono::high_resolution_clock::now();
+
+        fc::DeflateOptions opt{};
+        opt.threads = threads;
+        opt.lz.level = level;
+        opt.lz.dictionary = dictionary;
+        std::ofstream out(outPath, std::ios::binary);
+        std::string err;
+        if (!out)
+        {
+            std::cerr << "❌ 错误: 无法创建输出文件 \"" << outPath << "\"\n";
+            return 3;
+        }
+        if (!fc::archiveDirectory(inPath, out, opt, &err))
+        {
+            std::cerr << "\n❌ 归档失败: " << err << "\n";
+            return 4;
+        }
+        out.close();
+
+        std::ifstream check(outPath, std::ios::binary);
+        fc::ArchiveReader reader(check);
+        uint64_t inputSize = 0;
+        if (reader.open(&err))
+        {
+            for (const fc::ArchiveEntry &e : reader.entries())
+                inputSize += e.originalSize;
+        }
+        size_t outputSize = getFileSize(check);
+
+        auto endTime = std::chrono::high_resolution_clock::now();
+        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime);
+        double ratio = (inputSize > 0) ? (100.0 * outputSize / inputSize) : 0.0;
+
+        std::cout << "\n✅ 归档完成!\n";
+        std::cout << "   文件数: " << reader.entries().size() << "\n";
+        std::cout << "   原始大小: " << inputSize << " 字节\n";
+        std::cout << "   归档大小: " << outputSize << " 字节\n";
+        std::cout << "   压缩比: " << std::fixed << std::setprecision(2) << ratio << "%\n";
+        std::cout << "   用时: " << duration.count() << " 毫秒\n";
+        return 0;
+    }
+    else if (mode == "verify")
+    {
+        // 完整解码并校验所有 CRC, 不写出任何数据
+        std::ifstream in(inPath, std::ios::binary);
+        if (!in)
+        {
+            std::cerr << "❌ 错误: 无法打开输入文件 \"" << inPath << "\"\n";
+            return 2;
+        }
+        std::cout << "\n🔍 开始校验...\n";
+        std::cout << "   文件: " << inPath << "\n";
+        std::cout << "   CRC-32 实现: " << fc::crc32Backend() << "\n";
+        auto startTime = std::chrono::high_resolution_clock::now();
+
+        fc::InflateOptions iopt{};
+        iopt.threads = threads;
+        iopt.dictionary = dictionary;
+        std::string err;
+        uint64_t checkedBytes = 0;
+        char magic[4] = {};
+        in.read(magic, sizeof(magic));
+        in.clear();
+        in.seekg(0);
+        if (std::string(magic, sizeof(magic)) == "FCAR")
+        {
+            fc::ArchiveReader reader(in);
+            if (!reader.open(&err))
+            {
+                std::cerr << "\n❌ 校验失败: " << err << "\n";
+                return 5;
+            }
+            for (const fc::ArchiveEntry &e : reader.entries())
+            {
+                if (!reader.verify(e, iopt, &err))
+                {
+                    std::cerr << "\n❌ 校验失败: " << err << "\n";
+                    return 5;
+                }
+                checkedBytes += e.originalSize;
+            }
+            std::cout << "   成员数: " << reader.entries().size() << "\n";
+        }
+        else if (!fc::verifyStream(in, iopt, &checkedBytes, &err))
+        {
+            std::cerr << "\n❌ 校验失败: " << err << "\n";
+            return 5;
+        }
+
+        auto endTime = std::chrono::high_resolution_clock::now();
+        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime);
+        std::cout << "\n✅ 校验通过!\n";
+        std::cout << "   数据大小: " << checkedBytes << " 字节\n";
+        std::cout << "   用时: " << duration.count() << " 毫秒\n";
+        return 0;
+    }
+    else if (mode == "extract" || mode == "list")
+    {
+        std::ifstream in(inPath, std::ios::binary);
+        if (!in)
+        {
+            std::cerr << "❌ 错误: 无法打开输入文件 \"" << inPath << "\"\n";
+            return 2;
+        }
+        std::string err;
+        if (mode == "list")
+        {
+            fc::ArchiveReader reader(in);
+            if (!reader.open(&err))
+            {
+                std::cerr << "❌ 读取归档失败: " << err << "\n";
+                return 5;
+            }
+            for (const fc::ArchiveEntry &e : reader.entries())
+                std::cout << std::setw(12) << e.originalSize << std::setw(12) << e.compressedSize << "  " << e.path << "\n";
+            std::cout << "共 " << reader.entries().size() << " 个文件\n";
+            return 0;
+        }
+
+        std::cout << "\n📂 开始解开归档...\n";
+        std::cout << "   归档文件: " << inPath << "\n";
+        std::cout << "   目标目录: " << outPath << "\n";
+        auto startTime = std::chrono::high_resolution_clock::now();
+
+        fc::InflateOptions iopt{};
+        iopt.dictionary = dictionary;
+        if (!fc::extractArchive(in, outPath, members, iopt, &err))
+        {
+            std::cerr << "\n❌ 解开归档失败: " << err << "\n";
+            return 5;
+        }
+
+        auto endTime = std::chrono::high_resolution_clock::now();
+        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime);
+        std::cout << "\n✅ 解开归档完成!\n";
+        std::cout << "   用时: " << duration.count() << " 毫秒\n";
+        return 0;
+    }
+
     // 打开输入文件
     std::ifstream in(inPath, std::ios::binary);
     if (!in)
@@ -73,8 +491,15 @@ int main(int argc, char *argv[])
     // 获取输入文件大小
     size_t inputSize = getFileSize(in);
 
-    std::ofstream out(outPath, std::ios::binary);
-    if (!out)
+    // unzip -m 由 inflateToFile 自己创建输出文件, 输入在一开始就被拒绝时不会动到它
+    bool outputByCodec = false;
+#ifdef __linux__
+    outputByCodec = useMmap && (mode == "unzip" || mode == "gunzip");
+#endif
+    std::ofstream out;
+    if (!outputByCodec)
+        out.open(outPath, std::ios::binary);
+    if (!outputByCodec && !out)
     {
         std::cerr << "❌ 错误: 无法创建输出文件 \"" << outPath << "\"\n";
         return 3;
@@ -83,7 +508,7 @@ int main(int argc, char *argv[])
     std::string err;
     auto startTime = std::chrono::high_resolution_clock::now();
 
-    if (mode == "zip")
+    if (mode == "zip" || mode == "gzip")
     {
         std::cout << "\n📦 开始压缩...\n";
         std::cout << "   源文件: " << inPath << " (" << inputSize << " 字节)\n";
@@ -92,7 +517,26 @@ int main(int argc, char *argv[])
         std::cout.flush();
 
         fc::DeflateOptions opt{}; // defaults
-        if (!fc::deflateStream(in, out, opt, &err))
+        opt.threads = threads;
+        opt.pipeline = pipeline;
+        opt.lz.level = level;
+        opt.lz.dictionary = dictionary;
+        if (mode == "gzip")
+            opt.format = fc::ContainerFormat::Gzip;
+        else if (indexed)
+            opt.format = fc::ContainerFormat::FCIndexed;
+        fc::IoBackend ioUsed = fc::IoBackend::Auto;
+        bool ok = false;
+        in.close(); // deflateFile 自己映射源文件
+        if (asyncIo)
+        {
+            out.close(); // 异步写入器自己打开目标文件
+            ok = runAsyncIo(inPath, outPath, aio, ioUsed, [&](std::istream &ain, std::ostream &aout)
+                            { return fc::deflateStream(ain, aout, opt, &err); }, err);
+        }
+        else
+            ok = fc::deflateFile(inPath, out, opt, &err);
+        if (!ok)
         {
             std::cerr << "\n❌ 压缩失败: " << err << "\n";
             return 4;
@@ -113,19 +557,43 @@ int main(int argc, char *argv[])
         std::cout << "   压缩后大小: " << outputSize << " 字节\n";
         std::cout << "   压缩比: " << std::fixed << std::setprecision(2) << ratio << "%\n";
         std::cout << "   节省空间: " << (inputSize - outputSize) << " 字节\n";
+        if (asyncIo)
+            std::cout << "   I/O 后端: " << fc::ioBackendName(ioUsed) << "\n";
         std::cout << "   用时: " << duration.count() << " 毫秒\n";
 
         return 0;
     }
-    else if (mode == "unzip")
+    else if (mode == "unzip" || mode == "gunzip")
     {
+        // inflateStream 可识别 FC 和 gzip 两种输入
         std::cout << "\n📂 开始解压缩...\n";
         std::cout << "   源文件: " << inPath << " (" << inputSize << " 字节)\n";
         std::cout << "   目标文件: " << outPath << "\n";
         std::cout << "   正在处理中";
         std::cout.flush();
 
-        if (!fc::inflateStream(in, out, &err))
+        fc::InflateOptions iopt{};
+        iopt.threads = threads;
+        iopt.dictionary = dictionary;
+        fc::IoBackend ioUsed = fc::IoBackend::Auto;
+        bool ok = false;
+#ifdef __linux__
+        if (useMmap)
+        {
+            ok = fc::inflateToFile(in, outPath, iopt, &err);
+        }
+        else
+#endif
+        if (asyncIo)
+        {
+            in.close();
+            out.close(); // 异步读写器自己打开文件
+            ok = runAsyncIo(inPath, outPath, aio, ioUsed, [&](std::istream &ain, std::ostream &aout)
+                            { return fc::inflateStream(ain, aout, iopt, &err); }, err);
+        }
+        else
+            ok = fc::inflateStream(in, out, iopt, &err);
+        if (!ok)
         {
             std::cerr << "\n❌ 解压缩失败: " << err << "\n";
             return 5;
@@ -142,6 +610,40 @@ int main(int argc, char *argv[])
         std::cout << "\n✅ 解压缩完成!\n";
         std::cout << "   压缩文件: " << inputSize << " 字节\n";
         std::cout << "   还原大小: " << outputSize << " 字节\n";
+        if (asyncIo && !useMmap)
+            std::cout << "   I/O 后端: " << fc::ioBackendName(ioUsed) << "\n";
+        std::cout << "   用时: " << duration.count() << " 毫秒\n";
+
+        return 0;
+    }
+    else if (mode == "range")
+    {
+        // 只解码覆盖该区间的块; 需要用 -i 压缩的容器
+        std::cout << "\n📂 开始区间解压...\n";
+        std::cout << "   源文件: " << inPath << " (" << inputSize << " 字节)\n";
+        std::cout << "   目标文件: " << outPath << "\n";
+        std::cout << "   起始偏移: " << rangeOffset << "\n";
+
+        if (!fc::inflateRange(in, rangeOffset, rangeLength, out, &err))
+        {
+            // 输出文件已被截断并可能写入了一部分, 失败时删除, 不留下不完整的结果
+            out.close();
+            std::error_code ec;
+            std::filesystem::remove(outPath, ec);
+            std::cerr << "\n❌ 区间解压失败: " << err << "\n";
+            return 5;
+        }
+
+        out.close();
+        std::ifstream outCheck(outPath, std::ios::binary);
+        size_t outputSize = getFileSize(outCheck);
+        outCheck.close();
+
+        auto endTime = std::chrono::high_resolution_clock::now();
+        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime);
+
+        std::cout << "\n✅ 区间解压完成!\n";
+        std::cout << "   读取字节: " << outputSize << " 字节\n";
         std::cout << "   用时: " << duration.count() << " 毫秒\n";
 
         return 0;
@@ -149,7 +651,7 @@ int main(int argc, char *argv[])
     else
     {
         std::cerr << "❌ 错误: 未知的操作指令 \"" << mode << "\"\n";
-        std::cerr << "   请使用 \"zip\" 进行压缩，或使用 \"unzip\" 进行解压缩\n\n";
+        std::cerr << "   请使用 \"zip\"/\"gzip\" 进行压缩，\"unzip\"/\"gunzip\" 进行解压缩，\"range\" 解压指定区间，\"train-dict\" 训练字典，\"archive\"/\"extract\"/\"list\" 处理目录归档，或 \"verify\" 校验\n\n";
         print_usage(argv[0]);
         return 1;
     }
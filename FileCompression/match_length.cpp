@@ -0,0 +1,209 @@
+#include "match_length.h"
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define FC_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// GCC/Clang compile each SIMD kernel for its own target; MSVC needs no annotation
+#if defined(FC_X86) && (defined(__GNUC__) || defined(__clang__))
+#define FC_TARGET(isa) __attribute__((target(isa)))
+#else
+#define FC_TARGET(isa)
+#endif
+
+namespace fc
+{
+    namespace
+    {
+        inline unsigned ctz32(uint32_t v)
+        {
+#ifdef _MSC_VER
+            unsigned long i;
+            _BitScanForward(&i, v);
+            return static_cast<unsigned>(i);
+#else
+            return static_cast<unsigned>(__builtin_ctz(v));
+#endif
+        }
+
+        // Index of the first differing byte in a non-zero XOR of two 8-byte loads
+        inline unsigned firstDiffByte(uint64_t x)
+        {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            return static_cast<unsigned>(__builtin_clzll(x)) >> 3;
+#elif defined(_MSC_VER)
+            unsigned long i;
+#if defined(_M_X64) || defined(_M_ARM64)
+            _BitScanForward64(&i, x);
+            return static_cast<unsigned>(i) >> 3;
+#else
+            if (static_cast<uint32_t>(x) != 0)
+                _BitScanForward(&i, static_cast<uint32_t>(x));
+            else
+            {
+                _BitScanForward(&i, static_cast<uint32_t>(x >> 32));
+                i += 32;
+            }
+            return static_cast<unsigned>(i) >> 3;
+#endif
+#else
+            return static_cast<unsigned>(__builtin_ctzll(x)) >> 3;
+#endif
+        }
+
+        inline uint64_t load64(const uint8_t *p)
+        {
+            uint64_t v;
+            std::memcpy(&v, p, sizeof(v));
+            return v;
+        }
+
+#ifdef FC_X86
+        FC_TARGET("sse2")
+        size_t matchLengthSSE2Impl(const uint8_t *a, const uint8_t *b, size_t maxLen)
+        {
+            size_t len = 0;
+            while (len + 16 <= maxLen)
+            {
+                __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + len));
+                __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + len));
+                uint32_t eq = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)));
+                if (eq != 0xFFFFu)
+                    return len + ctz32(~eq);
+                len += 16;
+            }
+            return len + matchLengthWord(a + len, b + len, maxLen - len);
+        }
+
+        FC_TARGET("avx2")
+        size_t matchLengthAVX2Impl(const uint8_t *a, const uint8_t *b, size_t maxLen)
+        {
+            size_t len = 0;
+            while (len + 32 <= maxLen)
+            {
+                __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + len));
+                __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + len));
+                uint32_t eq = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y)));
+                if (eq != 0xFFFFFFFFu)
+                    return len + ctz32(~eq);
+                len += 32;
+            }
+            return len + matchLengthWord(a + len, b + len, maxLen - len);
+        }
+
+        struct CpuFeatures
+        {
+            bool sse2 = false;
+            bool avx2 = false;
+            CpuFeatures()
+            {
+#ifdef _MSC_VER
+                int info[4];
+                __cpuid(info, 0);
+                int maxLeaf = info[0];
+                __cpuid(info, 1);
+                sse2 = (info[3] & (1 << 26)) != 0;
+                bool osAvx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && ((_xgetbv(0) & 6) == 6);
+                if (osAvx && maxLeaf >= 7)
+                {
+                    __cpuidex(info, 7, 0);
+                    avx2 = (info[1] & (1 << 5)) != 0;
+                }
+#else
+                __builtin_cpu_init();
+                sse2 = __builtin_cpu_supports("sse2");
+                avx2 = __builtin_cpu_supports("avx2");
+#endif
+            }
+        };
+
+        const CpuFeatures &cpuFeatures()
+        {
+            static const CpuFeatures features;
+            return features;
+        }
+#endif
+
+        struct Dispatch
+        {
+            MatchLengthFn fn = matchLengthWord;
+            const char *name = "word";
+            Dispatch()
+            {
+                if (MatchLengthFn avx2 = avx2MatchLength())
+                {
+                    fn = avx2;
+                    name = "avx2";
+                }
+                else if (MatchLengthFn sse2 = sse2MatchLength())
+                {
+                    fn = sse2;
+                    name = "sse2";
+                }
+            }
+        };
+
+        const Dispatch &dispatch()
+        {
+            static const Dispatch d;
+            return d;
+        }
+    }
+
+    size_t matchLengthBytewise(const uint8_t *a, const uint8_t *b, size_t maxLen)
+    {
+        size_t len = 0;
+        while (len < maxLen && a[len] == b[len])
+            ++len;
+        return len;
+    }
+
+    size_t matchLengthWord(const uint8_t *a, const uint8_t *b, size_t maxLen)
+    {
+        size_t len = 0;
+        while (len + 8 <= maxLen)
+        {
+            uint64_t x = load64(a + len) ^ load64(b + len);
+            if (x != 0)
+                return len + firstDiffByte(x);
+            len += 8;
+        }
+        while (len < maxLen && a[len] == b[len])
+            ++len;
+        return len;
+    }
+
+    MatchLengthFn sse2MatchLength()
+    {
+#ifdef FC_X86
+        return cpuFeatures().sse2 ? matchLengthSSE2Impl : nullptr;
+#else
+        return nullptr;
+#endif
+    }
+
+    MatchLengthFn avx2MatchLength()
+    {
+#ifdef FC_X86
+        return cpuFeatures().avx2 ? matchLengthAVX2Impl : nullptr;
+#else
+        return nullptr;
+#endif
+    }
+
+    MatchLengthFn bestMatchLength()
+    {
+        return dispatch().fn;
+    }
+
+    const char *bestMatchLengthName()
+    {
+        return dispatch().name;
+    }
+
+} // namespace fc
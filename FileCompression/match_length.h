@@ -0,0 +1,24 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+namespace fc
+{
+
+    // Length of the common prefix of a and b, capped at maxLen. Never reads a[maxLen] or
+    // b[maxLen] or beyond, so both spans only need maxLen readable bytes.
+    using MatchLengthFn = size_t (*)(const uint8_t *a, const uint8_t *b, size_t maxLen);
+
+    // Widest kernel the CPU supports, detected once; callers in hot loops keep the pointer
+    MatchLengthFn bestMatchLength();
+    // Name of that kernel: "avx2", "sse2" or "word"
+    const char *bestMatchLengthName();
+
+    // Individual kernels, for benchmarking
+    size_t matchLengthBytewise(const uint8_t *a, const uint8_t *b, size_t maxLen);
+    size_t matchLengthWord(const uint8_t *a, const uint8_t *b, size_t maxLen); // 8-byte XOR + ctz
+    // 16/32-byte compare kernels, or null when the target or CPU lacks the instruction set
+    MatchLengthFn sse2MatchLength();
+    MatchLengthFn avx2MatchLength();
+
+} // namespace fc